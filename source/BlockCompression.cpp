@@ -0,0 +1,326 @@
+#include "pch.h"
+#include "BlockCompression.h"
+#include <cmath>
+
+namespace
+{
+	uint32_t GetChannel(uint32_t texel, int channel)
+	{
+		return (texel >> (8 * channel)) & 0xFF;
+	}
+
+	uint32_t MakeTexel(uint32_t r, uint32_t g, uint32_t b, uint32_t a)
+	{
+		return r | (g << 8) | (b << 16) | (a << 24);
+	}
+
+	uint16_t ToRGB565(const float color[3])
+	{
+		const uint32_t r{ uint32_t(Elite::Clamp(color[0], 0.f, 255.f) * 31.f / 255.f + 0.5f) };
+		const uint32_t g{ uint32_t(Elite::Clamp(color[1], 0.f, 255.f) * 63.f / 255.f + 0.5f) };
+		const uint32_t b{ uint32_t(Elite::Clamp(color[2], 0.f, 255.f) * 31.f / 255.f + 0.5f) };
+		return uint16_t((r << 11) | (g << 5) | b);
+	}
+
+	void FromRGB565(uint16_t color, uint32_t rgb[3])
+	{
+		const uint32_t r{ uint32_t(color >> 11) & 31 };
+		const uint32_t g{ uint32_t(color >> 5) & 63 };
+		const uint32_t b{ uint32_t(color) & 31 };
+		rgb[0] = (r << 3) | (r >> 2);
+		rgb[1] = (g << 2) | (g >> 4);
+		rgb[2] = (b << 3) | (b >> 2);
+	}
+
+	/// <summary>
+	/// RGB endpoints along the principal axis of the block colors, palette indices to the nearest of the 4 interpolated colors
+	/// </summary>
+	void EncodeColorBlock(const uint32_t texels[BlockCompression::BLOCK_TEXEL_COUNT], uint8_t* pBlock)
+	{
+		float colors[BlockCompression::BLOCK_TEXEL_COUNT][3];
+		float mean[3]{};
+		for (int idx{}; idx < BlockCompression::BLOCK_TEXEL_COUNT; ++idx)
+		{
+			for (int channel{}; channel < 3; ++channel)
+			{
+				colors[idx][channel] = float(GetChannel(texels[idx], channel));
+				mean[channel] += colors[idx][channel] / BlockCompression::BLOCK_TEXEL_COUNT;
+			}
+		}
+
+		//Covariance matrix, then power iteration for its main eigen vector
+		float covariance[3][3]{};
+		for (int idx{}; idx < BlockCompression::BLOCK_TEXEL_COUNT; ++idx)
+		{
+			const float delta[3]{ colors[idx][0] - mean[0], colors[idx][1] - mean[1], colors[idx][2] - mean[2] };
+			for (int row{}; row < 3; ++row)
+			{
+				for (int col{}; col < 3; ++col)
+					covariance[row][col] += delta[row] * delta[col];
+			}
+		}
+
+		float axis[3]{ 1.f, 1.f, 1.f };
+		for (int iteration{}; iteration < 8; ++iteration)
+		{
+			float product[3]{};
+			for (int row{}; row < 3; ++row)
+				product[row] = covariance[row][0] * axis[0] + covariance[row][1] * axis[1] + covariance[row][2] * axis[2];
+
+			const float maxComponent{ std::max(std::max(abs(product[0]), abs(product[1])), abs(product[2])) };
+			if (maxComponent < FLT_EPSILON)
+				break;
+
+			for (int channel{}; channel < 3; ++channel)
+				axis[channel] = product[channel] / maxComponent;
+		}
+
+		int minIdx{}, maxIdx{};
+		float minProjection{ FLT_MAX }, maxProjection{ -FLT_MAX };
+		for (int idx{}; idx < BlockCompression::BLOCK_TEXEL_COUNT; ++idx)
+		{
+			const float projection{ colors[idx][0] * axis[0] + colors[idx][1] * axis[1] + colors[idx][2] * axis[2] };
+			if (projection < minProjection)
+			{
+				minProjection = projection;
+				minIdx = idx;
+			}
+			if (projection > maxProjection)
+			{
+				maxProjection = projection;
+				maxIdx = idx;
+			}
+		}
+
+		//Inset the endpoints by 1/16 of the range, the interpolated colors then cover the extremes better
+		float endpoints[2][3];
+		for (int channel{}; channel < 3; ++channel)
+		{
+			const float inset{ (colors[maxIdx][channel] - colors[minIdx][channel]) / 16.f };
+			endpoints[0][channel] = colors[maxIdx][channel] - inset;
+			endpoints[1][channel] = colors[minIdx][channel] + inset;
+		}
+
+		//color0 > color1 selects the 4 colors mode
+		uint16_t color0{ ToRGB565(endpoints[0]) };
+		uint16_t color1{ ToRGB565(endpoints[1]) };
+		if (color0 < color1)
+			std::swap(color0, color1);
+
+		uint32_t palette[4][3];
+		FromRGB565(color0, palette[0]);
+		FromRGB565(color1, palette[1]);
+		for (int channel{}; channel < 3; ++channel)
+		{
+			palette[2][channel] = (2 * palette[0][channel] + palette[1][channel]) / 3;
+			palette[3][channel] = (palette[0][channel] + 2 * palette[1][channel]) / 3;
+		}
+
+		uint32_t indices{};
+		if (color0 != color1)
+		{
+			for (int idx{}; idx < BlockCompression::BLOCK_TEXEL_COUNT; ++idx)
+			{
+				uint32_t bestIdx{};
+				float bestDistance{ FLT_MAX };
+				for (uint32_t paletteIdx{}; paletteIdx < 4; ++paletteIdx)
+				{
+					float distance{};
+					for (int channel{}; channel < 3; ++channel)
+					{
+						const float delta{ colors[idx][channel] - float(palette[paletteIdx][channel]) };
+						distance += delta * delta;
+					}
+
+					if (distance < bestDistance)
+					{
+						bestDistance = distance;
+						bestIdx = paletteIdx;
+					}
+				}
+
+				indices |= bestIdx << (2 * idx);
+			}
+		}
+
+		memcpy(pBlock, &color0, sizeof(uint16_t));
+		memcpy(pBlock + 2, &color1, sizeof(uint16_t));
+		memcpy(pBlock + 4, &indices, sizeof(uint32_t));
+	}
+
+	void DecodeColorBlock(const uint8_t* pBlock, bool isAlwaysOpaque, uint32_t texels[BlockCompression::BLOCK_TEXEL_COUNT])
+	{
+		uint16_t color0, color1;
+		uint32_t indices;
+		memcpy(&color0, pBlock, sizeof(uint16_t));
+		memcpy(&color1, pBlock + 2, sizeof(uint16_t));
+		memcpy(&indices, pBlock + 4, sizeof(uint32_t));
+
+		uint32_t rgb0[3], rgb1[3];
+		FromRGB565(color0, rgb0);
+		FromRGB565(color1, rgb1);
+
+		uint32_t palette[4]{ MakeTexel(rgb0[0], rgb0[1], rgb0[2], 255), MakeTexel(rgb1[0], rgb1[1], rgb1[2], 255) };
+		if (color0 > color1 || isAlwaysOpaque)
+		{
+			palette[2] = MakeTexel((2 * rgb0[0] + rgb1[0]) / 3, (2 * rgb0[1] + rgb1[1]) / 3, (2 * rgb0[2] + rgb1[2]) / 3, 255);
+			palette[3] = MakeTexel((rgb0[0] + 2 * rgb1[0]) / 3, (rgb0[1] + 2 * rgb1[1]) / 3, (rgb0[2] + 2 * rgb1[2]) / 3, 255);
+		}
+		else
+		{
+			//3 colors + transparent black mode
+			palette[2] = MakeTexel((rgb0[0] + rgb1[0]) / 2, (rgb0[1] + rgb1[1]) / 2, (rgb0[2] + rgb1[2]) / 2, 255);
+			palette[3] = 0;
+		}
+
+		for (int idx{}; idx < BlockCompression::BLOCK_TEXEL_COUNT; ++idx)
+			texels[idx] = palette[(indices >> (2 * idx)) & 3];
+	}
+
+	/// <summary>
+	/// Single channel block (BC4), min and max as endpoints with 6 interpolated values in between
+	/// </summary>
+	void EncodeChannelBlock(const uint32_t texels[BlockCompression::BLOCK_TEXEL_COUNT], int channel, uint8_t* pBlock)
+	{
+		uint32_t maxValue{}, minValue{ 255 };
+		for (int idx{}; idx < BlockCompression::BLOCK_TEXEL_COUNT; ++idx)
+		{
+			maxValue = std::max(maxValue, GetChannel(texels[idx], channel));
+			minValue = std::min(minValue, GetChannel(texels[idx], channel));
+		}
+
+		uint64_t indices{};
+		const uint32_t range{ maxValue - minValue };
+		if (range > 0)
+		{
+			for (int idx{}; idx < BlockCompression::BLOCK_TEXEL_COUNT; ++idx)
+			{
+				//Steps from max to min, 0 and 7 being the endpoints themselves
+				const uint64_t step{ ((maxValue - GetChannel(texels[idx], channel)) * 7 + range / 2) / range };
+				const uint64_t paletteIdx{ step == 0 ? 0 : (step == 7 ? 1 : step + 1) };
+				indices |= paletteIdx << (3 * idx);
+			}
+		}
+
+		pBlock[0] = uint8_t(maxValue);
+		pBlock[1] = uint8_t(minValue);
+		for (int byteIdx{}; byteIdx < 6; ++byteIdx)
+			pBlock[2 + byteIdx] = uint8_t(indices >> (8 * byteIdx));
+	}
+
+	void DecodeChannelBlock(const uint8_t* pBlock, uint32_t values[BlockCompression::BLOCK_TEXEL_COUNT])
+	{
+		const uint32_t value0{ pBlock[0] };
+		const uint32_t value1{ pBlock[1] };
+		uint32_t palette[8]{ value0, value1 };
+		if (value0 > value1)
+		{
+			for (uint32_t idx{ 2 }; idx < 8; ++idx)
+				palette[idx] = ((8 - idx) * value0 + (idx - 1) * value1 + 3) / 7;
+		}
+		else
+		{
+			for (uint32_t idx{ 2 }; idx < 6; ++idx)
+				palette[idx] = ((6 - idx) * value0 + (idx - 1) * value1 + 2) / 5;
+			palette[6] = 0;
+			palette[7] = 255;
+		}
+
+		uint64_t indices{};
+		for (int byteIdx{}; byteIdx < 6; ++byteIdx)
+			indices |= uint64_t(pBlock[2 + byteIdx]) << (8 * byteIdx);
+
+		for (int idx{}; idx < BlockCompression::BLOCK_TEXEL_COUNT; ++idx)
+			values[idx] = palette[(indices >> (3 * idx)) & 7];
+	}
+}
+
+/// <summary>
+/// Size in bytes of one 4x4 block
+/// </summary>
+/// <param name="format">Texture format</param>
+/// <returns>Block size, 16 texels * 4 bytes for RGBA8</returns>
+size_t BlockCompression::GetBlockByteSize(TextureFormat format)
+{
+	switch (format)
+	{
+	case TextureFormat::BC1:
+		return 8;
+	case TextureFormat::BC3:
+	case TextureFormat::BC5:
+		return 16;
+	default:
+		return BLOCK_TEXEL_COUNT * sizeof(uint32_t);
+	}
+}
+
+/// <summary>
+/// Compress a 4x4 block
+/// BC1: RGB, alpha dropped. BC3: RGB + alpha. BC5: R and G only, meant for normal maps
+/// </summary>
+/// <param name="format">Target format</param>
+/// <param name="texels">Block texels</param>
+/// <param name="pBlock">Output block, GetBlockByteSize(format) bytes</param>
+void BlockCompression::EncodeBlock(TextureFormat format, const uint32_t texels[BLOCK_TEXEL_COUNT], uint8_t* pBlock)
+{
+	switch (format)
+	{
+	case TextureFormat::BC1:
+		EncodeColorBlock(texels, pBlock);
+		break;
+	case TextureFormat::BC3:
+		EncodeChannelBlock(texels, 3, pBlock);
+		EncodeColorBlock(texels, pBlock + 8);
+		break;
+	case TextureFormat::BC5:
+		EncodeChannelBlock(texels, 0, pBlock);
+		EncodeChannelBlock(texels, 1, pBlock + 8);
+		break;
+	default:
+		memcpy(pBlock, texels, BLOCK_TEXEL_COUNT * sizeof(uint32_t));
+		break;
+	}
+}
+
+/// <summary>
+/// Decompress a 4x4 block
+/// BC5 blocks hold a normal map X and Y, Z is reconstructed into the blue channel
+/// </summary>
+/// <param name="format">Block format</param>
+/// <param name="pBlock">Block data</param>
+/// <param name="texels">Decoded texels</param>
+void BlockCompression::DecodeBlock(TextureFormat format, const uint8_t* pBlock, uint32_t texels[BLOCK_TEXEL_COUNT])
+{
+	switch (format)
+	{
+	case TextureFormat::BC1:
+		DecodeColorBlock(pBlock, false, texels);
+		break;
+	case TextureFormat::BC3:
+	{
+		uint32_t alphas[BLOCK_TEXEL_COUNT];
+		DecodeChannelBlock(pBlock, alphas);
+		DecodeColorBlock(pBlock + 8, true, texels);
+		for (int idx{}; idx < BLOCK_TEXEL_COUNT; ++idx)
+			texels[idx] = (texels[idx] & 0x00FFFFFF) | (alphas[idx] << 24);
+		break;
+	}
+	case TextureFormat::BC5:
+	{
+		uint32_t reds[BLOCK_TEXEL_COUNT], greens[BLOCK_TEXEL_COUNT];
+		DecodeChannelBlock(pBlock, reds);
+		DecodeChannelBlock(pBlock + 8, greens);
+		for (int idx{}; idx < BLOCK_TEXEL_COUNT; ++idx)
+		{
+			const float x{ reds[idx] / 127.5f - 1.f };
+			const float y{ greens[idx] / 127.5f - 1.f };
+			const float z{ sqrtf(std::max(1.f - x * x - y * y, 0.f)) };
+			texels[idx] = MakeTexel(reds[idx], greens[idx], uint32_t((z + 1.f) * 127.5f + 0.5f), 255);
+		}
+		break;
+	}
+	default:
+		memcpy(texels, pBlock, BLOCK_TEXEL_COUNT * sizeof(uint32_t));
+		break;
+	}
+}
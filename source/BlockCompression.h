@@ -0,0 +1,14 @@
+#pragma once
+#include <cstdint>
+#include "Enum.h"
+
+//Software BC1/BC3/BC5 codec working on 4x4 texel blocks, texels in RGBA8 byte order (R in the lowest byte), row by row
+namespace BlockCompression
+{
+	const int BLOCK_SIZE{ 4 };
+	const int BLOCK_TEXEL_COUNT{ BLOCK_SIZE * BLOCK_SIZE };
+
+	size_t GetBlockByteSize(TextureFormat format);
+	void EncodeBlock(TextureFormat format, const uint32_t texels[BLOCK_TEXEL_COUNT], uint8_t* pBlock);
+	void DecodeBlock(TextureFormat format, const uint8_t* pBlock, uint32_t texels[BLOCK_TEXEL_COUNT]);
+}
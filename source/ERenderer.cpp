@@ -9,6 +9,8 @@
 #include "SceneGraph.h"
 #include "Effect.h"
 #include "Utils.h"
+#include "VirtualTextureStreamer.h"
+#include "SoftwarePipeline.h"
 
 Elite::Renderer::Renderer(SDL_Window* pWindow)
 	: m_pWindow{ pWindow }
@@ -77,17 +79,45 @@ void Elite::Renderer::RenderDirectX(const std::unique_ptr<PerspectiveCamera>& pC
 	const std::vector<Mesh*>& pSceneMeshes{ pSceneGraph->GetMeshes() };
 	FilterMode filter{ ProjectSettings::GetInstance()->GetFilterMode() };
 	CullMode cullModeSettings{ ProjectSettings::GetInstance()->GetCullMode() };
-	
+	const bool useLod{ ProjectSettings::GetInstance()->UseLod() };
+	const float lodPixelError{ ProjectSettings::GetInstance()->GetLodPixelError() };
+	const bool useImpostors{ ProjectSettings::GetInstance()->UseImpostors() };
+	const float impostorScreenSize{ ProjectSettings::GetInstance()->GetImpostorScreenSize() };
+	const Elite::FMatrix4 projectionViewMatrix{ pCamera->GetProjectionMatrix() * pCamera->GetViewMatrix() };
+	//The shaders negate model z (left handed), model space reaches clip space through that mirror
+	Elite::FMatrix4 mirrorZ{ Elite::FMatrix4::Identity() };
+	mirrorZ(2, 2) = -1.f;
+
 	for (const Mesh* pMesh : pSceneMeshes)
 	{
+		const Impostor* pImpostor{ useImpostors ? pMesh->GetImpostor() : nullptr };
 		CullMode cullMode = cullModeSettings == CullMode::MESHBASED ? pMesh->GetCullMode() : cullModeSettings;
 
-		auto rasterState = m_RasterizerStates.find(cullMode);
-		if (rasterState != m_RasterizerStates.end())
-			m_pDXDeviceContext->RSSetState(rasterState->second);
+		//No hardware instancing: every instance is its own draw call, sharing the mesh buffers with only the effect parameters changing
+		//from one draw to the next. Only the software pipeline transforms and culls all the instances of a mesh in one call
+		for (const Elite::FMatrix4& transform : pMesh->GetInstanceTransforms())
+		{
+			const Elite::FMatrix4 worldViewProjection{ projectionViewMatrix * transform };
+			const Elite::FMatrix4 modelToClip{ worldViewProjection * mirrorZ };
+			if (pImpostor && pMesh->GetScreenSize(modelToClip, m_Height) < impostorScreenSize)
+			{
+				auto rasterState = m_RasterizerStates.find(CullMode::NONE);
+				if (rasterState != m_RasterizerStates.end())
+					m_pDXDeviceContext->RSSetState(rasterState->second);
+
+				const Elite::FPoint3 cameraPosition{ mirrorZ * (Elite::Inverse(transform) * Elite::FPoint4(pCamera->GetPosition())) };
+				pImpostor->Render(m_pDXDeviceContext, filter, worldViewProjection, cameraPosition);
+				continue;
+			}
 
-		pMesh->GetEffect()->SetParameters(pMesh, pCamera);
-		pMesh->Render(m_pDXDeviceContext, filter);
+			auto rasterState = m_RasterizerStates.find(cullMode);
+			if (rasterState != m_RasterizerStates.end())
+				m_pDXDeviceContext->RSSetState(rasterState->second);
+
+			const uint32_t lod{ useLod ? pMesh->SelectLod(modelToClip, m_Height, lodPixelError) : 0 };
+			pMesh->GetEffect()->SetParameters(pMesh, transform, pCamera);
+			pMesh->Render(m_pDXDeviceContext, filter, lod);
+		}
 	}
 
 	//Present
@@ -100,72 +130,50 @@ void Elite::Renderer::RenderSoftware(const std::unique_ptr<PerspectiveCamera>& p
 	SDL_FillRect(m_pBackBuffer, NULL, 0x606060);
 	SDL_LockSurface(m_pBackBuffer);
 
-	Elite::FMatrix4 worldProjectionViewMatrix{ };
 	Elite::FMatrix4 projectionViewMatrix{ pCamera->GetProjectionMatrix() * pCamera->GetViewMatrix() };
-	Elite::FPoint3 cameraPos{ pCamera->GetPosition() };
 	const std::vector<Mesh*>& pSceneMeshes{ pSceneGraph->GetMeshes() };
-	Vertex_Input triangleVertices[TRI_VERTEX_COUNT];
-	Vertex_Output screenVertices[TRI_VERTEX_COUNT];
 	CullMode cullModeSettings{ ProjectSettings::GetInstance()->GetCullMode() };
+	const bool useLod{ ProjectSettings::GetInstance()->UseLod() };
+	const float lodPixelError{ ProjectSettings::GetInstance()->GetLodPixelError() };
+	const bool useImpostors{ ProjectSettings::GetInstance()->UseImpostors() };
+	const float impostorScreenSize{ ProjectSettings::GetInstance()->GetImpostorScreenSize() };
+	const FilterMode filter{ ProjectSettings::GetInstance()->GetFilterMode() };
+	const FrameBuffer frameBuffer{ m_pBackBufferPixels, m_DepthBuffer.data(), m_Width, m_Height };
 
 	for (const Mesh* const pMesh : pSceneMeshes)
 	{
 		CullMode cullMode = cullModeSettings == CullMode::MESHBASED ? pMesh->GetCullMode() : cullModeSettings;
-		const Elite::FMatrix4& worldMatrix{ pMesh->GetTransform() };
-		const auto& vertices{ pMesh->GetVertices() };
-		const auto& indexes{ pMesh->GetIndexes() };
 		const Effect* pMaterial{ pMesh->GetEffect() };
-		bool useTransparency{ pMaterial->GetType() == MaterialType::TRANSPARENT_MATERIAL && ProjectSettings::GetInstance()->UseTransparency() };
-		PrimitiveTopology topology{ PrimitiveTopology::TRIANGLELIST };
-		worldProjectionViewMatrix = projectionViewMatrix * worldMatrix;
+		const Impostor* pImpostor{ useImpostors ? pMesh->GetImpostor() : nullptr };
 
-		const size_t indexCount{ indexes.size() };
-		const size_t step{ size_t(topology) };
-
-		for (size_t idx{}; idx <= indexCount - TRI_VERTEX_COUNT; idx += step)
+		//Parameters of every instance, the ones small on screen are drawn right away as the captured impostor instead
+		m_InstanceParameters.clear();
+		for (const Elite::FMatrix4& transform : pMesh->GetInstanceTransforms())
 		{
-			//check if the triangle generated is valid (i.e. degenerate triangle aren't valid) or if frustrum culling applies, if it's the case, jump to the next triangle
-			if (!Rasterizer::CreateTriangle(topology, vertices, indexes, idx, triangleVertices)
-				|| !Rasterizer::ConvertVerticesWorldToScreenSpace(triangleVertices, screenVertices, worldProjectionViewMatrix, worldMatrix, cameraPos, m_Width, m_Height))
-				continue;
-
-			Aabb2D aabb{ Rasterizer::GetAabb2D(screenVertices, m_Width, m_Height) };
-			//Loop over all the pixels in the aabb
-			for (uint32_t r = aabb.bot; r < aabb.top; ++r)
+			DrawParameters parameters{};
+			parameters.world = transform;
+			parameters.worldViewProjection = projectionViewMatrix * transform;
+			parameters.cameraPos = pCamera->GetPosition();
+			if (pImpostor && pMesh->GetScreenSize(parameters.worldViewProjection, m_Height) < impostorScreenSize)
 			{
-				for (uint32_t c = aabb.left; c < aabb.right; ++c)
-				{
-					Elite::FPoint2 pixelPosition{ float(c), float(r) };
-					float w0, w1, w2;
-					//Do the inside check for the current triangle and current pixel, returns the vertices weight as output parameters
-					//if false is returned, we aren't inside the triangle
-					if (!Rasterizer::IsPixelInTriangle(screenVertices, pixelPosition, cullMode, w0, w1, w2))
-						continue;
-
-					//interpolate z coordinates for depth testing
-					uint32_t pixelIdx{ c + (r * m_Width) };
-					float z = 1.f / (1.f / screenVertices[0].position.z * w0 + 1.f / screenVertices[1].position.z * w1 + 1.f / screenVertices[2].position.z * w2);
-					if (z < m_DepthBuffer[pixelIdx])
-					{
-						Vertex_Output pixelInfo{ Rasterizer::GetInterpolatedPixelInfo(pixelPosition, screenVertices, z, w0, w1, w2) };
-						Elite::RGBColor pixelColor{ pMaterial->PixelShading(pixelInfo) };
-
-						//Hard coded transparency blending mode following DirectX setup: src_Color * src_alpha + dest_Color * inv_src_alpha
-						if (useTransparency)
-							pixelColor = pixelColor * pixelColor.a + GetColorFromSDL_ARGB(m_pBackBufferPixels[pixelIdx]) * (1 - pixelColor.a);
-						else
-							m_DepthBuffer[pixelIdx] = z;
-
-						pixelColor.MaxToOne();
-						m_pBackBufferPixels[pixelIdx] = GetSDL_ARGBColor(pixelColor);
-					}
-				}
+				Rasterizer::RasterizeImpostor(*pImpostor, parameters, filter, frameBuffer);
+				continue;
 			}
+
+			parameters.lod = useLod ? pMesh->SelectLod(parameters.worldViewProjection, m_Height, lodPixelError) : 0;
+			m_InstanceParameters.push_back(parameters);
 		}
+
+		//Pipeline specialized for the mesh render states, picked once per mesh and running over all its instances
+		if (!m_InstanceParameters.empty())
+			pMaterial->GetSoftwarePipeline(cullMode, pMesh->GetVertexFormat())(*pMesh, *pMaterial, m_InstanceParameters.data(), m_InstanceParameters.size(), frameBuffer, m_TransientVertices);
 	}
 
 	SDL_UnlockSurface(m_pBackBuffer);
 	SDL_BlitSurface(m_pBackBuffer, 0, m_pFrontBuffer, 0);
+
+	//Stream in the virtual texture pages this frame sampled
+	VirtualTextureStreamer::GetInstance()->Update();
 	SDL_UpdateWindowSurface(m_pWindow);
 }
 
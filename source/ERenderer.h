@@ -52,6 +52,9 @@ namespace Elite
 
 		//Software rasterizer resources
 		std::vector<float> m_DepthBuffer{};
+		TransientVertexBuffer m_TransientVertices{};
+		//Draw parameters of the instances of the mesh being drawn, reused from mesh to mesh
+		std::vector<DrawParameters> m_InstanceParameters{};
 		SDL_Surface* m_pFrontBuffer;
 		SDL_Surface* m_pBackBuffer;
 		uint32_t* m_pBackBufferPixels;
@@ -6,7 +6,7 @@
 #include "Utils.h"
 #include "Texture.h"
 
-Effect::Effect(const std::wstring& shaderPath, MaterialType matType, const Texture* pDiffuse)
+Effect::Effect(const std::wstring& shaderPath, MaterialType matType, TextureHandle diffuseMap)
 	: m_ShaderPath(shaderPath)
 	, m_pEffect(nullptr)
 	, m_pDXPointTechnique(nullptr)
@@ -15,7 +15,7 @@ Effect::Effect(const std::wstring& shaderPath, MaterialType matType, const Textu
 	, m_pDXDefaultBlendState(nullptr)
 	, m_pDXDefaultDepthState(nullptr)
 	, m_pVariables()
-	, m_pDiffuseMap(pDiffuse)
+	, m_DiffuseMap(diffuseMap)
 	, m_Type(matType)
 {}
 
@@ -45,7 +45,8 @@ void Effect::LoadToGPU(ID3D11Device* pDevice)
 		m_pVariables.emplace("gWorldViewProjection", m_pEffect->GetVariableByName("gWorldViewProjection"));
 		m_pVariables.emplace("gDiffuseMap", m_pEffect->GetVariableByName("gDiffuseMap"));
 
-		SetResource("gDiffuseMap", m_pDiffuseMap->GetTextureResourceView());
+		if (const Texture* pDiffuseMap{ m_DiffuseMap.Get() })
+			SetResource("gDiffuseMap", pDiffuseMap->GetTextureResourceView());
 	}
 }
 
@@ -81,9 +82,52 @@ ID3DX11EffectTechnique* const Effect::GetTechnique(FilterMode filterMode) const
 	return m_pDXPointTechnique;
 }
 
-void Effect::SetParameters(const Mesh* const pMesh, const std::unique_ptr<PerspectiveCamera>& pCam)
+/// <summary>
+/// Hash of what the software shading reads: the shader, the material type and the sources of the textures.
+/// Waits for the textures to load
+/// </summary>
+/// <param name="hash">Hash the effect is folded into</param>
+/// <returns>False when a texture wasn't loaded from files, its content can't be keyed on</returns>
+bool Effect::GetContentHash(uint64_t& hash) const
+{
+	hash = Utils::Hash(m_ShaderPath.data(), m_ShaderPath.size() * sizeof(wchar_t), hash);
+	hash = Utils::Hash(&m_Type, sizeof(m_Type), hash);
+	return HashTexture(m_DiffuseMap, hash);
+}
+
+void Effect::SetParameters(const Mesh* const, const Elite::FMatrix4& world, const std::unique_ptr<PerspectiveCamera>& pCam)
+{
+	SetMatrix("gWorldViewProjection", (pCam->GetProjectionMatrix() * pCam->GetViewMatrix() * world).data[0]);
+}
+
+/// <summary>
+/// Batched pixel shading, default implementation shading every covered fragment one by one
+/// Interpolated vectors are not normalized by the rasterizer, this is left to the shading
+/// Reads every varying, derived effects overriding it with a narrower VARYINGS must override this as well
+/// </summary>
+/// <param name="fragments">Interpolated fragments information</param>
+/// <param name="outColors">Final fragments colors, SDL ARGB packed</param>
+void Effect::PixelShadingBlock(const FragmentBlock& fragments, uint32_t outColors[FRAGMENT_BLOCK_SIZE]) const
 {
-	SetMatrix("gWorldViewProjection", (pCam->GetProjectionMatrix() * pCam->GetViewMatrix() * pMesh->GetTransform()).data[0]);
+	for (int lane{}; lane < FRAGMENT_BLOCK_SIZE; ++lane)
+	{
+		if ((fragments.coverageMask & (1 << lane)) == 0)
+			continue;
+
+		Vertex_Output pixelInfo{};
+		pixelInfo.position = Elite::FPoint4{ fragments.positionX[lane], fragments.positionY[lane], fragments.depth[lane], 1.f };
+		pixelInfo.uv = Elite::FVector2{ fragments.u[lane], fragments.v[lane] };
+		pixelInfo.normal = Elite::FVector3{ fragments.normalX[lane], fragments.normalY[lane], fragments.normalZ[lane] };
+		pixelInfo.tangent = Elite::FVector3{ fragments.tangentX[lane], fragments.tangentY[lane], fragments.tangentZ[lane] };
+		pixelInfo.viewVector = Elite::FVector3{ fragments.viewX[lane], fragments.viewY[lane], fragments.viewZ[lane] };
+		Elite::Normalize(pixelInfo.normal);
+		Elite::Normalize(pixelInfo.tangent);
+		Elite::Normalize(pixelInfo.viewVector);
+
+		Elite::RGBColor pixelColor{ PixelShading(pixelInfo) };
+		pixelColor.MaxToOne();
+		outColors[lane] = Elite::GetSDL_ARGBColor(pixelColor);
+	}
 }
 
 void Effect::SetMatrix(const std::string& paramName, const float* pData)
@@ -154,4 +198,19 @@ ID3DX11Effect* Effect::LoadEffect(ID3D11Device* pDevice, const std::wstring& sha
 	}
 
 	return pEffect;
-}
\ No newline at end of file
+}
+
+/// <summary>
+/// Fold a texture in a hash: its sources with their channel layout and the format it was converted to, which changes the sampled texels.
+/// A missing texture is shaded with defaults and hashed as zero
+/// </summary>
+/// <returns>False when the texture wasn't loaded from files</returns>
+bool Effect::HashTexture(const TextureHandle& texture, uint64_t& hash)
+{
+	const Texture* pTexture{ texture.Get() };
+	const uint64_t sourceHash{ pTexture ? pTexture->GetSourceHash() : 0 };
+	const TextureFormat format{ pTexture ? pTexture->GetFormat() : TextureFormat::RGBA8 };
+	hash = Utils::Hash(&sourceHash, sizeof(sourceHash), hash);
+	hash = Utils::Hash(&format, sizeof(format), hash);
+	return !pTexture || sourceHash != 0;
+}
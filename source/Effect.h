@@ -3,14 +3,19 @@
 #include "Enum.h"
 #include <unordered_map>
 #include "Struct.h"
+#include "Texture.h"
 
 class Mesh;
 class PerspectiveCamera;
-class Texture;
 
 class Effect
 {
 public:
+	//Varyings read by the software shading, derived effects narrow it down to what their PixelShadingBlock reads
+	static constexpr VaryingMask VARYINGS{ ALL_VARYINGS };
+	//Blended software shading asks effects with ALPHA_CULLING if a quad is fully transparent (IsBlockTransparent) before shading it
+	static constexpr bool ALPHA_CULLING{ false };
+
 	Effect(const Effect& other) = delete;
 	Effect(Effect&& other) noexcept = delete;
 	Effect& operator=(const Effect& other) = delete;
@@ -21,31 +26,38 @@ public:
 
 	virtual ID3D11BlendState* GetBlendState() const { return m_pDXDefaultBlendState; };
 	virtual ID3D11DepthStencilState* GetDepthState() const { return m_pDXDefaultDepthState; };
-	virtual void SetParameters(const Mesh* const pMesh, const std::unique_ptr<PerspectiveCamera>& pCam);
+	virtual BlendMode GetBlendMode() const { return BlendMode::NO_BLENDING; };
+	virtual bool IsDepthWriteEnabled() const { return true; };
+	virtual SoftwarePipeline GetSoftwarePipeline(CullMode cullMode, VertexFormat vertexFormat) const = 0;
+	virtual void SetParameters(const Mesh* const pMesh, const Elite::FMatrix4& world, const std::unique_ptr<PerspectiveCamera>& pCam);
 	virtual Elite::RGBColor PixelShading(const Vertex_Output& pixelInfo) const = 0;
+	virtual void PixelShadingBlock(const FragmentBlock& fragments, uint32_t outColors[FRAGMENT_BLOCK_SIZE]) const;
 
 	MaterialType GetType() const { return m_Type; };
+	virtual bool GetContentHash(uint64_t& hash) const;
 
 	virtual void LoadToGPU(ID3D11Device* pDevice);
 	virtual void ClearGPUResources();
 
+	static ID3DX11Effect* LoadEffect(ID3D11Device* pDevice, const std::wstring& shaderPath);
+
 protected:
-	explicit Effect(const std::wstring& shaderPath, MaterialType matType, const Texture* pDiffuse);
+	explicit Effect(const std::wstring& shaderPath, MaterialType matType, TextureHandle diffuseMap);
 
 	std::unordered_map<std::string, ID3DX11EffectVariable*> m_pVariables;
 	std::wstring m_ShaderPath;
 	ID3DX11Effect* m_pEffect;
 	ID3D11BlendState* m_pDXDefaultBlendState;
 	ID3D11DepthStencilState* m_pDXDefaultDepthState;
-	const Texture* m_pDiffuseMap;
+	TextureHandle m_DiffuseMap;
 	MaterialType m_Type;
 
 	void SetMatrix(const std::string& paramName, const float* pData);
 	void SetResource(const std::string& paramName, ID3D11ShaderResourceView* pResourceView);
+	static bool HashTexture(const TextureHandle& texture, uint64_t& hash);
 
 private:
 	ID3DX11EffectTechnique* m_pDXPointTechnique;
 	ID3DX11EffectTechnique* m_pDXLinearTechnique;
 	ID3DX11EffectTechnique* m_pDXAnisotropicTechnique;
-	static ID3DX11Effect* LoadEffect(ID3D11Device* pDevice, const std::wstring& shaderPath);
 };
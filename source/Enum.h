@@ -34,3 +34,33 @@ enum class MaterialType
 {
 	OPAQUE_MATERIAL, TRANSPARENT_MATERIAL
 };
+
+enum class BlendMode
+{
+	NO_BLENDING, ALPHA_BLENDING
+	, COUNT
+};
+
+enum class Varying
+{
+	UV, NORMAL, TANGENT, VIEW_VECTOR
+	, COUNT
+};
+
+enum class TextureResidency
+{
+	RESIDENT, VIRTUAL
+	, COUNT
+};
+
+enum class TextureFormat
+{
+	RGBA8, BC1, BC3, BC5
+	, COUNT
+};
+
+enum class VertexFormat
+{
+	FULL, COMPACT
+	, COUNT
+};
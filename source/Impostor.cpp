@@ -0,0 +1,458 @@
+#include "pch.h"
+#include "Impostor.h"
+#include "Mesh.h"
+#include "Effect.h"
+#include "Struct.h"
+#include "Utils.h"
+#include "VertexCompression.h"
+#include "MappedFile.h"
+#include <cfloat>
+#include <cstring>
+#include <cstdio>
+#include <fstream>
+#include <filesystem>
+
+namespace
+{
+	//The capture volume is the bounding sphere of the mesh, slightly grown so silhouettes don't touch the frame borders
+	const float RADIUS_MARGIN{ 1.01f };
+	//Frames are small, the coarsest level of detail within this error is captured
+	const float CAPTURE_PIXEL_ERROR{ 0.5f };
+	//Empty texels take the colors of their covered neighbours so filtering and mip mapping don't bleed the background in
+	const uint32_t DILATION_PASS_COUNT{ 4 };
+
+	//Cache file header, followed by the color atlas at IMPOSTOR_CACHE_DATA_OFFSET then the depth atlas
+	struct ImpostorCacheHeader
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint64_t key;
+		uint32_t atlasSize;
+		uint32_t frameSize;
+	};
+
+	const uint32_t IMPOSTOR_CACHE_MAGIC{ 0x48435049 }; //"IPCH"
+	//The software shading is baked in the colors, the version goes up when the capture or the shading code changes
+	const uint32_t IMPOSTOR_CACHE_VERSION{ 1 };
+	const size_t IMPOSTOR_CACHE_DATA_OFFSET{ 64 };
+	static_assert(sizeof(ImpostorCacheHeader) <= IMPOSTOR_CACHE_DATA_OFFSET, "Impostor cache header overlaps the atlases.");
+
+	/// <summary>
+	/// Orthographic projection of the bounding sphere along the frame direction: x and y in [-1, 1] on the sphere,
+	/// z from 0 on its front to 1 on its back, w always 1
+	/// </summary>
+	Elite::FMatrix4 GetCaptureMatrix(const Impostor::Frame& frame, const Elite::FPoint3& center, float radius)
+	{
+		const Elite::FVector3 centerVector{ center };
+		const float invRadius{ 1.f / radius };
+		const float invDiameter{ 0.5f * invRadius };
+		return Elite::FMatrix4{
+			frame.right.x * invRadius, frame.right.y * invRadius, frame.right.z * invRadius, -Elite::Dot(centerVector, frame.right) * invRadius,
+			frame.up.x * invRadius, frame.up.y * invRadius, frame.up.z * invRadius, -Elite::Dot(centerVector, frame.up) * invRadius,
+			-frame.direction.x * invDiameter, -frame.direction.y * invDiameter, -frame.direction.z * invDiameter, (radius + Elite::Dot(centerVector, frame.direction)) * invDiameter,
+			0.f, 0.f, 0.f, 1.f };
+	}
+}
+
+Impostor::Impostor(const Mesh& mesh, const std::string& sourcePath)
+	: m_pColorAtlas{ nullptr }
+	, m_DepthAtlas(size_t(ATLAS_SIZE) * ATLAS_SIZE, UINT16_MAX)
+	, m_Center{}
+	, m_Radius{}
+	, m_pEffect{ nullptr }
+	, m_pVariables{}
+	, m_pDXPointTechnique{ nullptr }
+	, m_pDXLinearTechnique{ nullptr }
+	, m_pDXAnisotropicTechnique{ nullptr }
+	, m_pDXDepthTexture{ nullptr }
+	, m_pDXDepthView{ nullptr }
+	, m_IsLoadedOnGpu{ false }
+{
+	const Elite::FPoint3& boundsMin{ mesh.GetBoundsMin() };
+	const Elite::FPoint3& boundsMax{ mesh.GetBoundsMax() };
+	m_Center = Elite::FPoint3{ (Elite::FVector3(boundsMin) + Elite::FVector3(boundsMax)) * 0.5f };
+	m_Radius = std::max(Elite::Magnitude(boundsMax - boundsMin) * 0.5f * RADIUS_MARGIN, FLT_EPSILON);
+
+	//The capture is keyed on everything it renders, geometry built in memory or textures not loaded from files can't be cached.
+	//The effect and culling also name the file, so the same obj drawn in several ways keeps a cache per way
+	const CullMode cullMode{ mesh.GetCullMode() };
+	const uint64_t geometryHash{ mesh.GetGeometry()->GetContentHash() };
+	uint64_t drawHash{ Utils::HASH_SEED };
+	const bool isKeyed{ !sourcePath.empty() && geometryHash != 0 && mesh.GetEffect()->GetContentHash(drawHash) };
+	drawHash = Utils::Hash(&cullMode, sizeof(cullMode), drawHash);
+	const uint64_t cacheKey{ Utils::Hash(&geometryHash, sizeof(geometryHash), drawHash) };
+
+	char drawName[17]{};
+	std::snprintf(drawName, sizeof(drawName), "%016llx", static_cast<unsigned long long>(drawHash));
+	const std::string cachePath{ sourcePath + "." + drawName + ".impostorcache" };
+
+	std::vector<uint32_t> colors(size_t(ATLAS_SIZE) * ATLAS_SIZE, 0);
+	if (!isKeyed || !LoadCache(cachePath, cacheKey, colors))
+	{
+		Capture(mesh, colors);
+		Dilate(colors, m_DepthAtlas);
+		if (isKeyed)
+			WriteCache(cachePath, cacheKey, colors);
+	}
+	m_pColorAtlas = std::make_unique<Texture>(ATLAS_SIZE, ATLAS_SIZE, colors);
+}
+
+Impostor::~Impostor()
+{
+	ClearGPUResources();
+}
+
+/// <summary>
+/// Frame captured nearest to a direction, the direction is rounded to the center of its cell of the octahedral grid
+/// </summary>
+/// <param name="viewDirection">Direction from the center of the mesh toward the viewer, in model space, doesn't need to be normalized</param>
+uint32_t Impostor::GetFrameIndex(const Elite::FVector3& viewDirection)
+{
+	const Elite::FVector2 octahedral{ VertexCompression::EncodeOctahedral(viewDirection) };
+	const uint32_t col{ std::min(uint32_t((octahedral.x + 1.f) * 0.5f * FRAME_GRID_SIZE), FRAME_GRID_SIZE - 1) };
+	const uint32_t row{ std::min(uint32_t((octahedral.y + 1.f) * 0.5f * FRAME_GRID_SIZE), FRAME_GRID_SIZE - 1) };
+	return row * FRAME_GRID_SIZE + col;
+}
+
+Impostor::Frame Impostor::GetFrame(uint32_t frameIdx)
+{
+	const uint32_t col{ frameIdx % FRAME_GRID_SIZE };
+	const uint32_t row{ frameIdx / FRAME_GRID_SIZE };
+	const float cellSize{ 1.f / FRAME_GRID_SIZE };
+
+	Frame frame{};
+	frame.direction = VertexCompression::DecodeOctahedral(Elite::FVector2{ (float(col) + 0.5f) * cellSize * 2.f - 1.f, (float(row) + 0.5f) * cellSize * 2.f - 1.f });
+
+	//Same basis as the camera, rolled around the direction so up stays as close to world up as possible
+	const Elite::FVector3 reference{ std::abs(frame.direction.y) > 0.999f ? Utils::GetWorldZ<float>() : Utils::GetWorldY<float>() };
+	frame.right = Elite::GetNormalized(Elite::Cross(reference, frame.direction));
+	frame.up = Elite::Cross(frame.direction, frame.right);
+	frame.uvMin = Elite::FVector2{ float(col) * cellSize, float(row) * cellSize };
+	return frame;
+}
+
+/// <summary>
+/// Unfiltered depth of the atlas texel under uv, from 0 on the front of the bounding sphere to 1 on its back
+/// </summary>
+float Impostor::SampleDepth(float u, float v) const
+{
+	const uint32_t col{ uint32_t(Elite::Clamp(u * ATLAS_SIZE, 0.f, float(ATLAS_SIZE - 1))) };
+	const uint32_t row{ uint32_t(Elite::Clamp(v * ATLAS_SIZE, 0.f, float(ATLAS_SIZE - 1))) };
+	return float(m_DepthAtlas[size_t(row) * ATLAS_SIZE + col]) / UINT16_MAX;
+}
+
+/// <summary>
+/// Render every frame of the atlas with the software pipeline of the mesh. Lighting is computed in model space and baked in the colors
+/// </summary>
+/// <param name="mesh">Mesh to capture</param>
+/// <param name="colors">Atlas texels to fill, RGBA8 with the coverage in alpha</param>
+void Impostor::Capture(const Mesh& mesh, std::vector<uint32_t>& colors)
+{
+	const Effect* pEffect{ mesh.GetEffect() };
+	const SoftwarePipeline pipeline{ pEffect->GetSoftwarePipeline(mesh.GetCullMode(), mesh.GetVertexFormat()) };
+
+	std::vector<uint32_t> colorBuffer(size_t(FRAME_SIZE) * FRAME_SIZE);
+	std::vector<float> depthBuffer(size_t(FRAME_SIZE) * FRAME_SIZE);
+	const FrameBuffer frameBuffer{ colorBuffer.data(), depthBuffer.data(), FRAME_SIZE, FRAME_SIZE };
+	TransientVertexBuffer transientBuffer{};
+
+	for (uint32_t frameIdx{}; frameIdx < FRAME_GRID_SIZE * FRAME_GRID_SIZE; ++frameIdx)
+	{
+		const Frame frame{ GetFrame(frameIdx) };
+		DrawParameters parameters{};
+		parameters.worldViewProjection = GetCaptureMatrix(frame, m_Center, m_Radius);
+		parameters.world = Elite::FMatrix4::Identity();
+		//Far along the direction, view vectors are close to parallel like the projection
+		parameters.cameraPos = m_Center + frame.direction * (m_Radius * 100.f);
+		parameters.lod = mesh.SelectLod(parameters.worldViewProjection, FRAME_SIZE, CAPTURE_PIXEL_ERROR);
+
+		std::fill(colorBuffer.begin(), colorBuffer.end(), 0);
+		std::fill(depthBuffer.begin(), depthBuffer.end(), FLT_MAX);
+		pipeline(mesh, *pEffect, &parameters, 1, frameBuffer, transientBuffer);
+
+		//SDL ARGB to RGBA8, only the pixels a fragment was written to are covered
+		const uint32_t originX{ (frameIdx % FRAME_GRID_SIZE) * FRAME_SIZE };
+		const uint32_t originY{ (frameIdx / FRAME_GRID_SIZE) * FRAME_SIZE };
+		for (uint32_t r{}; r < FRAME_SIZE; ++r)
+		{
+			for (uint32_t c{}; c < FRAME_SIZE; ++c)
+			{
+				const size_t pixelIdx{ size_t(r) * FRAME_SIZE + c };
+				if (depthBuffer[pixelIdx] == FLT_MAX)
+					continue;
+
+				const uint32_t argb{ colorBuffer[pixelIdx] };
+				const size_t texelIdx{ size_t(originY + r) * ATLAS_SIZE + originX + c };
+				colors[texelIdx] = ((argb >> 16) & 0xFF) | (argb & 0xFF00) | ((argb & 0xFF) << 16) | 0xFF000000u;
+				m_DepthAtlas[texelIdx] = uint16_t(std::round(Elite::Clamp(depthBuffer[pixelIdx], 0.f, 1.f) * UINT16_MAX));
+			}
+		}
+	}
+}
+
+/// <summary>
+/// Grow the covered texels into the empty ones around them, without crossing frame borders. Alpha stays 0 so coverage is unchanged
+/// </summary>
+void Impostor::Dilate(std::vector<uint32_t>& colors, std::vector<uint16_t>& depths)
+{
+	std::vector<uint8_t> isFilled(colors.size());
+	for (size_t texelIdx{}; texelIdx < colors.size(); ++texelIdx)
+		isFilled[texelIdx] = (colors[texelIdx] >> 24) != 0;
+
+	std::vector<size_t> filledTexels;
+	for (uint32_t pass{}; pass < DILATION_PASS_COUNT; ++pass)
+	{
+		filledTexels.clear();
+		for (uint32_t y{}; y < ATLAS_SIZE; ++y)
+		{
+			for (uint32_t x{}; x < ATLAS_SIZE; ++x)
+			{
+				const size_t texelIdx{ size_t(y) * ATLAS_SIZE + x };
+				if (isFilled[texelIdx])
+					continue;
+
+				const uint32_t frameX{ x % FRAME_SIZE };
+				const uint32_t frameY{ y % FRAME_SIZE };
+				const size_t neighbours[4]{
+					frameX > 0 ? texelIdx - 1 : texelIdx,
+					frameX + 1 < FRAME_SIZE ? texelIdx + 1 : texelIdx,
+					frameY > 0 ? texelIdx - ATLAS_SIZE : texelIdx,
+					frameY + 1 < FRAME_SIZE ? texelIdx + ATLAS_SIZE : texelIdx };
+
+				uint32_t sum[3]{};
+				uint32_t depthSum{};
+				uint32_t count{};
+				for (size_t neighbourIdx : neighbours)
+				{
+					if (!isFilled[neighbourIdx])
+						continue;
+
+					for (int channel{}; channel < 3; ++channel)
+						sum[channel] += (colors[neighbourIdx] >> (channel * 8)) & 0xFF;
+					depthSum += depths[neighbourIdx];
+					++count;
+				}
+
+				if (count == 0)
+					continue;
+
+				colors[texelIdx] = (sum[0] / count) | ((sum[1] / count) << 8) | ((sum[2] / count) << 16);
+				depths[texelIdx] = uint16_t(depthSum / count);
+				filledTexels.push_back(texelIdx);
+			}
+		}
+
+		for (size_t texelIdx : filledTexels)
+			isFilled[texelIdx] = true;
+	}
+}
+
+/// <summary>
+/// Read both atlases from a cache file
+/// </summary>
+/// <param name="cachePath">Cache file</param>
+/// <param name="cacheKey">Hash of the geometry, effect and culling the atlases have to be captured with</param>
+/// <param name="colors">Color atlas texels, RGBA8 with the coverage in alpha</param>
+/// <returns>False when the cache is missing or stale, nothing is read then</returns>
+bool Impostor::LoadCache(const std::string& cachePath, uint64_t cacheKey, std::vector<uint32_t>& colors)
+{
+	MappedFile cacheFile{};
+	if (!cacheFile.Open(cachePath) || cacheFile.GetSize() < IMPOSTOR_CACHE_DATA_OFFSET)
+		return false;
+
+	ImpostorCacheHeader header{};
+	std::memcpy(&header, cacheFile.GetData(), sizeof(header));
+	const size_t colorByteSize{ colors.size() * sizeof(uint32_t) };
+	const size_t depthByteSize{ m_DepthAtlas.size() * sizeof(uint16_t) };
+	if (header.magic != IMPOSTOR_CACHE_MAGIC || header.version != IMPOSTOR_CACHE_VERSION || header.key != cacheKey
+		|| header.atlasSize != ATLAS_SIZE || header.frameSize != FRAME_SIZE || cacheFile.GetSize() < IMPOSTOR_CACHE_DATA_OFFSET + colorByteSize + depthByteSize)
+		return false;
+
+	const uint8_t* pData{ cacheFile.GetData() + IMPOSTOR_CACHE_DATA_OFFSET };
+	std::memcpy(colors.data(), pData, colorByteSize);
+	std::memcpy(m_DepthAtlas.data(), pData + colorByteSize, depthByteSize);
+	return true;
+}
+
+/// <summary>
+/// Write both atlases to a cache file, written to a temporary file then renamed so a partial file is never read
+/// </summary>
+/// <returns>False when the file couldn't be written, the impostor itself is unaffected</returns>
+bool Impostor::WriteCache(const std::string& cachePath, uint64_t cacheKey, const std::vector<uint32_t>& colors) const
+{
+	ImpostorCacheHeader header{};
+	header.magic = IMPOSTOR_CACHE_MAGIC;
+	header.version = IMPOSTOR_CACHE_VERSION;
+	header.key = cacheKey;
+	header.atlasSize = ATLAS_SIZE;
+	header.frameSize = FRAME_SIZE;
+
+	uint8_t headerBytes[IMPOSTOR_CACHE_DATA_OFFSET]{};
+	std::memcpy(headerBytes, &header, sizeof(header));
+
+	const std::string tempPath{ cachePath + ".tmp" };
+	{
+		std::ofstream file{ tempPath, std::ios::binary | std::ios::trunc };
+		file.write(reinterpret_cast<const char*>(headerBytes), std::streamsize(sizeof(headerBytes)));
+		file.write(reinterpret_cast<const char*>(colors.data()), std::streamsize(colors.size() * sizeof(uint32_t)));
+		file.write(reinterpret_cast<const char*>(m_DepthAtlas.data()), std::streamsize(m_DepthAtlas.size() * sizeof(uint16_t)));
+		if (!file)
+		{
+			file.close();
+			std::remove(tempPath.c_str());
+			std::cout << "Could not write impostor cache: " << cachePath << std::endl;
+			return false;
+		}
+	}
+
+	std::error_code error{};
+	std::filesystem::rename(tempPath, cachePath, error);
+	if (error)
+	{
+		std::remove(tempPath.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+void Impostor::LoadOnGPU(ID3D11Device* pDevice)
+{
+	//Shared impostors are loaded by the first mesh holding them
+	if (m_IsLoadedOnGpu)
+		return;
+
+	m_pEffect = Effect::LoadEffect(pDevice, L"Resources/Shaders/Impostor.fx");
+	if (!m_pEffect)
+		return;
+
+	m_pDXPointTechnique = m_pEffect->GetTechniqueByName("PointTechnique");
+	m_pDXLinearTechnique = m_pEffect->GetTechniqueByName("LinearTechnique");
+	m_pDXAnisotropicTechnique = m_pEffect->GetTechniqueByName("AnisotropicTechnique");
+	for (const char* pName : { "gWorldViewProjection", "gColorAtlas", "gDepthAtlas", "gCenter", "gRight", "gUp", "gDirection", "gRadius", "gFrameUV", "gFrameScale" })
+		m_pVariables.emplace(pName, m_pEffect->GetVariableByName(pName));
+
+	m_pColorAtlas->LoadToGPU(pDevice);
+
+	//Depth as a single 16 bit channel without mips, it is only ever point sampled from the base level
+	D3D11_TEXTURE2D_DESC texDesc{};
+	texDesc.Width = ATLAS_SIZE;
+	texDesc.Height = ATLAS_SIZE;
+	texDesc.MipLevels = 1;
+	texDesc.ArraySize = 1;
+	texDesc.SampleDesc.Count = 1;
+	texDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+	texDesc.Format = DXGI_FORMAT_R16_UNORM;
+
+	D3D11_SUBRESOURCE_DATA initData{};
+	initData.pSysMem = m_DepthAtlas.data();
+	initData.SysMemPitch = UINT(ATLAS_SIZE * sizeof(uint16_t));
+	initData.SysMemSlicePitch = UINT(m_DepthAtlas.size() * sizeof(uint16_t));
+
+	HRESULT result{ pDevice->CreateTexture2D(&texDesc, &initData, &m_pDXDepthTexture) };
+	if (FAILED(result))
+	{
+		std::cout << "Could not create impostor depth atlas" << std::endl;
+		return;
+	}
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC viewDesc{};
+	viewDesc.Format = texDesc.Format;
+	viewDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+	viewDesc.Texture2D.MipLevels = 1;
+	result = pDevice->CreateShaderResourceView(m_pDXDepthTexture, &viewDesc, &m_pDXDepthView);
+	if (FAILED(result))
+	{
+		std::cout << "Could not create impostor depth atlas view" << std::endl;
+		return;
+	}
+
+	m_IsLoadedOnGpu = true;
+}
+
+void Impostor::ClearGPUResources()
+{
+	for (auto& pVarPair : m_pVariables)
+		Utils::SafeRelease(pVarPair.second);
+
+	m_pVariables.clear();
+
+	if (m_pColorAtlas)
+		m_pColorAtlas->ClearGPUResources();
+
+	Utils::SafeRelease(m_pDXDepthView);
+	Utils::SafeRelease(m_pDXDepthTexture);
+	Utils::SafeRelease(m_pDXPointTechnique);
+	Utils::SafeRelease(m_pDXLinearTechnique);
+	Utils::SafeRelease(m_pDXAnisotropicTechnique);
+	Utils::SafeRelease(m_pEffect);
+	m_IsLoadedOnGpu = false;
+}
+
+/// <summary>
+/// Draw the frame nearest to the view direction on a quad, the 4 corners are generated in the vertex shader so no buffer is bound
+/// </summary>
+/// <param name="worldViewProjection">Model to clip space transform of the mesh</param>
+/// <param name="cameraPosition">Camera position in the model space of the mesh</param>
+void Impostor::Render(ID3D11DeviceContext* pDeviceContext, FilterMode filterMode, const Elite::FMatrix4& worldViewProjection, const Elite::FPoint3& cameraPosition) const
+{
+	if (!m_IsLoadedOnGpu)
+		return;
+
+	const Frame frame{ GetFrame(GetFrameIndex(cameraPosition - m_Center)) };
+	auto getVariable = [this](const std::string& name) -> ID3DX11EffectVariable*
+	{
+		auto paramPair = m_pVariables.find(name);
+		return paramPair != m_pVariables.end() && paramPair->second->IsValid() ? paramPair->second : nullptr;
+	};
+	auto setVector = [&](const std::string& name, float x, float y, float z)
+	{
+		const float vector[4]{ x, y, z, 0.f };
+		if (ID3DX11EffectVariable* pVariable{ getVariable(name) })
+			pVariable->AsVector()->SetFloatVector(vector);
+	};
+	auto setScalar = [&](const std::string& name, float value)
+	{
+		if (ID3DX11EffectVariable* pVariable{ getVariable(name) })
+			pVariable->AsScalar()->SetFloat(value);
+	};
+	auto setResource = [&](const std::string& name, ID3D11ShaderResourceView* pResourceView)
+	{
+		if (ID3DX11EffectVariable* pVariable{ getVariable(name) })
+			pVariable->AsShaderResource()->SetResource(pResourceView);
+	};
+
+	if (ID3DX11EffectVariable* pVariable{ getVariable("gWorldViewProjection") })
+		pVariable->AsMatrix()->SetMatrix(worldViewProjection.data[0]);
+	setVector("gCenter", m_Center.x, m_Center.y, m_Center.z);
+	setVector("gRight", frame.right.x, frame.right.y, frame.right.z);
+	setVector("gUp", frame.up.x, frame.up.y, frame.up.z);
+	setVector("gDirection", frame.direction.x, frame.direction.y, frame.direction.z);
+	setVector("gFrameUV", frame.uvMin.x, frame.uvMin.y, 0.f);
+	setScalar("gRadius", m_Radius);
+	setScalar("gFrameScale", 1.f / FRAME_GRID_SIZE);
+	setResource("gColorAtlas", m_pColorAtlas->GetTextureResourceView());
+	setResource("gDepthAtlas", m_pDXDepthView);
+
+	pDeviceContext->IASetInputLayout(nullptr);
+	pDeviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
+
+	//Default states: opaque, depth tested and written
+	const float blendFactor[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	pDeviceContext->OMSetBlendState(nullptr, blendFactor, 0xffffffff);
+	pDeviceContext->OMSetDepthStencilState(nullptr, 0);
+
+	ID3DX11EffectTechnique* pTechnique{ m_pDXPointTechnique };
+	if (filterMode == FilterMode::LINEAR)
+		pTechnique = m_pDXLinearTechnique;
+	else if (filterMode == FilterMode::ANISOTROPIC)
+		pTechnique = m_pDXAnisotropicTechnique;
+
+	D3DX11_TECHNIQUE_DESC techDesc;
+	pTechnique->GetDesc(&techDesc);
+	for (UINT p{ 0 }; p < techDesc.Passes; ++p)
+	{
+		pTechnique->GetPassByIndex(p)->Apply(0, pDeviceContext);
+		pDeviceContext->Draw(4, 0);
+	}
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include "EMath.h"
+#include "Enum.h"
+#include "Texture.h"
+
+class Mesh;
+
+//Octahedral impostor of a mesh: the mesh is rendered at load by the software rasterizer from a grid of directions over the whole sphere,
+//far away it is drawn as a single quad textured with the frame captured nearest to the view direction.
+//The atlases are cached in a file, later loads only capture again when the geometry, the effect or the culling changed
+class Impostor final
+{
+public:
+	//The atlases are cached next to the source of the mesh, an empty source path captures without cache
+	explicit Impostor(const Mesh& mesh, const std::string& sourcePath);
+	Impostor(const Impostor& other) = delete;
+	Impostor(Impostor&& other) noexcept = delete;
+	Impostor& operator=(const Impostor& other) = delete;
+	Impostor& operator=(Impostor&& other) noexcept = delete;
+	~Impostor();
+
+	//Frames are laid out on a square grid in the atlas, the octahedral encoding of a direction gives its cell
+	static constexpr uint32_t FRAME_GRID_SIZE{ 8 };
+	static constexpr uint32_t FRAME_SIZE{ 64 };
+	static constexpr uint32_t ATLAS_SIZE{ FRAME_GRID_SIZE * FRAME_SIZE };
+
+	//Orthographic view a frame is captured with, in the model space of the mesh
+	struct Frame
+	{
+		Elite::FVector3 direction;
+		Elite::FVector3 right;
+		Elite::FVector3 up;
+		Elite::FVector2 uvMin;
+	};
+
+	static uint32_t GetFrameIndex(const Elite::FVector3& viewDirection);
+	static Frame GetFrame(uint32_t frameIdx);
+
+	const Elite::FPoint3& GetCenter() const { return m_Center; }
+	float GetRadius() const { return m_Radius; }
+	const Texture& GetColorAtlas() const { return *m_pColorAtlas; }
+	float SampleDepth(float u, float v) const;
+
+	void LoadOnGPU(ID3D11Device* pDevice);
+	void ClearGPUResources();
+	void Render(ID3D11DeviceContext* pDeviceContext, FilterMode filterMode, const Elite::FMatrix4& worldViewProjection, const Elite::FPoint3& cameraPosition) const;
+
+private:
+	//Colors with the coverage in alpha, mip mapped like any texture. Depth is read unfiltered so it lives in its own full resolution atlas,
+	//from 0 on the front of the bounding sphere to 1 on its back
+	std::unique_ptr<Texture> m_pColorAtlas;
+	std::vector<uint16_t> m_DepthAtlas;
+	Elite::FPoint3 m_Center;
+	float m_Radius;
+
+	ID3DX11Effect* m_pEffect;
+	std::unordered_map<std::string, ID3DX11EffectVariable*> m_pVariables;
+	ID3DX11EffectTechnique* m_pDXPointTechnique;
+	ID3DX11EffectTechnique* m_pDXLinearTechnique;
+	ID3DX11EffectTechnique* m_pDXAnisotropicTechnique;
+	ID3D11Texture2D* m_pDXDepthTexture;
+	ID3D11ShaderResourceView* m_pDXDepthView;
+	bool m_IsLoadedOnGpu;
+
+	void Capture(const Mesh& mesh, std::vector<uint32_t>& colors);
+	bool LoadCache(const std::string& cachePath, uint64_t cacheKey, std::vector<uint32_t>& colors);
+	bool WriteCache(const std::string& cachePath, uint64_t cacheKey, const std::vector<uint32_t>& colors) const;
+	static void Dilate(std::vector<uint32_t>& colors, std::vector<uint16_t>& depths);
+};
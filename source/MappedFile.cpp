@@ -0,0 +1,87 @@
+#include "pch.h"
+#include "MappedFile.h"
+#include <windows.h>
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+	: m_pFile{ other.m_pFile }
+	, m_pMapping{ other.m_pMapping }
+	, m_pData{ other.m_pData }
+	, m_Size{ other.m_Size }
+{
+	other.m_pFile = nullptr;
+	other.m_pMapping = nullptr;
+	other.m_pData = nullptr;
+	other.m_Size = 0;
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+	if (this != &other)
+	{
+		Close();
+		std::swap(m_pFile, other.m_pFile);
+		std::swap(m_pMapping, other.m_pMapping);
+		std::swap(m_pData, other.m_pData);
+		std::swap(m_Size, other.m_Size);
+	}
+	return *this;
+}
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+/// <summary>
+/// Map a whole file for reading, a previously mapped file is closed first
+/// </summary>
+/// <param name="filePath">File to map</param>
+/// <returns>False when the file doesn't exist, is empty or can't be mapped</returns>
+bool MappedFile::Open(const std::string& filePath)
+{
+	Close();
+
+	HANDLE file{ CreateFileA(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, nullptr) };
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+	m_pFile = file;
+
+	LARGE_INTEGER fileSize{};
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+	{
+		Close();
+		return false;
+	}
+
+	m_pMapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!m_pMapping)
+	{
+		Close();
+		return false;
+	}
+
+	m_pData = static_cast<const uint8_t*>(MapViewOfFile(m_pMapping, FILE_MAP_READ, 0, 0, 0));
+	if (!m_pData)
+	{
+		Close();
+		return false;
+	}
+
+	m_Size = size_t(fileSize.QuadPart);
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (m_pData)
+		UnmapViewOfFile(m_pData);
+	if (m_pMapping)
+		CloseHandle(m_pMapping);
+	if (m_pFile)
+		CloseHandle(m_pFile);
+
+	m_pFile = nullptr;
+	m_pMapping = nullptr;
+	m_pData = nullptr;
+	m_Size = 0;
+}
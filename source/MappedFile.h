@@ -0,0 +1,29 @@
+#pragma once
+#include <string>
+#include <cstdint>
+
+//Read only view of a whole file, pages are brought in by the OS on first access and shared with the file cache
+class MappedFile final
+{
+public:
+	MappedFile() : m_pFile{ nullptr }, m_pMapping{ nullptr }, m_pData{ nullptr }, m_Size{} {};
+	MappedFile(const MappedFile&) = delete;
+	MappedFile(MappedFile&& other) noexcept;
+	MappedFile& operator=(const MappedFile&) = delete;
+	MappedFile& operator=(MappedFile&& other) noexcept;
+	~MappedFile();
+
+	bool Open(const std::string& filePath);
+	void Close();
+
+	bool IsOpen() const { return m_pData != nullptr; };
+	const uint8_t* GetData() const { return m_pData; };
+	size_t GetSize() const { return m_Size; };
+
+private:
+	//Win32 file and mapping handles, kept untyped so windows.h stays out of the header
+	void* m_pFile;
+	void* m_pMapping;
+	const uint8_t* m_pData;
+	size_t m_Size;
+};
@@ -4,19 +4,40 @@
 #include "Effect.h"
 #include "Quaternion.h"
 #include "Utils.h"
+#include "VertexCompression.h"
+#include "ResourceManager.h"
 
 Mesh::Mesh(const std::string& objPath, Effect* const pEffect, CullMode cullMode, const Elite::FMatrix4& transform)
-	: m_Transform{ transform }
+	: m_InstanceTransforms{ transform }
 	, m_pEffect{ pEffect }
 	, m_pDXVertexLayout{ nullptr }
 	, m_pDXVertexBuffer{ nullptr }
 	, m_pDXIndexBuffer{ nullptr }
-	, m_VertexBuffer{ }
-	, m_IndexBuffer{ }
+	, m_pGeometry{ nullptr }
 	, m_CullMode{ cullMode }
+	, m_pImpostor{ nullptr }
+	, m_IsLoadedOnGpu{ false }
+{
+	//Blending depends on the triangle order, only opaque meshes get their triangles reordered
+	const bool isReordered{ !pEffect || pEffect->GetType() != MaterialType::TRANSPARENT_MATERIAL };
+	m_pGeometry = ResourceManager::GetInstance()->Emplace_MeshGeometry(objPath, isReordered);
+
+	//Impostors are drawn in place of the mesh when it gets small on screen, blended meshes can't be captured in a single layer
+	if (isReordered && pEffect && !GetIndexes().empty())
+		m_pImpostor = ResourceManager::GetInstance()->Emplace_Impostor(*this, objPath);
+}
+
+Mesh::Mesh(const std::shared_ptr<const MeshGeometry>& pGeometry, Effect* const pEffect, CullMode cullMode, const Elite::FMatrix4& transform)
+	: m_InstanceTransforms{ transform }
+	, m_pEffect{ pEffect }
+	, m_pDXVertexLayout{ nullptr }
+	, m_pDXVertexBuffer{ nullptr }
+	, m_pDXIndexBuffer{ nullptr }
+	, m_pGeometry{ pGeometry }
+	, m_CullMode{ cullMode }
+	, m_pImpostor{ nullptr }
 	, m_IsLoadedOnGpu{ false }
 {
-	ObjReader::LoadModel(objPath, m_VertexBuffer, m_IndexBuffer);
 }
 
 Mesh::~Mesh()
@@ -26,10 +47,21 @@ Mesh::~Mesh()
 
 void Mesh::Update(float deltaT)
 {
-	Rotate(m_Transform, Quaternion<float>(deltaT, Utils::GetWorldY<float>()));
+	for (Elite::FMatrix4& transform : m_InstanceTransforms)
+		Rotate(transform, Quaternion<float>(deltaT, Utils::GetWorldY<float>()));
 }
 
-void Mesh::Render(ID3D11DeviceContext* pDeviceContext, FilterMode filterMode) const
+/// <summary>
+/// Add a copy of the mesh drawn with another transform, instances share all the geometry
+/// </summary>
+/// <returns>Index of the new instance</returns>
+size_t Mesh::AddInstance(const Elite::FMatrix4& transform)
+{
+	m_InstanceTransforms.push_back(transform);
+	return m_InstanceTransforms.size() - 1;
+}
+
+void Mesh::Render(ID3D11DeviceContext* pDeviceContext, FilterMode filterMode, uint32_t lod) const
 {
 	if (!m_IsLoadedOnGpu)
 		return;
@@ -52,16 +84,19 @@ void Mesh::Render(ID3D11DeviceContext* pDeviceContext, FilterMode filterMode) co
 	auto pTechnique{ m_pEffect->GetTechnique(filterMode) };
 	pTechnique->GetDesc(&techDesc);
 
-	UINT indexCount{ UINT(m_IndexBuffer.size()) };
+	const MeshLod& meshLod{ GetLods()[lod] };
 	for (UINT p{ 0 }; p < techDesc.Passes; ++p)
 	{
 		pTechnique->GetPassByIndex(p)->Apply(0, pDeviceContext);
-		pDeviceContext->DrawIndexed(indexCount, 0, 0);
+		pDeviceContext->DrawIndexed(meshLod.indexCount, meshLod.firstIndex, 0);
 	}
 }
 
 void Mesh::LoadOnGPU(ID3D11Device* pDevice)
 {
+	if (m_pImpostor)
+		m_pImpostor->LoadOnGPU(pDevice);
+
 	//Set Input Layout
 	HRESULT result{ S_OK };
 	const uint32_t numElements{ 4 };
@@ -93,15 +128,23 @@ void Mesh::LoadOnGPU(ID3D11Device* pDevice)
 	if (FAILED(result))
 		return;
 
-	//Create VertexBuffer
+	//Create VertexBuffer, the shaders read full vertices so compact ones are decoded for the upload
+	std::vector<Vertex_Input> decodedVertices{};
+	if (GetVertexFormat() == VertexFormat::COMPACT)
+	{
+		decodedVertices.reserve(GetCompactVertices().size());
+		for (const Vertex_Compact& vertex : GetCompactVertices())
+			decodedVertices.push_back(VertexCompression::DecodeVertex(vertex, GetVertexQuantization()));
+	}
+
 	D3D11_BUFFER_DESC vBufferDesc{};
 	vBufferDesc.Usage = D3D11_USAGE_IMMUTABLE;
-	vBufferDesc.ByteWidth = sizeof(Vertex_Input) * uint32_t(m_VertexBuffer.size());
+	vBufferDesc.ByteWidth = sizeof(Vertex_Input) * uint32_t(GetVertexCount());
 	vBufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
 	vBufferDesc.CPUAccessFlags = 0;
 	vBufferDesc.MiscFlags = 0;
 	D3D11_SUBRESOURCE_DATA initData = { 0 };
-	initData.pSysMem = std::data(m_VertexBuffer);
+	initData.pSysMem = decodedVertices.empty() ? GetVertices().data() : decodedVertices.data();
 
 	result = pDevice->CreateBuffer(&vBufferDesc, &initData, &m_pDXVertexBuffer);
 	if (FAILED(result))
@@ -110,11 +153,11 @@ void Mesh::LoadOnGPU(ID3D11Device* pDevice)
 	//Create IndexBuffer
 	D3D11_BUFFER_DESC iBufferDesc{};
 	iBufferDesc.Usage = D3D11_USAGE_IMMUTABLE;
-	iBufferDesc.ByteWidth = sizeof(uint32_t) * uint32_t(m_IndexBuffer.size());
+	iBufferDesc.ByteWidth = sizeof(uint32_t) * uint32_t(GetIndexes().size());
 	iBufferDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
 	iBufferDesc.CPUAccessFlags = 0;
 	iBufferDesc.MiscFlags = 0;
-	initData.pSysMem = std::data(m_IndexBuffer);
+	initData.pSysMem = GetIndexes().data();
 
 	result = pDevice->CreateBuffer(&iBufferDesc, &initData, &m_pDXIndexBuffer);
 	if (FAILED(result))
@@ -125,10 +168,13 @@ void Mesh::LoadOnGPU(ID3D11Device* pDevice)
 
 void Mesh::ClearGPUResources()
 {
+	if (m_pImpostor)
+		m_pImpostor->ClearGPUResources();
+
 	if (m_IsLoadedOnGpu)
 	{
 		Utils::SafeRelease(m_pDXVertexLayout);
 		Utils::SafeRelease(m_pDXVertexBuffer);
 		Utils::SafeRelease(m_pDXIndexBuffer);
 	}
-}
\ No newline at end of file
+}
@@ -1,7 +1,11 @@
 #pragma once
 #include <vector>
+#include <memory>
 #include "Texture.h"
 #include "Enum.h"
+#include "Utils.h"
+#include "MeshGeometry.h"
+#include "Impostor.h"
 
 class Effect;
 struct Vertex_Input;
@@ -10,6 +14,8 @@ class Mesh final
 {
 public:
 	explicit Mesh(const std::string& objPath, Effect* const pEffect, CullMode cullMode = CullMode::BACKFACE, const Elite::FMatrix4& transform = Elite::FMatrix4::Identity());
+	//Mesh of geometry built in memory, like a static batch. No impostor is captured for it
+	explicit Mesh(const std::shared_ptr<const MeshGeometry>& pGeometry, Effect* const pEffect, CullMode cullMode = CullMode::BACKFACE, const Elite::FMatrix4& transform = Elite::FMatrix4::Identity());
 	Mesh(const Mesh& other) = delete;
 	Mesh(Mesh&& other) noexcept = delete;
 	Mesh& operator=(const Mesh& other) = delete;
@@ -17,25 +23,45 @@ public:
 	~Mesh();
 
 	CullMode GetCullMode() const { return m_CullMode; }
-	const Elite::FMatrix4& GetTransform() const { return m_Transform; }
+	//Every instance draws the same geometry with its own transform, the transform given at construction is the first instance
+	const Elite::FMatrix4& GetTransform() const { return m_InstanceTransforms[0]; }
+	const std::vector<Elite::FMatrix4>& GetInstanceTransforms() const { return m_InstanceTransforms; }
+	size_t AddInstance(const Elite::FMatrix4& transform);
+	void SetInstanceTransform(size_t instanceIdx, const Elite::FMatrix4& transform) { m_InstanceTransforms[instanceIdx] = transform; }
 	Effect* const GetEffect() const { return m_pEffect; }
-	const std::vector<Vertex_Input>& GetVertices() const { return m_VertexBuffer; }
-	const std::vector<uint32_t>& GetIndexes() const { return m_IndexBuffer;  }
+	//Geometry is shared with every mesh loaded from the same obj content, the getters below read through it
+	const std::shared_ptr<const MeshGeometry>& GetGeometry() const { return m_pGeometry; }
+	VertexFormat GetVertexFormat() const { return m_pGeometry->GetVertexFormat(); }
+	size_t GetVertexCount() const { return m_pGeometry->GetVertexCount(); }
+	const Utils::ArrayView<Vertex_Input>& GetVertices() const { return m_pGeometry->GetVertices(); }
+	const Utils::ArrayView<Vertex_Compact>& GetCompactVertices() const { return m_pGeometry->GetCompactVertices(); }
+	const VertexQuantization& GetVertexQuantization() const { return m_pGeometry->GetVertexQuantization(); }
+	const Utils::ArrayView<uint32_t>& GetIndexes() const { return m_pGeometry->GetIndexes(); }
+	const Utils::ArrayView<Meshlet>& GetMeshlets() const { return m_pGeometry->GetMeshlets(); }
+	const Utils::ArrayView<MeshLod>& GetLods() const { return m_pGeometry->GetLods(); }
+	Utils::ArrayView<Meshlet> GetLodMeshlets(uint32_t lod) const { return m_pGeometry->GetLodMeshlets(lod); }
+	uint32_t SelectLod(const Elite::FMatrix4& worldViewProjection, uint32_t screenHeight, float pixelError) const { return m_pGeometry->SelectLod(worldViewProjection, screenHeight, pixelError); }
+	float GetScreenSize(const Elite::FMatrix4& worldViewProjection, uint32_t screenHeight) const { return m_pGeometry->GetScreenSize(worldViewProjection, screenHeight); }
+	const std::vector<MeshDrawRange>& GetDrawRanges() const { return m_pGeometry->GetDrawRanges(); }
+	//Opaque meshes get an impostor captured at load, shared with the meshes drawn the same way, nullptr otherwise
+	const Impostor* GetImpostor() const { return m_pImpostor.get(); }
+	const Elite::FPoint3& GetBoundsMin() const { return m_pGeometry->GetBoundsMin(); }
+	const Elite::FPoint3& GetBoundsMax() const { return m_pGeometry->GetBoundsMax(); }
 
 	void LoadOnGPU(ID3D11Device* pDevice);
 	void ClearGPUResources();
 	void Update(float deltaT);
-	void Render(ID3D11DeviceContext* pDeviceContext, FilterMode filterMode) const;
+	void Render(ID3D11DeviceContext* pDeviceContext, FilterMode filterMode, uint32_t lod = 0) const;
 
 private:
-	Elite::FMatrix4 m_Transform;
+	std::vector<Elite::FMatrix4> m_InstanceTransforms;
 	Effect* const m_pEffect;
 	ID3D11InputLayout* m_pDXVertexLayout;
 	ID3D11Buffer* m_pDXVertexBuffer;
 	ID3D11Buffer* m_pDXIndexBuffer;
-	std::vector<Vertex_Input> m_VertexBuffer;
-	std::vector<uint32_t> m_IndexBuffer;
+	std::shared_ptr<const MeshGeometry> m_pGeometry;
 	CullMode m_CullMode;
+	std::shared_ptr<Impostor> m_pImpostor;
 
 	bool m_IsLoadedOnGpu;
 };
@@ -0,0 +1,532 @@
+#include "pch.h"
+#include "MeshGeometry.h"
+#include "Struct.h"
+#include "MeshOptimizer.h"
+#include "VertexCompression.h"
+#include "MeshSimplifier.h"
+#include <fstream>
+#include <filesystem>
+#include <cstring>
+#include <cstdio>
+
+//Cache file header, followed by the vertices at MESH_CACHE_DATA_OFFSET then the indexes, the meshlets and the levels of detail, all in their in-memory layout
+struct MeshCacheHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint64_t sourceSize;
+	int64_t sourceTime;
+	uint64_t contentHash;
+	uint32_t vertexStride;
+	uint32_t vertexFormat;
+	uint32_t isReordered;
+	uint32_t vertexCount;
+	uint32_t indexCount;
+	uint32_t meshletCount;
+	uint32_t lodCount;
+	float boundsMin[3];
+	float boundsMax[3];
+};
+
+namespace
+{
+	const uint32_t MESH_CACHE_MAGIC{ 0x4843534D }; //"MSCH"
+	const uint32_t MESH_CACHE_VERSION{ 6 };
+	const size_t MESH_CACHE_DATA_OFFSET{ 128 };
+	static_assert(sizeof(MeshCacheHeader) <= MESH_CACHE_DATA_OFFSET, "Mesh cache header overlaps the vertices.");
+	static_assert(sizeof(Vertex_Input) % sizeof(uint32_t) == 0, "Mesh cache indexes have to stay aligned after the vertices.");
+	static_assert(sizeof(Vertex_Compact) % sizeof(uint32_t) == 0, "Mesh cache indexes have to stay aligned after the vertices.");
+	static_assert(alignof(Meshlet) <= sizeof(uint32_t), "Mesh cache meshlets have to stay aligned after the indexes.");
+	static_assert(alignof(MeshLod) <= sizeof(uint32_t), "Mesh cache levels of detail have to stay aligned after the meshlets.");
+
+	//Meshes from this vertex count on are stored compact, below it the memory saved doesn't pay for the precision lost
+	const size_t COMPACT_VERTEX_MIN_COUNT{ 1024 };
+
+	//Every level of detail aims at half the triangles of the previous one, the chain ends when simplifying stalls or gets too coarse
+	const uint32_t MAX_LOD_COUNT{ 8 };
+	const size_t LOD_MIN_TRIANGLE_COUNT{ 256 };
+	const float LOD_MIN_REDUCTION{ 0.8f };
+	//Largest simplification error allowed, relative to the mesh radius
+	const float LOD_MAX_RELATIVE_ERROR{ 0.1f };
+}
+
+MeshGeometry::MeshGeometry(const std::string& objPath, bool isReordered, uint64_t contentHash)
+	: m_VertexBuffer{ }
+	, m_CompactVertexBuffer{ }
+	, m_IndexBuffer{ }
+	, m_MeshletBuffer{ }
+	, m_LodBuffer{ }
+	, m_CacheFile{ }
+	, m_Vertices{ }
+	, m_CompactVertices{ }
+	, m_Indexes{ }
+	, m_Meshlets{ }
+	, m_Lods{ }
+	, m_BoundsMin{ }
+	, m_BoundsMax{ }
+	, m_VertexQuantization{ }
+	, m_VertexFormat{ VertexFormat::FULL }
+	, m_IsReordered{ isReordered }
+	, m_ContentHash{ contentHash }
+	, m_DrawRanges{ }
+{
+	//The cache is tied to the size and write time of the obj and stores its content hash, so a valid cache is used without reading the obj at all
+	const std::string cachePath{ objPath + ".meshcache" };
+	uint64_t sourceSize{};
+	int64_t sourceTime{};
+	const bool hasSource{ GetSourceStamp(objPath, sourceSize, sourceTime) };
+	if (!hasSource || !MapCache(cachePath, sourceSize, sourceTime))
+	{
+		Build(objPath);
+		if (hasSource)
+			WriteCache(cachePath, sourceSize, sourceTime);
+	}
+}
+
+MeshGeometry::MeshGeometry(const std::vector<Placement>& placements)
+	: m_VertexBuffer{ }
+	, m_CompactVertexBuffer{ }
+	, m_IndexBuffer{ }
+	, m_MeshletBuffer{ }
+	, m_LodBuffer{ }
+	, m_CacheFile{ }
+	, m_Vertices{ }
+	, m_CompactVertices{ }
+	, m_Indexes{ }
+	, m_Meshlets{ }
+	, m_Lods{ }
+	, m_BoundsMin{ }
+	, m_BoundsMax{ }
+	, m_VertexQuantization{ }
+	, m_VertexFormat{ VertexFormat::FULL }
+	, m_IsReordered{ true }
+	, m_ContentHash{ }
+	, m_DrawRanges{ }
+{
+	Merge(placements);
+}
+
+/// <summary>
+/// Parse the obj and build everything the cache stores: optimized triangles, levels of detail, meshlets, bounds and compact vertices
+/// </summary>
+void MeshGeometry::Build(const std::string& objPath)
+{
+	ObjReader::LoadModel(objPath, m_VertexBuffer, m_IndexBuffer);
+	if (m_IsReordered)
+	{
+		MeshOptimizer::OptimizeVertexCache(m_IndexBuffer, m_VertexBuffer.size());
+		MeshOptimizer::OptimizeOverdraw(m_IndexBuffer, m_VertexBuffer);
+	}
+	BuildLods();
+	MeshOptimizer::OptimizeVertexFetch(m_IndexBuffer, m_VertexBuffer);
+
+	m_Vertices = { m_VertexBuffer.data(), m_VertexBuffer.size() };
+	m_Indexes = { m_IndexBuffer.data(), m_IndexBuffer.size() };
+	m_Meshlets = { m_MeshletBuffer.data(), m_MeshletBuffer.size() };
+	m_Lods = { m_LodBuffer.data(), m_LodBuffer.size() };
+
+	if (!m_VertexBuffer.empty())
+	{
+		m_BoundsMin = m_BoundsMax = m_VertexBuffer[0].position;
+		for (const Vertex_Input& vertex : m_VertexBuffer)
+		{
+			for (int axis{}; axis < 3; ++axis)
+			{
+				m_BoundsMin[axis] = std::min(m_BoundsMin[axis], vertex.position[axis]);
+				m_BoundsMax[axis] = std::max(m_BoundsMax[axis], vertex.position[axis]);
+			}
+		}
+	}
+
+	if (m_VertexBuffer.size() >= COMPACT_VERTEX_MIN_COUNT)
+		Compact();
+}
+
+/// <summary>
+/// Move the full level of detail of every placement to world space and append it to the buffers, with a draw range per placement.
+/// Merged vertices stay full precision: quantizing them over the bounds of a whole scene would cost too much precision
+/// </summary>
+void MeshGeometry::Merge(const std::vector<Placement>& placements)
+{
+	size_t vertexCount{}, indexCount{}, meshletCount{};
+	for (const Placement& placement : placements)
+	{
+		const MeshLod& fullLod{ placement.pGeometry->GetLods()[0] };
+		vertexCount += placement.pGeometry->GetVertexCount();
+		indexCount += fullLod.indexCount;
+		meshletCount += fullLod.meshletCount;
+	}
+	m_VertexBuffer.reserve(vertexCount);
+	m_IndexBuffer.reserve(indexCount);
+	m_MeshletBuffer.reserve(meshletCount);
+	m_DrawRanges.reserve(placements.size());
+
+	for (const Placement& placement : placements)
+	{
+		const MeshGeometry& geometry{ *placement.pGeometry };
+		const Elite::FMatrix4& transform{ placement.transform };
+		const MeshLod& fullLod{ geometry.GetLods()[0] };
+		m_IsReordered &= geometry.IsReordered();
+
+		//Normals and tangents go through the world matrix like in the vertex stage, so the merged vertices shade exactly like the instance did
+		const uint32_t baseVertex{ uint32_t(m_VertexBuffer.size()) };
+		for (size_t vertexIdx{}; vertexIdx < geometry.GetVertexCount(); ++vertexIdx)
+		{
+			const Vertex_Input vertex{ geometry.GetVertexFormat() == VertexFormat::COMPACT ? VertexCompression::DecodeVertex(geometry.GetCompactVertices()[vertexIdx], geometry.GetVertexQuantization()) : geometry.GetVertices()[vertexIdx] };
+			m_VertexBuffer.push_back(Vertex_Input{ Elite::FPoint3(transform * Elite::FPoint4(vertex.position)), Elite::FVector3(transform * Elite::FVector4(vertex.normal)), Elite::FVector3(transform * Elite::FVector4(vertex.tangent)), vertex.uv });
+		}
+
+		const uint32_t firstIndex{ uint32_t(m_IndexBuffer.size()) };
+		for (uint32_t idx{ fullLod.firstIndex }; idx < fullLod.firstIndex + fullLod.indexCount; ++idx)
+			m_IndexBuffer.push_back(geometry.GetIndexes()[idx] + baseVertex);
+
+		//Bounding spheres scale with the largest axis. Normal cones only survive rotations and uniform scales, other transforms turn them off
+		float scales[3]{};
+		for (int axis{}; axis < 3; ++axis)
+			scales[axis] = sqrtf(transform(0, axis) * transform(0, axis) + transform(1, axis) * transform(1, axis) + transform(2, axis) * transform(2, axis));
+		const float maxScale{ std::max(scales[0], std::max(scales[1], scales[2])) };
+		const float minScale{ std::min(scales[0], std::min(scales[1], scales[2])) };
+		const float determinant{ transform(0, 0) * (transform(1, 1) * transform(2, 2) - transform(1, 2) * transform(2, 1))
+			- transform(0, 1) * (transform(1, 0) * transform(2, 2) - transform(1, 2) * transform(2, 0))
+			+ transform(0, 2) * (transform(1, 0) * transform(2, 1) - transform(1, 1) * transform(2, 0)) };
+		const bool keepsCones{ determinant > 0.f && maxScale - minScale <= maxScale * 1e-3f };
+
+		const uint32_t firstMeshlet{ uint32_t(m_MeshletBuffer.size()) };
+		for (const Meshlet& sourceMeshlet : geometry.GetLodMeshlets(0))
+		{
+			Meshlet meshlet{ sourceMeshlet };
+			meshlet.firstIndex = sourceMeshlet.firstIndex - fullLod.firstIndex + firstIndex;
+			meshlet.center = Elite::FPoint3(transform * Elite::FPoint4(sourceMeshlet.center));
+			meshlet.radius = sourceMeshlet.radius * maxScale;
+			if (keepsCones)
+				meshlet.coneAxis = Elite::GetNormalized(Elite::FVector3(transform * Elite::FVector4(sourceMeshlet.coneAxis)));
+			else
+				meshlet.coneCutoff = 1.f;
+			m_MeshletBuffer.push_back(meshlet);
+		}
+
+		Elite::FPoint3 rangeMin{}, rangeMax{};
+		for (uint32_t vertexIdx{ baseVertex }; vertexIdx < m_VertexBuffer.size(); ++vertexIdx)
+		{
+			const Elite::FPoint3& position{ m_VertexBuffer[vertexIdx].position };
+			if (vertexIdx == baseVertex)
+				rangeMin = rangeMax = position;
+
+			for (int axis{}; axis < 3; ++axis)
+			{
+				rangeMin[axis] = std::min(rangeMin[axis], position[axis]);
+				rangeMax[axis] = std::max(rangeMax[axis], position[axis]);
+			}
+		}
+
+		if (m_DrawRanges.empty())
+		{
+			m_BoundsMin = rangeMin;
+			m_BoundsMax = rangeMax;
+		}
+		for (int axis{}; axis < 3; ++axis)
+		{
+			m_BoundsMin[axis] = std::min(m_BoundsMin[axis], rangeMin[axis]);
+			m_BoundsMax[axis] = std::max(m_BoundsMax[axis], rangeMax[axis]);
+		}
+
+		const Elite::FPoint3 rangeCenter{ (Elite::FVector3(rangeMin) + Elite::FVector3(rangeMax)) * 0.5f };
+		m_DrawRanges.push_back(MeshDrawRange{ baseVertex, uint32_t(m_VertexBuffer.size()) - baseVertex, firstIndex, uint32_t(m_IndexBuffer.size()) - firstIndex, firstMeshlet, uint32_t(m_MeshletBuffer.size()) - firstMeshlet, rangeCenter, Elite::Magnitude(rangeMax - rangeMin) * 0.5f });
+	}
+
+	//A single level: simplifying across placements would weld unrelated props together
+	m_LodBuffer.push_back(MeshLod{ 0, uint32_t(m_IndexBuffer.size()), 0, uint32_t(m_MeshletBuffer.size()), 0.f });
+	m_Vertices = { m_VertexBuffer.data(), m_VertexBuffer.size() };
+	m_Indexes = { m_IndexBuffer.data(), m_IndexBuffer.size() };
+	m_Meshlets = { m_MeshletBuffer.data(), m_MeshletBuffer.size() };
+	m_Lods = { m_LodBuffer.data(), m_LodBuffer.size() };
+}
+
+/// <summary>
+/// Quantize the parsed vertices to the compact format, the full vertices are released.
+/// Meshlets are bounded again with the decoded positions, the ones the vertex stage rasterizes, so culling stays conservative
+/// </summary>
+void MeshGeometry::Compact()
+{
+	m_VertexQuantization = VertexCompression::GetQuantization(m_BoundsMin, m_BoundsMax);
+	m_CompactVertexBuffer.reserve(m_VertexBuffer.size());
+	std::vector<Elite::FPoint3> positions;
+	positions.reserve(m_VertexBuffer.size());
+	for (const Vertex_Input& vertex : m_VertexBuffer)
+	{
+		m_CompactVertexBuffer.push_back(VertexCompression::EncodeVertex(vertex, m_VertexQuantization));
+		positions.push_back(VertexCompression::DecodePosition(m_CompactVertexBuffer.back(), m_VertexQuantization));
+	}
+	MeshOptimizer::ComputeMeshletBounds(m_MeshletBuffer, m_IndexBuffer, positions);
+
+	m_VertexBuffer = std::vector<Vertex_Input>{};
+	m_Vertices = {};
+	m_CompactVertices = { m_CompactVertexBuffer.data(), m_CompactVertexBuffer.size() };
+	m_VertexFormat = VertexFormat::COMPACT;
+}
+
+/// <summary>
+/// Pixels covered by a model space unit at the nearest point of the bounding sphere
+/// </summary>
+/// <param name="worldViewProjection">Model to clip space transform the mesh is drawn with</param>
+/// <param name="screenHeight">Height of the render target in pixels</param>
+/// <returns>FLT_MAX when the camera is inside the sphere</returns>
+float MeshGeometry::GetPixelsPerUnit(const Elite::FMatrix4& worldViewProjection, uint32_t screenHeight) const
+{
+	const Elite::FPoint3 center{ (Elite::FVector3(m_BoundsMin) + Elite::FVector3(m_BoundsMax)) * 0.5f };
+	const float radius{ Elite::Magnitude(m_BoundsMax - m_BoundsMin) * 0.5f };
+
+	//Clip w of the nearest point of the sphere
+	const Elite::FMatrix4& matrix{ worldViewProjection };
+	const float wScale{ sqrtf(matrix(3, 0) * matrix(3, 0) + matrix(3, 1) * matrix(3, 1) + matrix(3, 2) * matrix(3, 2)) };
+	const float nearestW{ matrix(3, 0) * center.x + matrix(3, 1) * center.y + matrix(3, 2) * center.z + matrix(3, 3) - radius * wScale };
+	if (nearestW <= FLT_EPSILON)
+		return FLT_MAX;
+
+	//The vertical scale of the projection maps clip y to half the screen
+	const float yScale{ sqrtf(matrix(1, 0) * matrix(1, 0) + matrix(1, 1) * matrix(1, 1) + matrix(1, 2) * matrix(1, 2)) };
+	return yScale * float(screenHeight) * 0.5f / nearestW;
+}
+
+/// <summary>
+/// Coarsest level of detail whose error stays under a pixel threshold on screen, measured at the nearest point of the bounding sphere
+/// </summary>
+/// <param name="worldViewProjection">Model to clip space transform the mesh is drawn with</param>
+/// <param name="screenHeight">Height of the render target in pixels</param>
+/// <param name="pixelError">Largest error allowed on screen, in pixels</param>
+uint32_t MeshGeometry::SelectLod(const Elite::FMatrix4& worldViewProjection, uint32_t screenHeight, float pixelError) const
+{
+	if (m_Lods.size() <= 1)
+		return 0;
+
+	//A camera inside the sphere gets the full mesh
+	const float pixelsPerUnit{ GetPixelsPerUnit(worldViewProjection, screenHeight) };
+	if (pixelsPerUnit == FLT_MAX)
+		return 0;
+
+	uint32_t lod{};
+	while (lod + 1 < m_Lods.size() && m_Lods[lod + 1].error * pixelsPerUnit <= pixelError)
+		++lod;
+
+	return lod;
+}
+
+/// <summary>
+/// Upper bound of the size of the mesh on screen: diameter of its bounding sphere in pixels, projected at the nearest point of the sphere
+/// </summary>
+/// <returns>FLT_MAX when the camera is inside the sphere</returns>
+float MeshGeometry::GetScreenSize(const Elite::FMatrix4& worldViewProjection, uint32_t screenHeight) const
+{
+	const float pixelsPerUnit{ GetPixelsPerUnit(worldViewProjection, screenHeight) };
+	return pixelsPerUnit == FLT_MAX ? FLT_MAX : Elite::Magnitude(m_BoundsMax - m_BoundsMin) * pixelsPerUnit;
+}
+
+/// <summary>
+/// Split the parsed triangles in meshlets, opaque meshes also get a chain of simplified levels of detail appended to the indexes.
+/// Every level is simplified from the full mesh so its error doesn't pile up over the chain
+/// </summary>
+void MeshGeometry::BuildLods()
+{
+	std::vector<Elite::FPoint3> positions;
+	positions.reserve(m_VertexBuffer.size());
+	for (const Vertex_Input& vertex : m_VertexBuffer)
+		positions.push_back(vertex.position);
+
+	m_MeshletBuffer = MeshOptimizer::BuildMeshlets(m_IndexBuffer, positions, m_IsReordered);
+	m_LodBuffer.push_back(MeshLod{ 0, uint32_t(m_IndexBuffer.size()), 0, uint32_t(m_MeshletBuffer.size()), 0.f });
+	if (!m_IsReordered || m_IndexBuffer.size() < LOD_MIN_TRIANGLE_COUNT * 2 * 3)
+		return;
+
+	Elite::FPoint3 boundsMin{ positions[0] };
+	Elite::FPoint3 boundsMax{ positions[0] };
+	for (const Elite::FPoint3& position : positions)
+	{
+		for (int axis{}; axis < 3; ++axis)
+		{
+			boundsMin[axis] = std::min(boundsMin[axis], position[axis]);
+			boundsMax[axis] = std::max(boundsMax[axis], position[axis]);
+		}
+	}
+	const float maxError{ Elite::Magnitude(boundsMax - boundsMin) * 0.5f * LOD_MAX_RELATIVE_ERROR };
+
+	const std::vector<uint32_t> fullIndexes{ m_IndexBuffer };
+	size_t previousIndexCount{ fullIndexes.size() };
+	float previousError{};
+	for (uint32_t lod{ 1 }; lod < MAX_LOD_COUNT; ++lod)
+	{
+		const size_t targetIndexCount{ fullIndexes.size() / 3 / (size_t(1) << lod) * 3 };
+		float error{};
+		std::vector<uint32_t> lodIndexes{ MeshSimplifier::Simplify(fullIndexes, m_VertexBuffer, targetIndexCount, maxError, error) };
+		if (lodIndexes.empty() || float(lodIndexes.size()) > float(previousIndexCount) * LOD_MIN_REDUCTION)
+			break;
+
+		MeshOptimizer::OptimizeVertexCache(lodIndexes, m_VertexBuffer.size());
+		std::vector<Meshlet> lodMeshlets{ MeshOptimizer::BuildMeshlets(lodIndexes, positions, true) };
+		const uint32_t firstIndex{ uint32_t(m_IndexBuffer.size()) };
+		for (Meshlet& meshlet : lodMeshlets)
+			meshlet.firstIndex += firstIndex;
+
+		//Coarser levels never claim a smaller error, selection walks the chain while the error fits
+		previousError = std::max(previousError, error);
+		m_LodBuffer.push_back(MeshLod{ firstIndex, uint32_t(lodIndexes.size()), uint32_t(m_MeshletBuffer.size()), uint32_t(lodMeshlets.size()), previousError });
+		m_IndexBuffer.insert(m_IndexBuffer.end(), lodIndexes.cbegin(), lodIndexes.cend());
+		m_MeshletBuffer.insert(m_MeshletBuffer.end(), lodMeshlets.cbegin(), lodMeshlets.cend());
+
+		previousIndexCount = lodIndexes.size();
+		if (previousIndexCount < LOD_MIN_TRIANGLE_COUNT * 3)
+			break;
+	}
+}
+
+size_t MeshGeometry::GetVertexStride(VertexFormat format)
+{
+	return format == VertexFormat::COMPACT ? sizeof(Vertex_Compact) : sizeof(Vertex_Input);
+}
+
+/// <summary>
+/// Size and last write time of the source, what the cache is validated against
+/// </summary>
+/// <returns>False when the source doesn't exist</returns>
+bool MeshGeometry::GetSourceStamp(const std::string& sourcePath, uint64_t& size, int64_t& time)
+{
+	std::error_code error{};
+	size = uint64_t(std::filesystem::file_size(sourcePath, error));
+	if (error)
+		return false;
+
+	time = int64_t(std::filesystem::last_write_time(sourcePath, error).time_since_epoch().count());
+	return !error;
+}
+
+/// <summary>
+/// Content hash of an obj, read from its cache when the cache is still valid so the obj is only read on a miss
+/// </summary>
+/// <param name="objPath">Obj file</param>
+/// <param name="isReordered">Whether triangles are reordered, folded into the hash since it changes the geometry built</param>
+/// <param name="hash">Hash of the obj content</param>
+/// <returns>False when the obj can't be read</returns>
+bool MeshGeometry::GetContentHash(const std::string& objPath, bool isReordered, uint64_t& hash)
+{
+	uint64_t sourceSize{};
+	int64_t sourceTime{};
+	if (!GetSourceStamp(objPath, sourceSize, sourceTime))
+		return false;
+
+	MappedFile cacheFile{};
+	MeshCacheHeader header{};
+	if (cacheFile.Open(objPath + ".meshcache") && ReadCacheHeader(cacheFile, sourceSize, sourceTime, isReordered, header))
+	{
+		hash = header.contentHash;
+		return true;
+	}
+
+	hash = Utils::Hash(&isReordered, sizeof(isReordered));
+	return Utils::HashFile(objPath, hash);
+}
+
+/// <summary>
+/// Read the header of a cache file and check it against the obj it has to be built from
+/// </summary>
+/// <returns>False when the cache is stale or doesn't match the vertex layout</returns>
+bool MeshGeometry::ReadCacheHeader(const MappedFile& cacheFile, uint64_t sourceSize, int64_t sourceTime, bool isReordered, MeshCacheHeader& header)
+{
+	if (cacheFile.GetSize() < MESH_CACHE_DATA_OFFSET)
+		return false;
+
+	std::memcpy(&header, cacheFile.GetData(), sizeof(header));
+	return header.magic == MESH_CACHE_MAGIC && header.version == MESH_CACHE_VERSION && header.vertexFormat < uint32_t(VertexFormat::COUNT)
+		&& header.vertexStride == GetVertexStride(VertexFormat(header.vertexFormat)) && header.sourceSize == sourceSize && header.sourceTime == sourceTime && header.isReordered == uint32_t(isReordered);
+}
+
+/// <summary>
+/// Map the vertices and indexes of a cache file, they are used in place without any copy
+/// </summary>
+/// <param name="cachePath">Cache file</param>
+/// <param name="sourceSize">Size of the obj the cache has to be built from</param>
+/// <param name="sourceTime">Last write time of the obj the cache has to be built from</param>
+/// <returns>False when the cache is missing, stale or doesn't match the vertex layout</returns>
+bool MeshGeometry::MapCache(const std::string& cachePath, uint64_t sourceSize, int64_t sourceTime)
+{
+	MappedFile cacheFile{};
+	MeshCacheHeader header{};
+	if (!cacheFile.Open(cachePath) || !ReadCacheHeader(cacheFile, sourceSize, sourceTime, m_IsReordered, header) || header.contentHash != m_ContentHash)
+		return false;
+
+	const size_t vertexByteSize{ size_t(header.vertexCount) * header.vertexStride };
+	const size_t indexByteSize{ size_t(header.indexCount) * sizeof(uint32_t) };
+	const size_t meshletByteSize{ size_t(header.meshletCount) * sizeof(Meshlet) };
+	if (header.lodCount == 0 || cacheFile.GetSize() < MESH_CACHE_DATA_OFFSET + vertexByteSize + indexByteSize + meshletByteSize + size_t(header.lodCount) * sizeof(MeshLod))
+		return false;
+
+	const uint8_t* pData{ cacheFile.GetData() + MESH_CACHE_DATA_OFFSET };
+	m_VertexFormat = VertexFormat(header.vertexFormat);
+	if (m_VertexFormat == VertexFormat::COMPACT)
+		m_CompactVertices = { reinterpret_cast<const Vertex_Compact*>(pData), header.vertexCount };
+	else
+		m_Vertices = { reinterpret_cast<const Vertex_Input*>(pData), header.vertexCount };
+	m_Indexes = { reinterpret_cast<const uint32_t*>(pData + vertexByteSize), header.indexCount };
+	m_Meshlets = { reinterpret_cast<const Meshlet*>(pData + vertexByteSize + indexByteSize), header.meshletCount };
+	m_Lods = { reinterpret_cast<const MeshLod*>(pData + vertexByteSize + indexByteSize + meshletByteSize), header.lodCount };
+	m_BoundsMin = { header.boundsMin[0], header.boundsMin[1], header.boundsMin[2] };
+	m_BoundsMax = { header.boundsMax[0], header.boundsMax[1], header.boundsMax[2] };
+	m_VertexQuantization = VertexCompression::GetQuantization(m_BoundsMin, m_BoundsMax);
+	m_CacheFile = std::move(cacheFile);
+	return true;
+}
+
+/// <summary>
+/// Write the parsed buffers to a cache file, written to a temporary file then renamed so a partial file is never mapped
+/// </summary>
+/// <returns>False when the file couldn't be written, the geometry itself is unaffected</returns>
+bool MeshGeometry::WriteCache(const std::string& cachePath, uint64_t sourceSize, int64_t sourceTime) const
+{
+	MeshCacheHeader header{};
+	header.magic = MESH_CACHE_MAGIC;
+	header.version = MESH_CACHE_VERSION;
+	header.sourceSize = sourceSize;
+	header.sourceTime = sourceTime;
+	header.contentHash = m_ContentHash;
+	header.vertexStride = uint32_t(GetVertexStride(m_VertexFormat));
+	header.vertexFormat = uint32_t(m_VertexFormat);
+	header.isReordered = uint32_t(m_IsReordered);
+	header.vertexCount = uint32_t(GetVertexCount());
+	header.indexCount = uint32_t(m_Indexes.size());
+	header.meshletCount = uint32_t(m_Meshlets.size());
+	header.lodCount = uint32_t(m_Lods.size());
+	for (int axis{}; axis < 3; ++axis)
+	{
+		header.boundsMin[axis] = m_BoundsMin[axis];
+		header.boundsMax[axis] = m_BoundsMax[axis];
+	}
+
+	uint8_t headerBytes[MESH_CACHE_DATA_OFFSET]{};
+	std::memcpy(headerBytes, &header, sizeof(header));
+
+	const std::string tempPath{ cachePath + ".tmp" };
+	{
+		std::ofstream file{ tempPath, std::ios::binary | std::ios::trunc };
+		file.write(reinterpret_cast<const char*>(headerBytes), std::streamsize(sizeof(headerBytes)));
+		const void* pVertices{ m_VertexFormat == VertexFormat::COMPACT ? static_cast<const void*>(m_CompactVertices.data()) : m_Vertices.data() };
+		file.write(static_cast<const char*>(pVertices), std::streamsize(GetVertexCount() * GetVertexStride(m_VertexFormat)));
+		file.write(reinterpret_cast<const char*>(m_Indexes.data()), std::streamsize(m_Indexes.size() * sizeof(uint32_t)));
+		file.write(reinterpret_cast<const char*>(m_Meshlets.data()), std::streamsize(m_Meshlets.size() * sizeof(Meshlet)));
+		file.write(reinterpret_cast<const char*>(m_Lods.data()), std::streamsize(m_Lods.size() * sizeof(MeshLod)));
+		if (!file)
+		{
+			file.close();
+			std::remove(tempPath.c_str());
+			std::cout << "Could not write mesh cache: " << cachePath << std::endl;
+			return false;
+		}
+	}
+
+	std::error_code error{};
+	std::filesystem::rename(tempPath, cachePath, error);
+	if (error)
+	{
+		std::remove(tempPath.c_str());
+		return false;
+	}
+
+	return true;
+}
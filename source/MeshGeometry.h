@@ -0,0 +1,86 @@
+#pragma once
+#include <vector>
+#include <string>
+#include "Enum.h"
+#include "Utils.h"
+#include "MappedFile.h"
+
+struct MeshCacheHeader;
+
+//Triangles of an obj once parsed and optimized, or mapped from its cache file. Never changes after it is built,
+//so the ResourceManager hands the same geometry to every Mesh loaded from the same content
+class MeshGeometry final
+{
+public:
+	//Geometry drawn with a world transform, what a static batch is merged from
+	struct Placement
+	{
+		const MeshGeometry* pGeometry;
+		Elite::FMatrix4 transform;
+	};
+
+	explicit MeshGeometry(const std::string& objPath, bool isReordered, uint64_t contentHash);
+	explicit MeshGeometry(const std::vector<Placement>& placements);
+	MeshGeometry(const MeshGeometry& other) = delete;
+	MeshGeometry(MeshGeometry&& other) noexcept = delete;
+	MeshGeometry& operator=(const MeshGeometry& other) = delete;
+	MeshGeometry& operator=(MeshGeometry&& other) noexcept = delete;
+	~MeshGeometry() = default;
+
+	//Vertices are stored in one format, the other view is empty
+	VertexFormat GetVertexFormat() const { return m_VertexFormat; }
+	size_t GetVertexCount() const { return m_VertexFormat == VertexFormat::COMPACT ? m_CompactVertices.size() : m_Vertices.size(); }
+	const Utils::ArrayView<Vertex_Input>& GetVertices() const { return m_Vertices; }
+	const Utils::ArrayView<Vertex_Compact>& GetCompactVertices() const { return m_CompactVertices; }
+	const VertexQuantization& GetVertexQuantization() const { return m_VertexQuantization; }
+	const Utils::ArrayView<uint32_t>& GetIndexes() const { return m_Indexes; }
+	//Meshlets cover all the indexes in order, the levels of detail follow each other with the full mesh first
+	const Utils::ArrayView<Meshlet>& GetMeshlets() const { return m_Meshlets; }
+	const Utils::ArrayView<MeshLod>& GetLods() const { return m_Lods; }
+	Utils::ArrayView<Meshlet> GetLodMeshlets(uint32_t lod) const { return { m_Meshlets.data() + m_Lods[lod].firstMeshlet, m_Lods[lod].meshletCount }; }
+	uint32_t SelectLod(const Elite::FMatrix4& worldViewProjection, uint32_t screenHeight, float pixelError) const;
+	float GetScreenSize(const Elite::FMatrix4& worldViewProjection, uint32_t screenHeight) const;
+	const Elite::FPoint3& GetBoundsMin() const { return m_BoundsMin; }
+	const Elite::FPoint3& GetBoundsMax() const { return m_BoundsMax; }
+	//Triangles reordered for the vertex cache and overdraw, with simplified levels of detail
+	bool IsReordered() const { return m_IsReordered; }
+	//Merged geometry keeps a draw range per placement, culled before their meshlets. Geometry loaded from an obj has none
+	const std::vector<MeshDrawRange>& GetDrawRanges() const { return m_DrawRanges; }
+	//Hash of the obj content and reordering, zero for merged geometry
+	uint64_t GetContentHash() const { return m_ContentHash; }
+
+	static bool GetContentHash(const std::string& objPath, bool isReordered, uint64_t& hash);
+
+private:
+	//Parsed buffers, left empty when the geometry is mapped from its cache file. Everything reads the views
+	std::vector<Vertex_Input> m_VertexBuffer;
+	std::vector<Vertex_Compact> m_CompactVertexBuffer;
+	std::vector<uint32_t> m_IndexBuffer;
+	std::vector<Meshlet> m_MeshletBuffer;
+	std::vector<MeshLod> m_LodBuffer;
+	MappedFile m_CacheFile;
+	Utils::ArrayView<Vertex_Input> m_Vertices;
+	Utils::ArrayView<Vertex_Compact> m_CompactVertices;
+	Utils::ArrayView<uint32_t> m_Indexes;
+	Utils::ArrayView<Meshlet> m_Meshlets;
+	Utils::ArrayView<MeshLod> m_Lods;
+	Elite::FPoint3 m_BoundsMin;
+	Elite::FPoint3 m_BoundsMax;
+	VertexQuantization m_VertexQuantization;
+	VertexFormat m_VertexFormat;
+	bool m_IsReordered;
+	uint64_t m_ContentHash;
+	std::vector<MeshDrawRange> m_DrawRanges;
+
+	void Build(const std::string& objPath);
+	void Merge(const std::vector<Placement>& placements);
+
+	bool MapCache(const std::string& cachePath, uint64_t sourceSize, int64_t sourceTime);
+	bool WriteCache(const std::string& cachePath, uint64_t sourceSize, int64_t sourceTime) const;
+	void Compact();
+	void BuildLods();
+	float GetPixelsPerUnit(const Elite::FMatrix4& worldViewProjection, uint32_t screenHeight) const;
+	static size_t GetVertexStride(VertexFormat format);
+	static bool GetSourceStamp(const std::string& sourcePath, uint64_t& size, int64_t& time);
+	static bool ReadCacheHeader(const MappedFile& cacheFile, uint64_t sourceSize, int64_t sourceTime, bool isReordered, MeshCacheHeader& header);
+};
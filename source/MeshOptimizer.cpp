@@ -0,0 +1,550 @@
+#include "pch.h"
+#include "MeshOptimizer.h"
+#include <cmath>
+#include <numeric>
+#include <algorithm>
+#include <cfloat>
+
+namespace
+{
+	/// <summary>
+	/// Forsyth vertex score: vertices recently used score high, vertices with few triangles left get a boost so they are finished off
+	/// </summary>
+	/// <param name="cachePosition">Position in the simulated LRU cache, -1 when not cached</param>
+	/// <param name="remainingTriangleCount">Triangles of the vertex not emitted yet</param>
+	float GetVertexScore(int cachePosition, uint32_t remainingTriangleCount)
+	{
+		if (remainingTriangleCount == 0)
+			return -1.f;
+
+		float score{};
+		if (cachePosition >= 0)
+		{
+			//The vertices of the last triangle get a fixed score, they are used by the next one anyway
+			if (cachePosition < 3)
+				score = 0.75f;
+			else
+				score = std::pow(1.f - float(cachePosition - 3) / float(MeshOptimizer::VERTEX_CACHE_SIZE - 3), 1.5f);
+		}
+
+		return score + 2.f / std::sqrt(float(remainingTriangleCount));
+	}
+
+	//FIFO cache simulation as found in hardware, returns the misses of a triangle
+	struct FifoCache
+	{
+		std::vector<uint32_t> timestamps;
+		uint32_t time;
+		int size;
+
+		int AddTriangle(const uint32_t* pTriangle)
+		{
+			int missCount{};
+			for (int corner{}; corner < 3; ++corner)
+			{
+				uint32_t& timestamp{ timestamps[pTriangle[corner]] };
+				if (timestamp == 0 || time - timestamp >= uint32_t(size))
+				{
+					timestamp = ++time;
+					++missCount;
+				}
+			}
+			return missCount;
+		}
+
+		void Clear()
+		{
+			//Moving time past the cache size empties it without touching the timestamps
+			time += uint32_t(size);
+		}
+	};
+
+	/// <summary>
+	/// Bounding sphere around the meshlet bounding box and normal cone of its triangles
+	/// </summary>
+	void ComputeBounds(Meshlet& meshlet, const std::vector<uint32_t>& indexes, const std::vector<Elite::FPoint3>& positions)
+	{
+		const uint32_t* pFirst{ indexes.data() + meshlet.firstIndex };
+		const uint32_t* pLast{ pFirst + meshlet.indexCount };
+
+		Elite::FPoint3 boundsMin{ positions[*pFirst] };
+		Elite::FPoint3 boundsMax{ boundsMin };
+		for (const uint32_t* pIndex{ pFirst }; pIndex < pLast; ++pIndex)
+		{
+			for (int axis{}; axis < 3; ++axis)
+			{
+				boundsMin[axis] = std::min(boundsMin[axis], positions[*pIndex][axis]);
+				boundsMax[axis] = std::max(boundsMax[axis], positions[*pIndex][axis]);
+			}
+		}
+
+		meshlet.center = Elite::FPoint3{ (boundsMin.x + boundsMax.x) * 0.5f, (boundsMin.y + boundsMax.y) * 0.5f, (boundsMin.z + boundsMax.z) * 0.5f };
+		meshlet.radius = 0.f;
+		for (const uint32_t* pIndex{ pFirst }; pIndex < pLast; ++pIndex)
+			meshlet.radius = std::max(meshlet.radius, Elite::Magnitude(positions[*pIndex] - meshlet.center));
+
+		//Cone axis along the average normal, the cutoff is the sine of the widest angle between the axis and a normal
+		std::vector<Elite::FVector3> normals;
+		normals.reserve(meshlet.indexCount / 3);
+		Elite::FVector3 axis{};
+		for (const uint32_t* pTriangle{ pFirst }; pTriangle < pLast; pTriangle += 3)
+		{
+			const Elite::FPoint3& p0{ positions[pTriangle[0]] };
+			Elite::FVector3 normal{ Elite::Cross(positions[pTriangle[1]] - p0, positions[pTriangle[2]] - p0) };
+			const float length{ Elite::Magnitude(normal) };
+			//Degenerate triangles never get rasterized, they don't constrain the cone
+			if (length <= 0.f)
+				continue;
+
+			normal /= length;
+			normals.push_back(normal);
+			axis += normal;
+		}
+
+		meshlet.coneAxis = Elite::FVector3{};
+		meshlet.coneCutoff = 1.f;
+		const float axisLength{ Elite::Magnitude(axis) };
+		if (axisLength <= 0.f)
+			return;
+
+		axis /= axisLength;
+		float minDot{ 1.f };
+		for (const Elite::FVector3& normal : normals)
+			minDot = std::min(minDot, Elite::Dot(axis, normal));
+
+		//Normals spread over a hemisphere or more, some triangle always faces the viewer
+		if (minDot <= 0.f)
+			return;
+
+		meshlet.coneAxis = axis;
+		meshlet.coneCutoff = sqrtf(1.f - minDot * minDot);
+	}
+}
+
+/// <summary>
+/// Reorder triangles for post-transform vertex cache hits, Tom Forsyth's linear speed vertex cache optimization
+/// </summary>
+/// <param name="indexes">Triangle list, reordered in place</param>
+/// <param name="vertexCount">Vertices referenced by the indexes</param>
+void MeshOptimizer::OptimizeVertexCache(std::vector<uint32_t>& indexes, size_t vertexCount)
+{
+	const size_t triangleCount{ indexes.size() / 3 };
+	if (triangleCount == 0)
+		return;
+
+	//Triangles of every vertex, the ones not emitted yet are kept at the front of each list
+	std::vector<uint32_t> remainingCounts(vertexCount, 0);
+	for (size_t idx{}; idx < triangleCount * 3; ++idx)
+		++remainingCounts[indexes[idx]];
+
+	std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+	std::partial_sum(remainingCounts.cbegin(), remainingCounts.cend(), adjacencyOffsets.begin() + 1);
+	std::vector<uint32_t> adjacency(triangleCount * 3);
+	{
+		std::vector<uint32_t> fillCounts(vertexCount, 0);
+		for (size_t idx{}; idx < triangleCount * 3; ++idx)
+			adjacency[adjacencyOffsets[indexes[idx]] + fillCounts[indexes[idx]]++] = uint32_t(idx / 3);
+	}
+
+	std::vector<int> cachePositions(vertexCount, -1);
+	std::vector<float> vertexScores(vertexCount);
+	for (size_t vertexIdx{}; vertexIdx < vertexCount; ++vertexIdx)
+		vertexScores[vertexIdx] = GetVertexScore(-1, remainingCounts[vertexIdx]);
+
+	std::vector<float> triangleScores(triangleCount);
+	for (size_t triangleIdx{}; triangleIdx < triangleCount; ++triangleIdx)
+		triangleScores[triangleIdx] = vertexScores[indexes[triangleIdx * 3]] + vertexScores[indexes[triangleIdx * 3 + 1]] + vertexScores[indexes[triangleIdx * 3 + 2]];
+
+	std::vector<uint8_t> isEmitted(triangleCount, 0);
+	std::vector<uint32_t> result;
+	result.reserve(triangleCount * 3);
+
+	//The cache holds 3 extra entries while a triangle is added, they are the ones evicted
+	std::vector<uint32_t> cache, newCache;
+	cache.reserve(VERTEX_CACHE_SIZE + 3);
+	newCache.reserve(VERTEX_CACHE_SIZE + 3);
+
+	size_t nextCandidate{};
+	int64_t bestTriangle{ int64_t(std::max_element(triangleScores.cbegin(), triangleScores.cend()) - triangleScores.cbegin()) };
+	while (result.size() < triangleCount * 3)
+	{
+		//Nothing left around the cache, restart from the first triangle not emitted
+		if (bestTriangle < 0)
+		{
+			while (isEmitted[nextCandidate])
+				++nextCandidate;
+			bestTriangle = int64_t(nextCandidate);
+		}
+
+		const uint32_t* pTriangle{ indexes.data() + bestTriangle * 3 };
+		isEmitted[size_t(bestTriangle)] = 1;
+		result.insert(result.end(), pTriangle, pTriangle + 3);
+
+		newCache.assign(pTriangle, pTriangle + 3);
+		for (int corner{}; corner < 3; ++corner)
+		{
+			//Move the triangle out of the remaining ones of its vertices
+			const uint32_t vertexIdx{ pTriangle[corner] };
+			uint32_t* pAdjacency{ adjacency.data() + adjacencyOffsets[vertexIdx] };
+			const uint32_t remainingCount{ remainingCounts[vertexIdx]-- };
+			std::swap(*std::find(pAdjacency, pAdjacency + remainingCount, uint32_t(bestTriangle)), pAdjacency[remainingCount - 1]);
+		}
+		for (uint32_t vertexIdx : cache)
+		{
+			if (vertexIdx != pTriangle[0] && vertexIdx != pTriangle[1] && vertexIdx != pTriangle[2])
+				newCache.push_back(vertexIdx);
+		}
+
+		//Rescore the cached and evicted vertices, then the triangles around them
+		for (size_t position{}; position < newCache.size(); ++position)
+		{
+			const uint32_t vertexIdx{ newCache[position] };
+			cachePositions[vertexIdx] = position < size_t(VERTEX_CACHE_SIZE) ? int(position) : -1;
+			vertexScores[vertexIdx] = GetVertexScore(cachePositions[vertexIdx], remainingCounts[vertexIdx]);
+		}
+
+		bestTriangle = -1;
+		float bestScore{ -1.f };
+		for (uint32_t vertexIdx : newCache)
+		{
+			const uint32_t* pAdjacency{ adjacency.data() + adjacencyOffsets[vertexIdx] };
+			for (uint32_t adjacentIdx{}; adjacentIdx < remainingCounts[vertexIdx]; ++adjacentIdx)
+			{
+				const uint32_t triangleIdx{ pAdjacency[adjacentIdx] };
+				const uint32_t* pAdjacent{ indexes.data() + size_t(triangleIdx) * 3 };
+				const float score{ vertexScores[pAdjacent[0]] + vertexScores[pAdjacent[1]] + vertexScores[pAdjacent[2]] };
+				triangleScores[triangleIdx] = score;
+				if (score > bestScore)
+				{
+					bestScore = score;
+					bestTriangle = triangleIdx;
+				}
+			}
+		}
+
+		if (newCache.size() > size_t(VERTEX_CACHE_SIZE))
+			newCache.resize(VERTEX_CACHE_SIZE);
+		cache.swap(newCache);
+	}
+
+	indexes.swap(result);
+}
+
+/// <summary>
+/// Reorder clusters of a vertex cache optimized list so triangles likely to occlude the others are drawn first.
+/// Tipsify cluster sorting: clusters facing away from the mesh center are on its outside and go first
+/// </summary>
+/// <param name="indexes">Vertex cache optimized triangle list, reordered in place</param>
+/// <param name="vertices">Vertices referenced by the indexes</param>
+/// <param name="threshold">Cache miss ratio a cluster may lose to being split smaller, 1 keeps the cache order</param>
+void MeshOptimizer::OptimizeOverdraw(std::vector<uint32_t>& indexes, const std::vector<Vertex_Input>& vertices, float threshold)
+{
+	const size_t triangleCount{ indexes.size() / 3 };
+	if (triangleCount == 0)
+		return;
+
+	FifoCache cache{ std::vector<uint32_t>(vertices.size(), 0), 0, 16 };
+
+	//Hard boundaries where the cache order jumps to a disjoint patch: every vertex of the triangle misses
+	std::vector<size_t> hardClusters;
+	for (size_t triangleIdx{}; triangleIdx < triangleCount; ++triangleIdx)
+	{
+		if (cache.AddTriangle(indexes.data() + triangleIdx * 3) == 3)
+			hardClusters.push_back(triangleIdx);
+	}
+	hardClusters.push_back(triangleCount);
+
+	//Soft boundaries split hard clusters where the cache miss ratio so far is good enough to restart
+	std::vector<size_t> clusters;
+	for (size_t hardIdx{}; hardIdx + 1 < hardClusters.size(); ++hardIdx)
+	{
+		const size_t first{ hardClusters[hardIdx] };
+		const size_t last{ hardClusters[hardIdx + 1] };
+
+		cache.Clear();
+		int clusterMissCount{};
+		for (size_t triangleIdx{ first }; triangleIdx < last; ++triangleIdx)
+			clusterMissCount += cache.AddTriangle(indexes.data() + triangleIdx * 3);
+		const float clusterThreshold{ threshold * float(clusterMissCount) / float(last - first) };
+
+		cache.Clear();
+		clusters.push_back(first);
+		int missCount{};
+		size_t clusterStart{ first };
+		for (size_t triangleIdx{ first }; triangleIdx < last; ++triangleIdx)
+		{
+			missCount += cache.AddTriangle(indexes.data() + triangleIdx * 3);
+			if (triangleIdx + 1 < last && float(missCount) / float(triangleIdx + 1 - clusterStart) <= clusterThreshold)
+			{
+				clusterStart = triangleIdx + 1;
+				clusters.push_back(clusterStart);
+				missCount = 0;
+				cache.Clear();
+			}
+		}
+	}
+	const size_t clusterCount{ clusters.size() };
+	clusters.push_back(triangleCount);
+
+	//Area weighted centroid and normal of every cluster
+	Elite::FVector3 meshCentroid{};
+	for (const Vertex_Input& vertex : vertices)
+		meshCentroid += Elite::FVector3(vertex.position);
+	meshCentroid /= float(std::max(vertices.size(), size_t(1)));
+
+	std::vector<float> sortKeys(clusterCount);
+	for (size_t clusterIdx{}; clusterIdx < clusterCount; ++clusterIdx)
+	{
+		Elite::FVector3 centroid{}, normal{};
+		float area{};
+		for (size_t triangleIdx{ clusters[clusterIdx] }; triangleIdx < clusters[clusterIdx + 1]; ++triangleIdx)
+		{
+			const Elite::FPoint3& p0{ vertices[indexes[triangleIdx * 3]].position };
+			const Elite::FPoint3& p1{ vertices[indexes[triangleIdx * 3 + 1]].position };
+			const Elite::FPoint3& p2{ vertices[indexes[triangleIdx * 3 + 2]].position };
+			const Elite::FVector3 triangleNormal{ Elite::Cross(p1 - p0, p2 - p0) };
+			const float triangleArea{ Elite::Magnitude(triangleNormal) };
+
+			centroid += (Elite::FVector3(p0) + Elite::FVector3(p1) + Elite::FVector3(p2)) * (triangleArea / 3.f);
+			normal += triangleNormal;
+			area += triangleArea;
+		}
+
+		const float normalLength{ Elite::Magnitude(normal) };
+		if (area > 0.f && normalLength > 0.f)
+			sortKeys[clusterIdx] = Elite::Dot(centroid / area - meshCentroid, normal / normalLength);
+	}
+
+	std::vector<size_t> clusterOrder(clusterCount);
+	std::iota(clusterOrder.begin(), clusterOrder.end(), size_t(0));
+	std::stable_sort(clusterOrder.begin(), clusterOrder.end(), [&sortKeys](size_t lhs, size_t rhs) { return sortKeys[lhs] > sortKeys[rhs]; });
+
+	std::vector<uint32_t> result;
+	result.reserve(indexes.size());
+	for (size_t clusterIdx : clusterOrder)
+		result.insert(result.end(), indexes.cbegin() + clusters[clusterIdx] * 3, indexes.cbegin() + clusters[clusterIdx + 1] * 3);
+	indexes.swap(result);
+}
+
+/// <summary>
+/// Renumber vertices in the order the triangles first use them, so vertex fetching walks memory forward.
+/// Vertices no triangle uses are dropped
+/// </summary>
+/// <param name="indexes">Triangle list, remapped in place</param>
+/// <param name="vertices">Vertices, reordered in place</param>
+void MeshOptimizer::OptimizeVertexFetch(std::vector<uint32_t>& indexes, std::vector<Vertex_Input>& vertices)
+{
+	const uint32_t unused{ ~0u };
+	std::vector<uint32_t> remap(vertices.size(), unused);
+	std::vector<Vertex_Input> result;
+	result.reserve(vertices.size());
+
+	for (uint32_t& index : indexes)
+	{
+		if (remap[index] == unused)
+		{
+			remap[index] = uint32_t(result.size());
+			result.push_back(vertices[index]);
+		}
+		index = remap[index];
+	}
+
+	vertices.swap(result);
+}
+
+/// <summary>
+/// Group triangles in meshlets. Reordering meshlets grow from the first triangle left over its neighbours facing about the same way,
+/// picking the ones adding the fewest vertices then the closest in direction and position, so normal cones and spheres stay tight.
+/// Otherwise meshlets are runs of consecutive triangles
+/// </summary>
+/// <param name="indexes">Triangle list, the triangles of every meshlet are made consecutive when reordering</param>
+/// <param name="positions">Positions of the vertices referenced by the indexes</param>
+/// <param name="canReorder">Whether the triangle order can change, meshlets start in the order of the list either way</param>
+/// <returns>Meshlets covering all the triangles in order</returns>
+std::vector<Meshlet> MeshOptimizer::BuildMeshlets(std::vector<uint32_t>& indexes, const std::vector<Elite::FPoint3>& positions, bool canReorder)
+{
+	std::vector<Meshlet> meshlets;
+	const size_t triangleCount{ indexes.size() / 3 };
+	if (triangleCount == 0)
+		return meshlets;
+
+	//Unit normal and centroid of every triangle, with the meshlet size they are compared to
+	std::vector<Elite::FVector3> normals(triangleCount);
+	std::vector<Elite::FPoint3> centroids(triangleCount);
+	float totalArea{};
+	for (size_t triangleIdx{}; triangleIdx < triangleCount; ++triangleIdx)
+	{
+		const Elite::FPoint3& p0{ positions[indexes[triangleIdx * 3]] };
+		const Elite::FPoint3& p1{ positions[indexes[triangleIdx * 3 + 1]] };
+		const Elite::FPoint3& p2{ positions[indexes[triangleIdx * 3 + 2]] };
+		const Elite::FVector3 normal{ Elite::Cross(p1 - p0, p2 - p0) };
+		const float length{ Elite::Magnitude(normal) };
+		normals[triangleIdx] = length > 0.f ? normal / length : Elite::FVector3{};
+		centroids[triangleIdx] = Elite::FPoint3{ (p0.x + p1.x + p2.x) / 3.f, (p0.y + p1.y + p2.y) / 3.f, (p0.z + p1.z + p2.z) / 3.f };
+		totalArea += length * 0.5f;
+	}
+	const float expectedRadius{ std::max(sqrtf(totalArea / float(triangleCount) * float(MESHLET_MAX_TRIANGLE_COUNT)) * 0.5f, FLT_MIN) };
+
+	//Triangles around every position, the candidates to grow a meshlet with. Vertices split on uv or normal seams share their position
+	std::vector<uint32_t> positionIds{};
+	std::vector<uint32_t> adjacencyOffsets(positions.size() + 1, 0);
+	std::vector<uint32_t> adjacency(canReorder ? triangleCount * 3 : 0);
+	if (canReorder)
+	{
+		positionIds = WeldPositions(positions);
+		for (uint32_t index : indexes)
+			++adjacencyOffsets[positionIds[index] + 1];
+		std::partial_sum(adjacencyOffsets.cbegin(), adjacencyOffsets.cend(), adjacencyOffsets.begin());
+
+		std::vector<uint32_t> fillCounts(positions.size(), 0);
+		for (size_t idx{}; idx < triangleCount * 3; ++idx)
+		{
+			const uint32_t positionId{ positionIds[indexes[idx]] };
+			adjacency[adjacencyOffsets[positionId] + fillCounts[positionId]++] = uint32_t(idx / 3);
+		}
+	}
+
+	//Vertices already in the current meshlet carry its stamp
+	std::vector<uint32_t> stamps(positions.size(), 0);
+	uint32_t stamp{};
+	std::vector<uint32_t> meshletVertices;
+	meshletVertices.reserve(MESHLET_MAX_VERTEX_COUNT);
+	auto getNewVertexCount = [&](size_t triangleIdx)
+	{
+		const uint32_t* pTriangle{ indexes.data() + triangleIdx * 3 };
+		int newVertexCount{};
+		for (int corner{}; corner < 3; ++corner)
+		{
+			const bool isRepeated{ (corner > 0 && pTriangle[corner] == pTriangle[0]) || (corner > 1 && pTriangle[corner] == pTriangle[1]) };
+			if (stamps[pTriangle[corner]] != stamp && !isRepeated)
+				++newVertexCount;
+		}
+		return newVertexCount;
+	};
+
+	std::vector<uint8_t> isEmitted(triangleCount, 0);
+	std::vector<uint32_t> result;
+	result.reserve(indexes.size());
+	size_t nextSeed{};
+	while (result.size() < triangleCount * 3)
+	{
+		while (isEmitted[nextSeed])
+			++nextSeed;
+
+		Meshlet meshlet{};
+		meshlet.firstIndex = uint32_t(result.size());
+		meshletVertices.clear();
+		++stamp;
+		Elite::FVector3 normalSum{};
+		Elite::FVector3 centroidSum{};
+
+		int64_t triangleIdx{ int64_t(nextSeed) };
+		while (triangleIdx >= 0)
+		{
+			const uint32_t* pTriangle{ indexes.data() + triangleIdx * 3 };
+			isEmitted[size_t(triangleIdx)] = 1;
+			result.insert(result.end(), pTriangle, pTriangle + 3);
+			meshlet.indexCount += 3;
+			for (int corner{}; corner < 3; ++corner)
+			{
+				if (stamps[pTriangle[corner]] != stamp)
+				{
+					stamps[pTriangle[corner]] = stamp;
+					meshletVertices.push_back(pTriangle[corner]);
+				}
+			}
+			normalSum += normals[size_t(triangleIdx)];
+			centroidSum += Elite::FVector3(centroids[size_t(triangleIdx)]);
+
+			triangleIdx = -1;
+			if (meshlet.indexCount == MESHLET_MAX_TRIANGLE_COUNT * 3)
+				break;
+
+			if (!canReorder)
+			{
+				const size_t nextIdx{ meshlet.firstIndex / 3 + meshlet.indexCount / 3 };
+				if (nextIdx < triangleCount && meshletVertices.size() + getNewVertexCount(nextIdx) <= size_t(MESHLET_MAX_VERTEX_COUNT))
+					triangleIdx = int64_t(nextIdx);
+				continue;
+			}
+
+			const float normalLength{ Elite::Magnitude(normalSum) };
+			const Elite::FVector3 axis{ normalLength > 0.f ? normalSum / normalLength : Elite::FVector3{} };
+			const Elite::FPoint3 center{ Elite::FPoint3(centroidSum / float(meshlet.indexCount / 3)) };
+			int bestNewVertexCount{ 4 };
+			float bestScore{ FLT_MAX };
+			for (uint32_t vertexIdx : meshletVertices)
+			{
+				const uint32_t positionId{ positionIds[vertexIdx] };
+				for (uint32_t adjacentIdx{ adjacencyOffsets[positionId] }; adjacentIdx < adjacencyOffsets[positionId + 1]; ++adjacentIdx)
+				{
+					const uint32_t candidateIdx{ adjacency[adjacentIdx] };
+					if (isEmitted[candidateIdx])
+						continue;
+
+					const int newVertexCount{ getNewVertexCount(candidateIdx) };
+					if (newVertexCount > bestNewVertexCount || meshletVertices.size() + newVertexCount > size_t(MESHLET_MAX_VERTEX_COUNT))
+						continue;
+
+					const float normalDot{ Elite::Dot(normals[candidateIdx], axis) };
+					if (normalDot < MESHLET_MIN_NORMAL_DOT)
+						continue;
+
+					const float score{ 1.f - normalDot + Elite::Magnitude(centroids[candidateIdx] - center) / expectedRadius };
+					if (newVertexCount < bestNewVertexCount || score < bestScore)
+					{
+						bestNewVertexCount = newVertexCount;
+						bestScore = score;
+						triangleIdx = int64_t(candidateIdx);
+					}
+				}
+			}
+		}
+
+		meshlets.push_back(meshlet);
+	}
+
+	indexes.swap(result);
+	ComputeMeshletBounds(meshlets, indexes, positions);
+	return meshlets;
+}
+
+/// <summary>
+/// Find the vertices sharing their position, split on uv or normal seams
+/// </summary>
+/// <returns>For every vertex, the first vertex with the same position</returns>
+std::vector<uint32_t> MeshOptimizer::WeldPositions(const std::vector<Elite::FPoint3>& positions)
+{
+	std::vector<uint32_t> sortedVertices(positions.size());
+	std::iota(sortedVertices.begin(), sortedVertices.end(), 0u);
+	auto isLess = [&positions](uint32_t lhs, uint32_t rhs)
+	{
+		const Elite::FPoint3& p0{ positions[lhs] };
+		const Elite::FPoint3& p1{ positions[rhs] };
+		return p0.x != p1.x ? p0.x < p1.x : (p0.y != p1.y ? p0.y < p1.y : (p0.z != p1.z ? p0.z < p1.z : lhs < rhs));
+	};
+	std::sort(sortedVertices.begin(), sortedVertices.end(), isLess);
+
+	std::vector<uint32_t> remap(positions.size());
+	for (size_t idx{}; idx < sortedVertices.size(); ++idx)
+	{
+		const Elite::FPoint3* pPrevious{ idx > 0 ? &positions[sortedVertices[idx - 1]] : nullptr };
+		const Elite::FPoint3& position{ positions[sortedVertices[idx]] };
+		const bool isShared{ pPrevious && pPrevious->x == position.x && pPrevious->y == position.y && pPrevious->z == position.z };
+		remap[sortedVertices[idx]] = isShared ? remap[sortedVertices[idx - 1]] : sortedVertices[idx];
+	}
+
+	return remap;
+}
+
+/// <summary>
+/// Bounding sphere around the bounding box of every meshlet and normal cone of its triangles
+/// </summary>
+/// <param name="meshlets">Meshlets to bound</param>
+/// <param name="indexes">Triangle list the meshlets cover</param>
+/// <param name="positions">Positions of the vertices referenced by the indexes, the ones the triangles are rasterized with</param>
+void MeshOptimizer::ComputeMeshletBounds(std::vector<Meshlet>& meshlets, const std::vector<uint32_t>& indexes, const std::vector<Elite::FPoint3>& positions)
+{
+	for (Meshlet& meshlet : meshlets)
+		ComputeBounds(meshlet, indexes, positions);
+}
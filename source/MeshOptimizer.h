@@ -0,0 +1,23 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include "Struct.h"
+
+//Load time reordering of indexed triangle lists, so vertices are fetched, transformed and shaded fewer times
+namespace MeshOptimizer
+{
+	//Vertex cache size the triangle order is tuned for, post-transform caches hold 16 to 32 vertices
+	const int VERTEX_CACHE_SIZE{ 32 };
+	//Meshlet limits, small enough for culling to be fine grained, large enough for the culling cost to stay low
+	const int MESHLET_MAX_VERTEX_COUNT{ 64 };
+	const int MESHLET_MAX_TRIANGLE_COUNT{ 128 };
+	//Triangles only join a meshlet within 60 degrees of its average normal, keeping its normal cone narrow enough to cull
+	const float MESHLET_MIN_NORMAL_DOT{ 0.5f };
+
+	void OptimizeVertexCache(std::vector<uint32_t>& indexes, size_t vertexCount);
+	void OptimizeOverdraw(std::vector<uint32_t>& indexes, const std::vector<Vertex_Input>& vertices, float threshold = 1.05f);
+	void OptimizeVertexFetch(std::vector<uint32_t>& indexes, std::vector<Vertex_Input>& vertices);
+	std::vector<Meshlet> BuildMeshlets(std::vector<uint32_t>& indexes, const std::vector<Elite::FPoint3>& positions, bool canReorder);
+	std::vector<uint32_t> WeldPositions(const std::vector<Elite::FPoint3>& positions);
+	void ComputeMeshletBounds(std::vector<Meshlet>& meshlets, const std::vector<uint32_t>& indexes, const std::vector<Elite::FPoint3>& positions);
+}
@@ -0,0 +1,416 @@
+#include "pch.h"
+#include "MeshSimplifier.h"
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <numeric>
+#include <cmath>
+#include <cfloat>
+
+namespace
+{
+	//Open edges keep the surface from shrinking away from them, their constraint planes weigh more than the faces
+	const float BORDER_WEIGHT{ 10.f };
+
+	//Sum of squared distances to a set of weighted planes, as the symmetric 4x4 matrix of the plane equations
+	struct Quadric
+	{
+		float a2, b2, c2, d2;
+		float ab, ac, ad;
+		float bc, bd;
+		float cd;
+		float weight;
+
+		void AddPlane(const Elite::FVector3& normal, float offset, float planeWeight)
+		{
+			a2 += normal.x * normal.x * planeWeight;
+			b2 += normal.y * normal.y * planeWeight;
+			c2 += normal.z * normal.z * planeWeight;
+			d2 += offset * offset * planeWeight;
+			ab += normal.x * normal.y * planeWeight;
+			ac += normal.x * normal.z * planeWeight;
+			ad += normal.x * offset * planeWeight;
+			bc += normal.y * normal.z * planeWeight;
+			bd += normal.y * offset * planeWeight;
+			cd += normal.z * offset * planeWeight;
+			weight += planeWeight;
+		}
+
+		void Add(const Quadric& other)
+		{
+			a2 += other.a2; b2 += other.b2; c2 += other.c2; d2 += other.d2;
+			ab += other.ab; ac += other.ac; ad += other.ad;
+			bc += other.bc; bd += other.bd;
+			cd += other.cd;
+			weight += other.weight;
+		}
+
+		float Evaluate(const Elite::FPoint3& p) const
+		{
+			const float error{ a2 * p.x * p.x + b2 * p.y * p.y + c2 * p.z * p.z + d2
+				+ 2.f * (ab * p.x * p.y + ac * p.x * p.z + bc * p.y * p.z)
+				+ 2.f * (ad * p.x + bd * p.y + cd * p.z) };
+			return std::max(error, 0.f);
+		}
+	};
+
+	struct Collapse
+	{
+		uint32_t from;
+		uint32_t to;
+		float error;
+	};
+
+	/// <summary>
+	/// Squared distance error of moving a position onto another, the average over the planes of both quadrics
+	/// </summary>
+	float GetCollapseError(const Quadric& from, const Quadric& to, const Elite::FPoint3& target)
+	{
+		Quadric merged{ from };
+		merged.Add(to);
+		return merged.weight > 0.f ? merged.Evaluate(target) / merged.weight : 0.f;
+	}
+
+	/// <summary>
+	/// Triangles around every position, as ranges of adjacencyOffsets in adjacency
+	/// </summary>
+	/// <param name="positionIndexes">Triangle list with the corners replaced by their position</param>
+	void GetPositionTriangles(const std::vector<uint32_t>& indexes, const std::vector<uint32_t>& positionIds, std::vector<uint32_t>& positionIndexes,
+		std::vector<uint32_t>& adjacencyOffsets, std::vector<uint32_t>& adjacency)
+	{
+		positionIndexes.resize(indexes.size());
+		for (size_t idx{}; idx < indexes.size(); ++idx)
+			positionIndexes[idx] = positionIds[indexes[idx]];
+
+		adjacencyOffsets.assign(positionIds.size() + 1, 0);
+		for (uint32_t positionId : positionIndexes)
+			++adjacencyOffsets[positionId + 1];
+		std::partial_sum(adjacencyOffsets.cbegin(), adjacencyOffsets.cend(), adjacencyOffsets.begin());
+
+		std::vector<uint32_t> fillCounts(positionIds.size(), 0);
+		adjacency.resize(positionIndexes.size());
+		for (size_t idx{}; idx < positionIndexes.size(); ++idx)
+			adjacency[adjacencyOffsets[positionIndexes[idx]] + fillCounts[positionIndexes[idx]]++] = uint32_t(idx / 3);
+	}
+
+	/// <summary>
+	/// Open edges, the half edges without an opposite one, sorted by their from and to positions
+	/// </summary>
+	/// <returns>Half edges as from in the high and to in the low 32 bits, paired with their triangle</returns>
+	std::vector<std::pair<uint64_t, uint32_t>> GetBorderEdges(const std::vector<uint32_t>& positionIndexes)
+	{
+		std::vector<std::pair<uint64_t, uint32_t>> halfEdges;
+		halfEdges.reserve(positionIndexes.size());
+		for (size_t idx{}; idx < positionIndexes.size(); ++idx)
+		{
+			const uint32_t next{ positionIndexes[idx % 3 == 2 ? idx - 2 : idx + 1] };
+			halfEdges.push_back({ (uint64_t(positionIndexes[idx]) << 32) | next, uint32_t(idx / 3) });
+		}
+		std::sort(halfEdges.begin(), halfEdges.end());
+
+		auto hasHalfEdge = [&halfEdges](uint64_t key)
+		{
+			const auto it{ std::lower_bound(halfEdges.cbegin(), halfEdges.cend(), std::make_pair(key, 0u)) };
+			return it != halfEdges.cend() && it->first == key;
+		};
+
+		std::vector<std::pair<uint64_t, uint32_t>> borderEdges;
+		for (const auto& halfEdge : halfEdges)
+		{
+			if (!hasHalfEdge((halfEdge.first << 32) | (halfEdge.first >> 32)))
+				borderEdges.push_back(halfEdge);
+		}
+		return borderEdges;
+	}
+
+	/// <summary>
+	/// Check the triangles around a position keep facing the same way once it moved
+	/// </summary>
+	bool HasTriangleFlips(uint32_t from, uint32_t to, const std::vector<Elite::FPoint3>& positions, const std::vector<uint32_t>& positionIndexes,
+		const uint32_t* pFirstTriangle, const uint32_t* pLastTriangle)
+	{
+		for (const uint32_t* pTriangle{ pFirstTriangle }; pTriangle < pLastTriangle; ++pTriangle)
+		{
+			const uint32_t* pCorners{ positionIndexes.data() + size_t(*pTriangle) * 3 };
+
+			//Triangles along the collapsed edge disappear
+			if (pCorners[0] == to || pCorners[1] == to || pCorners[2] == to)
+				continue;
+
+			const Elite::FPoint3& p0{ positions[pCorners[0]] };
+			const Elite::FPoint3& p1{ positions[pCorners[1]] };
+			const Elite::FPoint3& p2{ positions[pCorners[2]] };
+			const Elite::FVector3 normal{ Elite::Cross(p1 - p0, p2 - p0) };
+
+			const Elite::FPoint3& q0{ positions[pCorners[0] == from ? to : pCorners[0]] };
+			const Elite::FPoint3& q1{ positions[pCorners[1] == from ? to : pCorners[1]] };
+			const Elite::FPoint3& q2{ positions[pCorners[2] == from ? to : pCorners[2]] };
+			const Elite::FVector3 movedNormal{ Elite::Cross(q1 - q0, q2 - q0) };
+
+			if (Elite::Dot(normal, movedNormal) <= 0.f)
+				return true;
+		}
+
+		return false;
+	}
+
+	/// <summary>
+	/// Distance from a point to the closest point of a triangle
+	/// </summary>
+	/// <remarks>Reference: Real-Time Collision Detection, Christer Ericson, 5.1.5</remarks>
+	float GetTriangleDistance(const Elite::FPoint3& point, const Elite::FPoint3& a, const Elite::FPoint3& b, const Elite::FPoint3& c)
+	{
+		const Elite::FVector3 ab{ b - a };
+		const Elite::FVector3 ac{ c - a };
+		const Elite::FVector3 ap{ point - a };
+		const float d1{ Elite::Dot(ab, ap) };
+		const float d2{ Elite::Dot(ac, ap) };
+		if (d1 <= 0.f && d2 <= 0.f)
+			return Elite::Magnitude(ap);
+
+		const Elite::FVector3 bp{ point - b };
+		const float d3{ Elite::Dot(ab, bp) };
+		const float d4{ Elite::Dot(ac, bp) };
+		if (d3 >= 0.f && d4 <= d3)
+			return Elite::Magnitude(bp);
+
+		const float vc{ d1 * d4 - d3 * d2 };
+		if (vc <= 0.f && d1 >= 0.f && d3 <= 0.f)
+			return Elite::Magnitude(ap - ab * (d1 / (d1 - d3)));
+
+		const Elite::FVector3 cp{ point - c };
+		const float d5{ Elite::Dot(ab, cp) };
+		const float d6{ Elite::Dot(ac, cp) };
+		if (d6 >= 0.f && d5 <= d6)
+			return Elite::Magnitude(cp);
+
+		const float vb{ d5 * d2 - d1 * d6 };
+		if (vb <= 0.f && d2 >= 0.f && d6 <= 0.f)
+			return Elite::Magnitude(ap - ac * (d2 / (d2 - d6)));
+
+		const float va{ d3 * d6 - d5 * d4 };
+		if (va <= 0.f && d4 - d3 >= 0.f && d5 - d6 >= 0.f)
+			return Elite::Magnitude(bp - (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6))));
+
+		const float denominator{ 1.f / (va + vb + vc) };
+		return Elite::Magnitude(ap - ab * (vb * denominator) - ac * (vc * denominator));
+	}
+}
+
+/// <summary>
+/// Simplify a triangle list by collapsing the edges of least quadric error, in passes of independent collapses until the target or the error limit is reached.
+/// Vertices split on seams collapse by position, every corner then takes the vertex of the target position with the closest normal and uv.
+/// Quadrics average the error over the planes of a position, so the error returned is also measured: the distance from every collapsed position to the triangles around where it ended up
+/// </summary>
+/// <param name="indexes">Triangle list to simplify</param>
+/// <param name="vertices">Vertices referenced by the indexes</param>
+/// <param name="targetIndexCount">Index count to get down to</param>
+/// <param name="maxError">Largest quadric error allowed for a collapse, in model space units</param>
+/// <param name="resultError">Largest distance from a source position to the simplified surface around it, in model space units</param>
+/// <returns>Simplified triangle list in the same vertices, can stay above the target when the error limit is reached</returns>
+std::vector<uint32_t> MeshSimplifier::Simplify(const std::vector<uint32_t>& indexes, const std::vector<Vertex_Input>& vertices, size_t targetIndexCount, float maxError, float& resultError)
+{
+	resultError = 0.f;
+	std::vector<uint32_t> result{ indexes };
+	if (result.size() <= targetIndexCount)
+		return result;
+
+	//Collapses work on positions, the first vertex of every position stands for all of its copies
+	std::vector<Elite::FPoint3> positions;
+	positions.reserve(vertices.size());
+	for (const Vertex_Input& vertex : vertices)
+		positions.push_back(vertex.position);
+	const std::vector<uint32_t> positionIds{ MeshOptimizer::WeldPositions(positions) };
+
+	std::vector<uint32_t> copyOffsets(vertices.size() + 1, 0);
+	for (uint32_t positionId : positionIds)
+		++copyOffsets[positionId + 1];
+	std::partial_sum(copyOffsets.cbegin(), copyOffsets.cend(), copyOffsets.begin());
+	std::vector<uint32_t> copies(vertices.size());
+	{
+		std::vector<uint32_t> fillCounts(vertices.size(), 0);
+		for (uint32_t vertexIdx{}; vertexIdx < uint32_t(vertices.size()); ++vertexIdx)
+			copies[copyOffsets[positionIds[vertexIdx]] + fillCounts[positionIds[vertexIdx]]++] = vertexIdx;
+	}
+
+	std::vector<uint32_t> positionIndexes;
+	std::vector<uint32_t> adjacencyOffsets;
+	std::vector<uint32_t> adjacency;
+	//Triangles around every position, for the flip checks, kept up to date after every pass
+	GetPositionTriangles(result, positionIds, positionIndexes, adjacencyOffsets, adjacency);
+
+	//Face planes weighted by area, open edges add a plane perpendicular to their face
+	std::vector<Quadric> quadrics(vertices.size(), Quadric{});
+	for (size_t idx{}; idx + 2 < positionIndexes.size(); idx += 3)
+	{
+		const uint32_t* pCorners{ positionIndexes.data() + idx };
+		const Elite::FPoint3& p0{ positions[pCorners[0]] };
+		Elite::FVector3 normal{ Elite::Cross(positions[pCorners[1]] - p0, positions[pCorners[2]] - p0) };
+		const float doubleArea{ Elite::Magnitude(normal) };
+		if (doubleArea <= 0.f)
+			continue;
+
+		normal /= doubleArea;
+		for (int corner{}; corner < 3; ++corner)
+			quadrics[pCorners[corner]].AddPlane(normal, -Elite::Dot(normal, Elite::FVector3(p0)), doubleArea * 0.5f);
+	}
+
+	for (const auto& borderEdge : GetBorderEdges(positionIndexes))
+	{
+		const uint32_t from{ uint32_t(borderEdge.first >> 32) };
+		const uint32_t to{ uint32_t(borderEdge.first) };
+		const uint32_t* pCorners{ positionIndexes.data() + size_t(borderEdge.second) * 3 };
+		const Elite::FPoint3& p0{ positions[pCorners[0]] };
+		const Elite::FVector3 faceNormal{ Elite::Cross(positions[pCorners[1]] - p0, positions[pCorners[2]] - p0) };
+		const Elite::FVector3 edge{ positions[to] - positions[from] };
+		Elite::FVector3 normal{ Elite::Cross(edge, faceNormal) };
+		const float length{ Elite::Magnitude(normal) };
+		if (length <= 0.f)
+			continue;
+
+		normal /= length;
+		const float offset{ -Elite::Dot(normal, Elite::FVector3(positions[from])) };
+		const float edgeWeight{ Elite::SqrMagnitude(edge) * BORDER_WEIGHT };
+		quadrics[from].AddPlane(normal, offset, edgeWeight);
+		quadrics[to].AddPlane(normal, offset, edgeWeight);
+	}
+
+	const float maxSquaredError{ maxError * maxError };
+	std::vector<Collapse> collapses;
+	std::vector<uint8_t> isBorder(vertices.size());
+	float maxCollapseError{};
+	std::vector<uint32_t> collapseTargets(vertices.size());
+	std::vector<uint8_t> isLocked(vertices.size());
+	//Position every position was collapsed into so far
+	std::vector<uint32_t> finalPositions(vertices.size());
+	std::iota(finalPositions.begin(), finalPositions.end(), 0u);
+
+	while (result.size() > targetIndexCount)
+	{
+		const size_t triangleCount{ result.size() / 3 };
+		//Positions on an open edge only slide along it, so open parts keep their outline instead of shrinking away
+		const std::vector<std::pair<uint64_t, uint32_t>> borderEdges{ GetBorderEdges(positionIndexes) };
+		std::fill(isBorder.begin(), isBorder.end(), 0);
+		for (const auto& borderEdge : borderEdges)
+			isBorder[uint32_t(borderEdge.first >> 32)] = isBorder[uint32_t(borderEdge.first)] = 1;
+
+		auto isBorderEdge = [&borderEdges](uint32_t from, uint32_t to)
+		{
+			const uint64_t key{ (uint64_t(from) << 32) | to };
+			const auto it{ std::lower_bound(borderEdges.cbegin(), borderEdges.cend(), std::make_pair(key, 0u)) };
+			return it != borderEdges.cend() && it->first == key;
+		};
+
+		//Every edge collapses towards its cheapest allowed end
+		collapses.clear();
+		for (size_t idx{}; idx < positionIndexes.size(); ++idx)
+		{
+			const uint32_t p0{ positionIndexes[idx] };
+			const uint32_t p1{ positionIndexes[idx % 3 == 2 ? idx - 2 : idx + 1] };
+			const bool isOpen{ isBorderEdge(p0, p1) };
+			if (p0 >= p1 && !isOpen)
+				continue;
+
+			const bool canCollapse01{ !isBorder[p0] || isOpen };
+			const bool canCollapse10{ !isBorder[p1] || isOpen };
+			const float error01{ canCollapse01 ? GetCollapseError(quadrics[p0], quadrics[p1], positions[p1]) : FLT_MAX };
+			const float error10{ canCollapse10 ? GetCollapseError(quadrics[p1], quadrics[p0], positions[p0]) : FLT_MAX };
+			if (canCollapse01 || canCollapse10)
+				collapses.push_back(error01 <= error10 ? Collapse{ p0, p1, error01 } : Collapse{ p1, p0, error10 });
+		}
+		std::sort(collapses.begin(), collapses.end(), [](const Collapse& lhs, const Collapse& rhs) { return lhs.error < rhs.error; });
+
+		//A collapse removes about 2 triangles, positions touched by a collapse wait for the next pass.
+		//The pass stops at the error of the collapses it would need if none were locked, costlier ones wait for the cheaper ones to unlock
+		const size_t maxCollapseCount{ (triangleCount - targetIndexCount / 3) / 2 + 1 };
+		const float passError{ collapses.empty() ? 0.f : std::min(maxSquaredError, collapses[std::min(maxCollapseCount, collapses.size()) - 1].error) };
+		size_t collapseCount{};
+		std::iota(collapseTargets.begin(), collapseTargets.end(), 0u);
+		std::fill(isLocked.begin(), isLocked.end(), 0);
+		for (const Collapse& collapse : collapses)
+		{
+			if (collapse.error > passError || collapseCount == maxCollapseCount)
+				break;
+
+			if (isLocked[collapse.from] || isLocked[collapse.to])
+				continue;
+
+			const uint32_t* pFirst{ adjacency.data() + adjacencyOffsets[collapse.from] };
+			const uint32_t* pLast{ adjacency.data() + adjacencyOffsets[collapse.from + 1] };
+			if (HasTriangleFlips(collapse.from, collapse.to, positions, positionIndexes, pFirst, pLast))
+				continue;
+
+			collapseTargets[collapse.from] = collapse.to;
+			quadrics[collapse.to].Add(quadrics[collapse.from]);
+			isLocked[collapse.from] = isLocked[collapse.to] = 1;
+			maxCollapseError = std::max(maxCollapseError, collapse.error);
+			++collapseCount;
+		}
+
+		if (collapseCount == 0)
+			break;
+
+		for (uint32_t& finalPosition : finalPositions)
+			finalPosition = collapseTargets[finalPosition];
+
+		//Move the corners of collapsed positions to the copy of the target with the closest attributes, collapsed triangles are dropped
+		size_t writeIdx{};
+		for (size_t idx{}; idx < result.size(); idx += 3)
+		{
+			uint32_t triangle[3];
+			for (int corner{}; corner < 3; ++corner)
+			{
+				const uint32_t vertexIdx{ result[idx + corner] };
+				const uint32_t target{ collapseTargets[positionIds[vertexIdx]] };
+				triangle[corner] = vertexIdx;
+				if (target == positionIds[vertexIdx])
+					continue;
+
+				const Vertex_Input& vertex{ vertices[vertexIdx] };
+				float bestDistance{ FLT_MAX };
+				for (uint32_t copyIdx{ copyOffsets[target] }; copyIdx < copyOffsets[target + 1]; ++copyIdx)
+				{
+					const Vertex_Input& copy{ vertices[copies[copyIdx]] };
+					const float distance{ Elite::SqrMagnitude(copy.normal - vertex.normal) + Elite::SqrMagnitude(copy.uv - vertex.uv) };
+					if (distance < bestDistance)
+					{
+						bestDistance = distance;
+						triangle[corner] = copies[copyIdx];
+					}
+				}
+			}
+
+			const uint32_t id0{ positionIds[triangle[0]] };
+			const uint32_t id1{ positionIds[triangle[1]] };
+			const uint32_t id2{ positionIds[triangle[2]] };
+			if (id0 == id1 || id1 == id2 || id2 == id0)
+				continue;
+
+			result[writeIdx++] = triangle[0];
+			result[writeIdx++] = triangle[1];
+			result[writeIdx++] = triangle[2];
+		}
+		result.resize(writeIdx);
+		GetPositionTriangles(result, positionIds, positionIndexes, adjacencyOffsets, adjacency);
+	}
+
+	//A collapsed position is as far from the simplified surface as the closest triangle around where it ended up.
+	//Parts that collapsed away entirely leave no triangle to measure against, the quadric error of the collapses stands for them
+	resultError = sqrtf(maxCollapseError);
+	for (uint32_t positionId{}; positionId < uint32_t(vertices.size()); ++positionId)
+	{
+		const uint32_t finalPosition{ finalPositions[positionId] };
+		if (finalPosition == positionId)
+			continue;
+
+		float distance{ FLT_MAX };
+		for (uint32_t adjacencyIdx{ adjacencyOffsets[finalPosition] }; adjacencyIdx < adjacencyOffsets[finalPosition + 1]; ++adjacencyIdx)
+		{
+			const uint32_t* pCorners{ positionIndexes.data() + size_t(adjacency[adjacencyIdx]) * 3 };
+			distance = std::min(distance, GetTriangleDistance(positions[positionId], positions[pCorners[0]], positions[pCorners[1]], positions[pCorners[2]]));
+		}
+		if (distance < FLT_MAX)
+			resultError = std::max(resultError, distance);
+	}
+
+	return result;
+}
@@ -0,0 +1,10 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include "Struct.h"
+
+//Quadric error edge collapse simplification (Garland and Heckbert), vertices collapse onto other vertices so every level keeps indexing the same vertex buffer
+namespace MeshSimplifier
+{
+	std::vector<uint32_t> Simplify(const std::vector<uint32_t>& indexes, const std::vector<Vertex_Input>& vertices, size_t targetIndexCount, float maxError, float& resultError);
+}
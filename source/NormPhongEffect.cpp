@@ -3,12 +3,13 @@
 #include "Mesh.h"
 #include "PerspectiveCamera.h"
 #include "Texture.h"
+#include "SoftwarePipeline.h"
+#include "ProjectSettings.h"
 
-NormPhongEffect::NormPhongEffect(const std::wstring& shaderPath, const Texture* pDiffuse, const Texture* pNormal, const Texture* pSpecular, const Texture* pGlossiness)
-	: Effect(shaderPath, MaterialType::OPAQUE_MATERIAL, pDiffuse)
-	, m_pNormalMap(pNormal)
-	, m_pSpecularMap(pSpecular)
-	, m_pGlossinessMap(pGlossiness)
+NormPhongEffect::NormPhongEffect(const std::wstring& shaderPath, TextureHandle diffuseGlossMap, TextureHandle normalMap, TextureHandle specularMap)
+	: Effect(shaderPath, MaterialType::OPAQUE_MATERIAL, diffuseGlossMap)
+	, m_NormalMap(normalMap)
+	, m_SpecularMap(specularMap)
 {}
 
 void NormPhongEffect::LoadToGPU(ID3D11Device* pDevice)
@@ -31,19 +32,27 @@ void NormPhongEffect::LoadToGPU(ID3D11Device* pDevice)
 		m_pVariables.emplace("gWorldMatrix", m_pEffect->GetVariableByName("gWorldMatrix"));
 		m_pVariables.emplace("gNormalMap", m_pEffect->GetVariableByName("gNormalMap"));
 		m_pVariables.emplace("gSpecularMap", m_pEffect->GetVariableByName("gSpecularMap"));
-		m_pVariables.emplace("gGlossinessMap", m_pEffect->GetVariableByName("gGlossinessMap"));
 
-		SetResource("gNormalMap", m_pNormalMap->GetTextureResourceView());
-		SetResource("gSpecularMap", m_pSpecularMap->GetTextureResourceView());
-		SetResource("gGlossinessMap", m_pGlossinessMap->GetTextureResourceView());
+		if (const Texture* pNormalMap{ m_NormalMap.Get() })
+			SetResource("gNormalMap", pNormalMap->GetTextureResourceView());
+		if (const Texture* pSpecularMap{ m_SpecularMap.Get() })
+			SetResource("gSpecularMap", pSpecularMap->GetTextureResourceView());
 	}
 }
 
-void NormPhongEffect::SetParameters(const Mesh* const pMesh, const std::unique_ptr<PerspectiveCamera>& pCam)
+void NormPhongEffect::SetParameters(const Mesh* const pMesh, const Elite::FMatrix4& world, const std::unique_ptr<PerspectiveCamera>& pCam)
 {
-	Effect::SetParameters(pMesh, pCam);
+	Effect::SetParameters(pMesh, world, pCam);
 	SetMatrix("gCameraMatrix", pCam->GetONB().data[0]);
-	SetMatrix("gWorldMatrix", pMesh->GetTransform().data[0]);
+	SetMatrix("gWorldMatrix", world.data[0]);
+}
+
+bool NormPhongEffect::GetContentHash(uint64_t& hash) const
+{
+	bool isHashed{ Effect::GetContentHash(hash) };
+	isHashed &= HashTexture(m_NormalMap, hash);
+	isHashed &= HashTexture(m_SpecularMap, hash);
+	return isHashed;
 }
 
 Elite::RGBColor NormPhongEffect::PixelShading(const Vertex_Output& pixelInfo) const
@@ -53,30 +62,94 @@ Elite::RGBColor NormPhongEffect::PixelShading(const Vertex_Output& pixelInfo) co
 	const float shininess{ 25.f };
 	Elite::FVector3 normal{ pixelInfo.normal };
 
-	if (m_pNormalMap)
-	{
-		Elite::FMatrix3 tSpaceAxis{ pixelInfo.tangent, Elite::Cross(pixelInfo.tangent, pixelInfo.normal), pixelInfo.normal };
-		Elite::RGBColor normalSample{ (m_pNormalMap->Sample(pixelInfo.uv)) };
-		normal = tSpaceAxis * Elite::FVector3(2.f * normalSample.r - 1.f, 2.f * normalSample.g - 1.f, 2.f * normalSample.b - 1.f);
-		Normalize(normal);
-	}
+	const Texture* pDiffuseGlossMap{ m_DiffuseMap.Get() };
+	const Texture* pNormalMap{ m_NormalMap.Get() };
+	const Texture* pSpecularMap{ m_SpecularMap.Get() };
+	const Elite::RGBColor diffuseGloss{ pDiffuseGlossMap ? pDiffuseGlossMap->Sample(pixelInfo.uv) : Elite::RGBColor{ 0.f, 0.f, 0.f, 1.f } };
+	const Elite::RGBColor normalSample{ pNormalMap ? pNormalMap->Sample(pixelInfo.uv) : Elite::RGBColor{ .5f, .5f, 0.f } };
+	const float specular{ pSpecularMap ? pSpecularMap->Sample(pixelInfo.uv).r : 0.f };
+
+	//Only x and y are stored, z is rebuilt from the unit length
+	Elite::FMatrix3 tSpaceAxis{ pixelInfo.tangent, Elite::Cross(pixelInfo.tangent, pixelInfo.normal), pixelInfo.normal };
+	const float normalX{ 2.f * normalSample.r - 1.f };
+	const float normalY{ 2.f * normalSample.g - 1.f };
+	normal = tSpaceAxis * Elite::FVector3(normalX, normalY, sqrtf(std::max(1.f - normalX * normalX - normalY * normalY, 0.f)));
+	Normalize(normal);
 
 	float nDotL{ Elite::Dot(-normal, dirLight.nDirection) };
 
 	pixelColor = dirLight.color * dirLight.intensity * Elite::Clamp(nDotL, 0.f, 1.f);
 	float diffuseStrength = Elite::Clamp(nDotL, 0.f, 1.f) * dirLight.intensity / float(E_PI);
-	diffuseColor = m_pDiffuseMap ? m_pDiffuseMap->Sample(pixelInfo.uv) : diffuseColor;
+	diffuseColor = Elite::RGBColor{ diffuseGloss.r, diffuseGloss.g, diffuseGloss.b };
 	diffuseColor *= diffuseStrength;
 
-	if (m_pSpecularMap && m_pGlossinessMap)
-	{
-		Elite::RGBColor specularReflectance{ m_pSpecularMap->Sample(pixelInfo.uv) };
-		float rDv{ Elite::Dot(dirLight.nDirection - (nDotL + nDotL) * -normal, pixelInfo.viewVector) };
-		rDv = Elite::Clamp(rDv, 0.f, 1.f);
-		specularColor = specularReflectance * pow(rDv, shininess * m_pGlossinessMap->Sample(pixelInfo.uv).r);
-	}
+	float rDv{ Elite::Dot(dirLight.nDirection - (nDotL + nDotL) * -normal, pixelInfo.viewVector) };
+	rDv = Elite::Clamp(rDv, 0.f, 1.f);
+	const float specularStrength{ specular * powf(rDv, shininess * diffuseGloss.a) };
+	specularColor = Elite::RGBColor{ specularStrength, specularStrength, specularStrength };
 
 	pixelColor = diffuseColor + specularColor;
 
 	return pixelColor;
+}
+
+/// <summary>
+/// Vectorized pixel shading, same shading model as PixelShading with one SSE lane per fragment
+/// </summary>
+/// <param name="fragments">Interpolated fragments information</param>
+/// <param name="outColors">Final fragments colors, SDL ARGB packed</param>
+void NormPhongEffect::PixelShadingBlock(const FragmentBlock& fragments, uint32_t outColors[FRAGMENT_BLOCK_SIZE]) const
+{
+	const Simd::FVector3x4 lightDirection{ _mm_set1_ps(.577f), _mm_set1_ps(-.577f), _mm_set1_ps(-.577f) };
+	const __m128 lightIntensity{ _mm_set1_ps(5.f) };
+	const __m128 shininess{ _mm_set1_ps(25.f) };
+	const __m128 one{ _mm_set1_ps(1.f) };
+	const __m128 two{ _mm_set1_ps(2.f) };
+	const FilterMode filterMode{ ProjectSettings::GetInstance()->GetFilterMode() };
+	const __m128 u{ _mm_load_ps(fragments.u) };
+	const __m128 v{ _mm_load_ps(fragments.v) };
+	Simd::FVector3x4 normal{ _mm_load_ps(fragments.normalX), _mm_load_ps(fragments.normalY), _mm_load_ps(fragments.normalZ) };
+	Simd::Normalize(normal);
+
+	//One sample of each map, missing maps read as black with a flat normal
+	const __m128 zero{ _mm_setzero_ps() };
+	const __m128 half{ _mm_set1_ps(.5f) };
+	const Texture* pDiffuseGlossMap{ m_DiffuseMap.Get() };
+	const Texture* pNormalMap{ m_NormalMap.Get() };
+	const Texture* pSpecularMap{ m_SpecularMap.Get() };
+	const Simd::RGBColorx4 diffuseGloss{ pDiffuseGlossMap ? pDiffuseGlossMap->Sample(u, v, filterMode) : Simd::RGBColorx4{ zero, zero, zero, one } };
+	const Simd::RGBColorx4 normalSample{ pNormalMap ? pNormalMap->Sample(u, v, filterMode) : Simd::RGBColorx4{ half, half, zero, one } };
+	const __m128 specular{ pSpecularMap ? pSpecularMap->Sample(u, v, filterMode).r : zero };
+
+	//Only x and y are stored, z is rebuilt from the unit length
+	Simd::FVector3x4 tangent{ _mm_load_ps(fragments.tangentX), _mm_load_ps(fragments.tangentY), _mm_load_ps(fragments.tangentZ) };
+	Simd::Normalize(tangent);
+	const Simd::FVector3x4 binormal{ Simd::Cross(tangent, normal) };
+	const __m128 normalX{ _mm_sub_ps(_mm_mul_ps(two, normalSample.r), one) };
+	const __m128 normalY{ _mm_sub_ps(_mm_mul_ps(two, normalSample.g), one) };
+	const __m128 normalZ{ _mm_sqrt_ps(_mm_max_ps(_mm_sub_ps(one, _mm_add_ps(_mm_mul_ps(normalX, normalX), _mm_mul_ps(normalY, normalY))), zero)) };
+	normal = tangent * normalX + binormal * normalY + normal * normalZ;
+	Simd::Normalize(normal);
+
+	const __m128 nDotL{ _mm_sub_ps(zero, Simd::Dot(normal, lightDirection)) };
+	const __m128 diffuseStrength{ _mm_mul_ps(Simd::Clamp(nDotL, 0.f, 1.f), _mm_mul_ps(lightIntensity, _mm_set1_ps(1.f / float(E_PI)))) };
+
+	Simd::FVector3x4 viewVector{ _mm_load_ps(fragments.viewX), _mm_load_ps(fragments.viewY), _mm_load_ps(fragments.viewZ) };
+	Simd::Normalize(viewVector);
+	const Simd::FVector3x4 reflected{ lightDirection + normal * _mm_add_ps(nDotL, nDotL) };
+	const __m128 rDv{ Simd::Clamp(Simd::Dot(reflected, viewVector), 0.f, 1.f) };
+	const __m128 specularColor{ _mm_mul_ps(specular, Simd::Pow(rDv, _mm_mul_ps(shininess, diffuseGloss.a))) };
+
+	const Simd::RGBColorx4 pixelColor{
+		_mm_add_ps(_mm_mul_ps(diffuseGloss.r, diffuseStrength), specularColor),
+		_mm_add_ps(_mm_mul_ps(diffuseGloss.g, diffuseStrength), specularColor),
+		_mm_add_ps(_mm_mul_ps(diffuseGloss.b, diffuseStrength), specularColor),
+		one };
+
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(outColors), Simd::GetSDL_ARGBColor(pixelColor));
+}
+
+SoftwarePipeline NormPhongEffect::GetSoftwarePipeline(CullMode cullMode, VertexFormat vertexFormat) const
+{
+	return Rasterizer::GetSoftwarePipeline<NormPhongEffect>(cullMode, vertexFormat, GetBlendMode(), IsDepthWriteEnabled());
 }
\ No newline at end of file
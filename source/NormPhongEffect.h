@@ -4,7 +4,10 @@
 class NormPhongEffect final : public Effect
 {
 public:
-	explicit NormPhongEffect(const std::wstring& shaderPath, const Texture* pDiffuse, const Texture* pNormal, const Texture* pSpecular, const Texture* pGlossiness);
+	static constexpr VaryingMask VARYINGS{ GetVaryingFlag(Varying::UV) | GetVaryingFlag(Varying::NORMAL) | GetVaryingFlag(Varying::TANGENT) | GetVaryingFlag(Varying::VIEW_VECTOR) };
+
+	//Diffuse RGB with glossiness in A, tangent space normal XY in R and G (BC5) and a grey specular map
+	explicit NormPhongEffect(const std::wstring& shaderPath, TextureHandle diffuseGlossMap, TextureHandle normalMap, TextureHandle specularMap);
 
 	NormPhongEffect(const NormPhongEffect& other) = delete;
 	NormPhongEffect(NormPhongEffect&& other) noexcept = delete;
@@ -14,13 +17,15 @@ public:
 
 	virtual void LoadToGPU(ID3D11Device* pDevice) override;
 
-	void SetParameters(const Mesh* const pMesh, const std::unique_ptr<PerspectiveCamera>& pCam) override;
+	void SetParameters(const Mesh* const pMesh, const Elite::FMatrix4& world, const std::unique_ptr<PerspectiveCamera>& pCam) override;
 
 	virtual Elite::RGBColor PixelShading(const Vertex_Output& pixelInfo) const override;
+	virtual void PixelShadingBlock(const FragmentBlock& fragments, uint32_t outColors[FRAGMENT_BLOCK_SIZE]) const override;
+	virtual SoftwarePipeline GetSoftwarePipeline(CullMode cullMode, VertexFormat vertexFormat) const override;
+	virtual bool GetContentHash(uint64_t& hash) const override;
 
 private:
-	const Texture* m_pNormalMap;
-	const Texture* m_pSpecularMap;
-	const Texture* m_pGlossinessMap;
+	TextureHandle m_NormalMap;
+	TextureHandle m_SpecularMap;
 };
 
@@ -1,6 +1,8 @@
 #include "pch.h"
 #include "ProjectSettings.h"
 #include "ERenderer.h"
+#include <string>
+#include <cstdlib>
 
 ProjectSettings* ProjectSettings::m_Instance = nullptr;
 
@@ -12,4 +14,21 @@ ProjectSettings* ProjectSettings::GetInstance()
 ProjectSettings::~ProjectSettings()
 {
 	m_Instance = nullptr;
-}
\ No newline at end of file
+}
+
+/// <summary>
+/// Read the scene options given on the command line, unknown arguments are ignored
+/// -vehicles <grid size>: lay the vehicle out on a grid of grid size x grid size instances
+/// -props <grid size>: add a grid of grid size x grid size static props
+/// </summary>
+void ProjectSettings::ParseCommandLine(int argc, char* args[])
+{
+	for (int argIdx{ 1 }; argIdx + 1 < argc; ++argIdx)
+	{
+		const std::string option{ args[argIdx] };
+		if (option == "-vehicles")
+			m_VehicleGridSize = std::max(uint32_t(std::strtoul(args[++argIdx], nullptr, 10)), 1u);
+		else if (option == "-props")
+			m_PropGridSize = uint32_t(std::strtoul(args[++argIdx], nullptr, 10));
+	}
+}
@@ -13,14 +13,28 @@ public:
 	ProjectSettings& operator=(ProjectSettings&&) noexcept = delete;
 	~ProjectSettings();
 
+	void ParseCommandLine(int argc, char* args[]);
+
 	void ToggleFiterMode() { m_FilterMode = Utils::ToggleEnum(m_FilterMode); };
 	void ToggleRenderMode() { m_RenderMode = Utils::ToggleEnum(m_RenderMode); };
 	void ToggleCullMode() { m_CullMode = Utils::ToggleEnum(m_CullMode); };
 	void ToggleTransparency() { m_UseTransparency = !m_UseTransparency; };
+	void ToggleLod() { m_UseLod = !m_UseLod; };
+	void ToggleImpostors() { m_UseImpostors = !m_UseImpostors; };
 	FilterMode GetFilterMode() const { return m_FilterMode; };
 	RenderMode GetRenderMode() const { return m_RenderMode; };
 	CullMode GetCullMode() const { return m_CullMode; };
 	bool UseTransparency() const { return m_UseTransparency; };
+	bool UseLod() const { return m_UseLod; };
+	//Largest simplification error a level of detail may show on screen, in pixels
+	float GetLodPixelError() const { return m_LodPixelError; };
+	bool UseImpostors() const { return m_UseImpostors; };
+	//Meshes with a bounding sphere smaller than this on screen are drawn as their impostor, in pixels
+	float GetImpostorScreenSize() const { return m_ImpostorScreenSize; };
+	//Side of the grid of vehicles in the scene, every vehicle is an instance of the same meshes. Read once when the scene loads
+	uint32_t GetVehicleGridSize() const { return m_VehicleGridSize; };
+	//Side of the grid of static props merged in static batches, 0 for none. Read once when the scene loads
+	uint32_t GetPropGridSize() const { return m_PropGridSize; };
 
 private:
 	ProjectSettings()
@@ -28,6 +42,12 @@ private:
 		, m_RenderMode(RenderMode::SOFTWARE_RENDERING)
 		, m_CullMode(CullMode::MESHBASED)
 		, m_UseTransparency(true)
+		, m_UseLod(true)
+		, m_LodPixelError(1.f)
+		, m_UseImpostors(true)
+		, m_ImpostorScreenSize(64.f)
+		, m_VehicleGridSize(1)
+		, m_PropGridSize(0)
 	{};
 
 	static ProjectSettings* m_Instance;
@@ -35,4 +55,10 @@ private:
 	FilterMode m_FilterMode;
 	CullMode m_CullMode;
 	bool m_UseTransparency;
+	bool m_UseLod;
+	float m_LodPixelError;
+	bool m_UseImpostors;
+	float m_ImpostorScreenSize;
+	uint32_t m_VehicleGridSize;
+	uint32_t m_PropGridSize;
 };
\ No newline at end of file
@@ -2,7 +2,13 @@
 #include <tuple>
 #include "ResourceManager.h"
 #include "Effect.h"
+#include "MeshGeometry.h"
+#include "Mesh.h"
+#include "Impostor.h"
 #include "Utils.h"
+#include "ThreadPool.h"
+#include "VirtualTextureStreamer.h"
+#include <filesystem>
 
 ResourceManager* ResourceManager::m_Instance = nullptr;
 
@@ -17,6 +23,10 @@ ResourceManager::~ResourceManager()
 		Utils::SafeDelete(matPair.second);
 
 	m_Materials.clear();
+
+	//Loads still running write into their futures, let them finish before the textures go away
+	for (auto& texturePair : m_TextureMaps)
+		texturePair.second.wait();
 	m_TextureMaps.clear();
 
 	m_Instance = nullptr;
@@ -27,9 +37,204 @@ void ResourceManager::AddEffect(const std::string& tag, Effect* pEffect)
 	m_Materials.emplace(tag, pEffect);
 }
 
-void ResourceManager::Emplace_Texture(const std::string& tag, const std::string& texturePath)
+/// <summary>
+/// Start loading a texture on the ThreadPool
+/// </summary>
+/// <param name="tag">Texture tag</param>
+/// <param name="texturePath">Image file</param>
+/// <param name="format">Storage format</param>
+/// <param name="residency">Fully resident, or virtual with its pages streamed in when sampled</param>
+/// <returns>Handle resolved on first use</returns>
+TextureHandle ResourceManager::Emplace_Texture(const std::string& tag, const std::string& texturePath, TextureFormat format, TextureResidency residency)
+{
+	return AddTexture(tag, ThreadPool::GetInstance()->Enqueue([tag, texturePath, format, residency]() { return ApplyResidency(tag, std::make_unique<Texture>(texturePath, format), residency); }));
+}
+
+/// <summary>
+/// Bake a texture out of channels of several images, so a material reads its maps with fewer textures
+/// </summary>
+/// <param name="tag">Texture tag</param>
+/// <param name="channels">Source of the R, G, B and A channels, all images must have the same size</param>
+/// <param name="format">Storage format of the packed texture</param>
+/// <param name="residency">Fully resident, or virtual with its pages streamed in when sampled</param>
+/// <returns>Handle resolved on first use</returns>
+TextureHandle ResourceManager::Emplace_PackedTexture(const std::string& tag, const std::array<TextureChannel, 4>& channels, TextureFormat format, TextureResidency residency)
+{
+	return AddTexture(tag, ThreadPool::GetInstance()->Enqueue([tag, channels, format, residency]() { return ApplyResidency(tag, BakePackedTexture(tag, channels, format), residency); }));
+}
+
+/// <summary>
+/// Get the geometry of an obj, loaded once and shared by every mesh asking for the same content
+/// </summary>
+/// <param name="objPath">Obj file</param>
+/// <param name="isReordered">Whether triangles are reordered for the vertex cache and overdraw, which changes the geometry built</param>
+/// <returns>Immutable geometry, released when the last mesh holding it is</returns>
+std::shared_ptr<const MeshGeometry> ResourceManager::Emplace_MeshGeometry(const std::string& objPath, bool isReordered)
+{
+	const std::string pathKey{ objPath + (isReordered ? "|reordered" : "|ordered") };
+	auto contentKeyPair{ m_MeshContentKeys.find(pathKey) };
+	if (contentKeyPair != m_MeshContentKeys.end())
+	{
+		if (std::shared_ptr<const MeshGeometry> pGeometry{ m_MeshGeometries[contentKeyPair->second].lock() })
+			return pGeometry;
+	}
+
+	//A source that can't be read isn't shared, the geometry built for it is empty
+	uint64_t contentKey{};
+	if (!MeshGeometry::GetContentHash(objPath, isReordered, contentKey))
+		return std::make_shared<const MeshGeometry>(objPath, isReordered, contentKey);
+
+	m_MeshContentKeys[pathKey] = contentKey;
+	std::weak_ptr<const MeshGeometry>& pCached{ m_MeshGeometries[contentKey] };
+	std::shared_ptr<const MeshGeometry> pGeometry{ pCached.lock() };
+	if (!pGeometry)
+	{
+		pGeometry = std::make_shared<const MeshGeometry>(objPath, isReordered, contentKey);
+		pCached = pGeometry;
+	}
+
+	return pGeometry;
+}
+
+/// <summary>
+/// Get the impostor of a mesh, captured once for all the meshes sharing its geometry, effect and culling
+/// </summary>
+/// <param name="mesh">Mesh to capture</param>
+/// <param name="objPath">Obj the mesh was loaded from, the impostor is cached next to it in a file per effect and culling</param>
+/// <returns>Impostor released when the last mesh holding it is</returns>
+std::shared_ptr<Impostor> ResourceManager::Emplace_Impostor(const Mesh& mesh, const std::string& objPath)
+{
+	std::weak_ptr<Impostor>& pCached{ m_Impostors[std::make_tuple(mesh.GetGeometry().get(), mesh.GetEffect(), mesh.GetCullMode())] };
+	std::shared_ptr<Impostor> pImpostor{ pCached.lock() };
+	if (!pImpostor)
+	{
+		pImpostor = std::make_shared<Impostor>(mesh, objPath);
+		pCached = pImpostor;
+	}
+
+	return pImpostor;
+}
+
+TextureHandle ResourceManager::AddTexture(const std::string& tag, std::future<std::unique_ptr<Texture>>&& texture)
+{
+	auto texturePair{ m_TextureMaps.emplace(tag, texture.share()) };
+	if (!texturePair.second)
+		std::cout << tag << " texture already exists." << std::endl;
+
+	return TextureHandle{ texturePair.first->second };
+}
+
+/// <summary>
+/// Move a virtual texture to its page file in the temporary directory and hand it to the VirtualTextureStreamer
+/// </summary>
+std::unique_ptr<Texture> ResourceManager::ApplyResidency(const std::string& tag, std::unique_ptr<Texture> pTexture, TextureResidency residency)
+{
+	if (!pTexture || residency != TextureResidency::VIRTUAL)
+		return pTexture;
+
+	std::error_code error{};
+	const std::filesystem::path tempDirectory{ std::filesystem::temp_directory_path(error) };
+	if (error)
+	{
+		std::cout << "No temporary directory for the page file, texture kept resident: " << tag << std::endl;
+		return pTexture;
+	}
+
+	pTexture->Virtualize((tempDirectory / (tag + ".vtpages")).string());
+	if (pTexture->IsVirtual())
+		VirtualTextureStreamer::GetInstance()->Register(pTexture.get());
+
+	return pTexture;
+}
+
+std::unique_ptr<Texture> ResourceManager::BakePackedTexture(const std::string& tag, const std::array<TextureChannel, 4>& channels, TextureFormat format)
 {
-	m_TextureMaps.emplace(std::piecewise_construct, std::forward_as_tuple(tag), std::forward_as_tuple(texturePath));
+	//The baked texture is cached next to its first source, keyed on the channel layout and the content of every source.
+	//A source feeding several channels is only read once, its content is folded in at its first channel
+	std::string cachePath{};
+	uint64_t sourceHash{ Utils::HASH_SEED };
+	bool isHashed{ true };
+	for (size_t channelIdx{}; channelIdx < channels.size(); ++channelIdx)
+	{
+		const TextureChannel& channel{ channels[channelIdx] };
+		if (!channel.texturePath.empty() && cachePath.empty())
+			cachePath = Texture::GetCachePath((std::filesystem::path{ channel.texturePath }.parent_path() / tag).string(), format);
+
+		sourceHash = Utils::Hash(channel.texturePath.data(), channel.texturePath.size(), sourceHash);
+		sourceHash = Utils::Hash(&channel.sourceChannel, sizeof(channel.sourceChannel), sourceHash);
+		const auto firstChannelIt{ std::find_if(channels.cbegin(), channels.cbegin() + channelIdx, [&channel](const TextureChannel& other) { return other.texturePath == channel.texturePath; }) };
+		if (!channel.texturePath.empty() && firstChannelIt == channels.cbegin() + channelIdx)
+			isHashed &= Utils::HashFile(channel.texturePath, sourceHash);
+	}
+
+	if (isHashed && !cachePath.empty())
+	{
+		std::unique_ptr<Texture> pCached{ Texture::LoadCache(cachePath, sourceHash) };
+		if (pCached)
+			return pCached;
+	}
+
+	//Every source image is loaded once, even when it feeds several channels
+	struct Image
+	{
+		uint32_t width;
+		uint32_t height;
+		std::vector<uint32_t> texels;
+	};
+	std::unordered_map<std::string, Image> images;
+	uint32_t width{}, height{};
+	for (const TextureChannel& channel : channels)
+	{
+		if (channel.texturePath.empty() || images.count(channel.texturePath))
+			continue;
+
+		Image& image{ images[channel.texturePath] };
+		if (!Texture::LoadRGBA8Image(channel.texturePath, image.width, image.height, image.texels))
+		{
+			std::cout << "Could not load Texture: " << channel.texturePath << std::endl;
+			return nullptr;
+		}
+
+		if (images.size() > 1 && (image.width != width || image.height != height))
+		{
+			std::cout << tag << " packed texture sources don't have the same size." << std::endl;
+			return nullptr;
+		}
+
+		width = image.width;
+		height = image.height;
+	}
+
+	if (images.empty())
+	{
+		std::cout << tag << " packed texture has no source." << std::endl;
+		return nullptr;
+	}
+
+	std::array<const uint32_t*, 4> pSources{};
+	for (size_t channelIdx{}; channelIdx < channels.size(); ++channelIdx)
+	{
+		if (!channels[channelIdx].texturePath.empty())
+			pSources[channelIdx] = images[channels[channelIdx].texturePath].texels.data();
+	}
+
+	std::vector<uint32_t> texels(size_t(width) * height);
+	for (size_t texelIdx{}; texelIdx < texels.size(); ++texelIdx)
+	{
+		uint32_t texel{};
+		for (uint32_t channelIdx{}; channelIdx < channels.size(); ++channelIdx)
+		{
+			const uint32_t value{ pSources[channelIdx] ? (pSources[channelIdx][texelIdx] >> (channels[channelIdx].sourceChannel * 8)) & 0xFF : 0xFFu };
+			texel |= value << (channelIdx * 8);
+		}
+		texels[texelIdx] = texel;
+	}
+
+	std::unique_ptr<Texture> pTexture{ std::make_unique<Texture>(width, height, texels, format, isHashed ? sourceHash : 0) };
+	if (isHashed)
+		pTexture->WriteCache(cachePath, sourceHash);
+
+	return pTexture;
 }
 
 Effect* ResourceManager::GetEffect(const std::string& tag) const
@@ -42,20 +247,23 @@ Effect* ResourceManager::GetEffect(const std::string& tag) const
 	return nullptr;
 }
 
-const Texture* ResourceManager::GetTexture(const std::string& tag) const
+TextureHandle ResourceManager::GetTexture(const std::string& tag) const
 {
 	auto texturePair{ m_TextureMaps.find(tag) };
 	if (texturePair != m_TextureMaps.end())
-		return &texturePair->second;
+		return TextureHandle{ texturePair->second };
 
 	std::cout << tag << " texture doesn't exist." << std::endl;
-	return nullptr;
+	return TextureHandle{};
 }
 
 void ResourceManager::LoadReseourcesToGPU(ID3D11Device* pDevice)
 {
 	for (auto& texturePair : m_TextureMaps)
-		texturePair.second.LoadToGPU(pDevice);
+	{
+		if (Texture* pTexture{ texturePair.second.get().get() })
+			pTexture->LoadToGPU(pDevice);
+	}
 
 	for (auto& matPair : m_Materials)
 		matPair.second->LoadToGPU(pDevice);
@@ -67,5 +275,8 @@ void ResourceManager::ClearResourcesOnGPU()
 		matPair.second->ClearGPUResources();
 
 	for (auto& texturePair : m_TextureMaps)
-		texturePair.second.ClearGPUResources();
+	{
+		if (Texture* pTexture{ texturePair.second.get().get() })
+			pTexture->ClearGPUResources();
+	}
 }
\ No newline at end of file
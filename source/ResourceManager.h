@@ -1,8 +1,15 @@
 #pragma once
 #include <unordered_map>
+#include <map>
+#include <tuple>
+#include <array>
+#include <memory>
 #include "Texture.h"
 
 class Effect;
+class MeshGeometry;
+class Impostor;
+class Mesh;
 
 class ResourceManager
 {
@@ -16,20 +23,34 @@ public:
 	~ResourceManager();
 
 	void AddEffect(const std::string& tag, Effect* pEffect);
-	void Emplace_Texture(const std::string& tag, const std::string& texturePath);
+	TextureHandle Emplace_Texture(const std::string& tag, const std::string& texturePath, TextureFormat format = TextureFormat::RGBA8, TextureResidency residency = TextureResidency::RESIDENT);
+	TextureHandle Emplace_PackedTexture(const std::string& tag, const std::array<TextureChannel, 4>& channels, TextureFormat format = TextureFormat::RGBA8, TextureResidency residency = TextureResidency::RESIDENT);
+	std::shared_ptr<const MeshGeometry> Emplace_MeshGeometry(const std::string& objPath, bool isReordered);
+	std::shared_ptr<Impostor> Emplace_Impostor(const Mesh& mesh, const std::string& objPath);
 
 	Effect* GetEffect(const std::string& tag) const;
-	const Texture* GetTexture(const std::string& tag) const;
+	TextureHandle GetTexture(const std::string& tag) const;
 
 	void LoadReseourcesToGPU(ID3D11Device* pDevice);
 	void ClearResourcesOnGPU();
 
 private:
-	ResourceManager() : m_Materials{}, m_TextureMaps{}{};
+	ResourceManager() : m_Materials{}, m_TextureMaps{}, m_MeshGeometries{}, m_MeshContentKeys{}, m_Impostors{}{};
 
 	static ResourceManager* m_Instance;
 
 	std::unordered_map<std::string, Effect*> m_Materials;
-	std::unordered_map<std::string, Texture> m_TextureMaps;
+	//Textures are decoded on the ThreadPool, a loading texture is only waited for when it is used
+	std::unordered_map<std::string, std::shared_future<std::unique_ptr<Texture>>> m_TextureMaps;
+	//Geometry is keyed on the content of its obj so identical files under other paths share it too, the path only saves hashing the file again.
+	//Meshes own the geometry, it is released with the last mesh using it
+	std::unordered_map<uint64_t, std::weak_ptr<const MeshGeometry>> m_MeshGeometries;
+	std::unordered_map<std::string, uint64_t> m_MeshContentKeys;
+	//An impostor only depends on what it captures: the geometry, the effect and the culling it is rendered with
+	std::map<std::tuple<const MeshGeometry*, const Effect*, CullMode>, std::weak_ptr<Impostor>> m_Impostors;
+
+	TextureHandle AddTexture(const std::string& tag, std::future<std::unique_ptr<Texture>>&& texture);
+	static std::unique_ptr<Texture> BakePackedTexture(const std::string& tag, const std::array<TextureChannel, 4>& channels, TextureFormat format);
+	static std::unique_ptr<Texture> ApplyResidency(const std::string& tag, std::unique_ptr<Texture> pTexture, TextureResidency residency);
 };
 
@@ -0,0 +1,169 @@
+//-----------------------------------
+// GLOBAL
+//-----------------------------------
+
+float4x4 gWorldViewProjection : WorldViewProjection;
+Texture2D gColorAtlas : ColorAtlas;
+Texture2D gDepthAtlas : DepthAtlas;
+
+//Frame the quad shows, in the model space of the mesh
+float3 gCenter;
+float3 gRight;
+float3 gUp;
+float3 gDirection;
+float gRadius;
+float2 gFrameUV;
+float gFrameScale;
+
+
+//-----------------------------------
+// Vertex Structs
+//-----------------------------------
+struct VS_OUTPUT
+{
+	float4 Position : SV_POSITION;
+	float2 Uv : TEXCOORD;
+};
+
+struct PS_OUTPUT
+{
+	float4 Color : SV_TARGET;
+	float Depth : SV_DEPTH;
+};
+
+//-----------------------------------
+// UV Point Sampler
+//-----------------------------------
+SamplerState samplerPoint
+{
+	Filter = MIN_MAG_MIP_POINT;
+	AddressU = Clamp;
+	AddressV = Clamp;
+};
+
+//-----------------------------------
+// UV Linear Sampler
+//-----------------------------------
+SamplerState samplerLinear
+{
+	Filter = MIN_MAG_MIP_LINEAR;
+	AddressU = Clamp;
+	AddressV = Clamp;
+};
+
+//-----------------------------------
+// UV Anisotropic Sampler
+//-----------------------------------
+SamplerState samplerAnisotropic
+{
+	Filter = ANISOTROPIC;
+	AddressU = Clamp;
+	AddressV = Clamp;
+};
+
+//-----------------------------------
+// Model space position
+//-----------------------------------
+float3 GetFramePosition(float2 uv, float depth)
+{
+	//Cell local coordinates, top left corner first like the atlas rows
+	float2 st = (uv - gFrameUV) / gFrameScale;
+	return gCenter + gRight * gRadius * (2.f * st.x - 1.f) + gUp * gRadius * (1.f - 2.f * st.y) + gDirection * gRadius * (1.f - 2.f * depth);
+}
+
+float4 GetClipPosition(float3 position)
+{
+	//invert z component due to left handed system
+	position.z = -position.z;
+	return mul(float4(position, 1.f), gWorldViewProjection);
+}
+
+//-----------------------------------
+// Filtered Shading
+//-----------------------------------
+PS_OUTPUT FilteredShading(SamplerState sState, VS_OUTPUT input)
+{
+	//The coverage captured in alpha is filtered like the colors, half covered texels are the silhouette
+	float4 color = gColorAtlas.Sample(sState, input.Uv);
+	clip(color.a - 0.5f);
+
+	//Moved back onto the captured surface so the quad is depth tested like the mesh
+	float depth = gDepthAtlas.Sample(samplerPoint, input.Uv).r;
+	float4 clipPosition = GetClipPosition(GetFramePosition(input.Uv, depth));
+
+	PS_OUTPUT output = (PS_OUTPUT)0;
+	output.Color = float4(color.rgb, 1.f);
+	output.Depth = clipPosition.z / clipPosition.w;
+	return output;
+}
+
+//-----------------------------------
+// Vertex Shader
+//-----------------------------------
+VS_OUTPUT VS(uint vertexId : SV_VertexID)
+{
+	//Triangle strip of the 4 quad corners, no vertex buffer bound
+	float2 st = float2(vertexId & 1, vertexId >> 1);
+
+	VS_OUTPUT output = (VS_OUTPUT)0;
+	output.Uv = gFrameUV + st * gFrameScale;
+	output.Position = GetClipPosition(GetFramePosition(output.Uv, 0.5f));
+	return output;
+}
+
+//-----------------------------------
+// Pixel Shader
+//-----------------------------------
+PS_OUTPUT PS_Point(VS_OUTPUT input)
+{
+	return FilteredShading(samplerPoint, input);
+}
+
+//-----------------------------------
+// Pixel Shader
+//-----------------------------------
+PS_OUTPUT PS_Linear(VS_OUTPUT input)
+{
+	return FilteredShading(samplerLinear, input);
+}
+
+//-----------------------------------
+// Pixel Shader
+//-----------------------------------
+PS_OUTPUT PS_Anisotropic(VS_OUTPUT input)
+{
+	return FilteredShading(samplerAnisotropic, input);
+}
+
+//-----------------------------------
+// Technique
+//-----------------------------------
+technique11 PointTechnique
+{
+	pass P0
+	{
+		SetVertexShader(CompileShader(vs_5_0, VS()));
+		SetGeometryShader(NULL);
+		SetPixelShader(CompileShader(ps_5_0, PS_Point()));
+	}
+}
+
+technique11 LinearTechnique
+{
+	pass P0
+	{
+		SetVertexShader(CompileShader(vs_5_0, VS()));
+		SetGeometryShader(NULL);
+		SetPixelShader(CompileShader(ps_5_0, PS_Linear()));
+	}
+}
+
+technique11 AnisotropicTechnique
+{
+	pass P0
+	{
+		SetVertexShader(CompileShader(vs_5_0, VS()));
+		SetGeometryShader(NULL);
+		SetPixelShader(CompileShader(ps_5_0, PS_Anisotropic()));
+	}
+}
@@ -5,10 +5,10 @@
 float4x4 gWorldViewProjection : WorldViewProjection;
 float4x4 gCameraMatrix : CameraMatrix;
 float4x4 gWorldMatrix : WorldMatrix;
+//Diffuse RGB with glossiness in A, tangent space normal XY in R and G (BC5), grey specular
 Texture2D gDiffuseMap : DiffuseMap;
 Texture2D gNormalMap : NormalMap;
 Texture2D gSpecularMap : SpecularMap;
-Texture2D gGlossinessMap : GlossinessMap;
 float3 gLightDir = float3(0.577f, -0.577f, 0.577f);
 float gShininess = 25.f;
 float gLightIntensity = 6.f;
@@ -71,22 +71,24 @@ SamplerState samplerAnisotropic
 //-----------------------------------
 // DiffuseShading
 //-----------------------------------
-float3 FilteredDiffuseShading(SamplerState sState, float3 normal, float2 uv)
+float3 FilteredDiffuseShading(float4 diffuseGloss, float3 normal)
 {
 	float specStrength = saturate(dot(gLightDir, -normal)) / gPi * gLightIntensity;
-	return gDiffuseMap.Sample(sState, uv).rgb * specStrength;
+	return diffuseGloss.rgb * specStrength;
 }
 
 //-----------------------------------
 // NormalMapping
 //-----------------------------------
-float3 FilteredNormalMapping(SamplerState sState, float3 normal, float3 tangent, float2 uv)
+float3 FilteredNormalMapping(float2 normalXY, float3 normal, float3 tangent)
 {
 	normal = normalize(normal);
 	tangent = normalize(tangent);
 
-	float3 normalSample = gNormalMap.Sample(sState, uv).rgb;
-	normalSample = normalSample * 2 - 1;
+	//Only x and y are stored
+	float3 normalSample;
+	normalSample.xy = normalXY * 2 - 1;
+	normalSample.z = sqrt(saturate(1 - dot(normalSample.xy, normalSample.xy)));
 	float3x3 tangentSpaceMatrix = float3x3(tangent, cross(normal, tangent), normal);
 
 	return normalize(mul(normalSample, tangentSpaceMatrix));
@@ -95,12 +97,12 @@ float3 FilteredNormalMapping(SamplerState sState, float3 normal, float3 tangent,
 //-----------------------------------
 // PhongShading
 //-----------------------------------
-float3 FilteredPhongShading(SamplerState sState, float3 normal, float4 worldPosition, float2 uv)
+float3 FilteredPhongShading(float4 diffuseGloss, float specular, float3 normal, float4 worldPosition)
 {
 	float3 r = reflect(gLightDir, normal);
 	float3 viewVector = normalize(gCameraMatrix[3].xyz - worldPosition.xyz);
 	float3 rDvv = saturate(dot(r, viewVector));
-	return gSpecularMap.Sample(sState, uv).rgb * pow(rDvv, gShininess * gGlossinessMap.Sample(sState, uv).r);
+	return specular * pow(rDvv, gShininess * diffuseGloss.a);
 }
 
 //-----------------------------------
@@ -108,9 +110,12 @@ float3 FilteredPhongShading(SamplerState sState, float3 normal, float4 worldPosi
 //-----------------------------------
 float4 FilteredShading(SamplerState sState, VS_OUTPUT input)
 {
-	float3 normal = FilteredNormalMapping(sState, input.Normal, input.Tangent, input.Uv);
-	float3 diffuseColor = FilteredDiffuseShading(sState, normal, input.Uv);
-	float3 specularColor = FilteredPhongShading(sState, normal, input.WorldPosition, input.Uv);
+	float4 diffuseGloss = gDiffuseMap.Sample(sState, input.Uv);
+	float2 normalXY = gNormalMap.Sample(sState, input.Uv).rg;
+	float specular = gSpecularMap.Sample(sState, input.Uv).r;
+	float3 normal = FilteredNormalMapping(normalXY, input.Normal, input.Tangent);
+	float3 diffuseColor = FilteredDiffuseShading(diffuseGloss, normal);
+	float3 specularColor = FilteredPhongShading(diffuseGloss, specular, normal, input.WorldPosition);
 
 	float3 finalShading = (diffuseColor + specularColor);
 	return float4(finalShading, 1.f);
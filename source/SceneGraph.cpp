@@ -2,11 +2,21 @@
 #include "SceneGraph.h"
 #include "Mesh.h"
 #include "Utils.h"
+#include "MeshGeometry.h"
+#include <unordered_map>
+
+namespace
+{
+	//Batches are split past this vertex count, it keeps 32 bit indexes far from overflowing
+	const size_t MAX_STATIC_BATCH_VERTEX_COUNT{ size_t(1) << 20 };
+}
 
 SceneGraph::SceneGraph(SceneGraph&& other) noexcept
 	: m_pMeshes{ std::move(other.m_pMeshes) }
+	, m_pStaticMeshes{ std::move(other.m_pStaticMeshes) }
 {
 	other.m_pMeshes.clear();
+	other.m_pStaticMeshes.clear();
 }
 
 SceneGraph& SceneGraph::operator=(SceneGraph&& other) noexcept
@@ -17,6 +27,8 @@ SceneGraph& SceneGraph::operator=(SceneGraph&& other) noexcept
 	m_pMeshes.clear();
 
 	m_pMeshes = std::move(other.m_pMeshes);
+	m_pStaticMeshes = std::move(other.m_pStaticMeshes);
+	other.m_pStaticMeshes.clear();
 
 	return *this;
 }
@@ -27,6 +39,7 @@ SceneGraph::~SceneGraph()
 		Utils::SafeDelete(pMesh);
 
 	m_pMeshes.clear();
+	m_pStaticMeshes.clear();
 }
 
 const std::vector<Mesh*>& SceneGraph::GetMeshes() const
@@ -39,6 +52,79 @@ void SceneGraph::AddMesh(Mesh* pNewMesh)
 	m_pMeshes.push_back(pNewMesh);
 }
 
+void SceneGraph::AddStaticMesh(Mesh* pNewMesh)
+{
+	m_pMeshes.push_back(pNewMesh);
+	m_pStaticMeshes.push_back(pNewMesh);
+}
+
+/// <summary>
+/// Merge the static meshes drawn with the same effect and culling in batches, every instance pre-transformed to world space.
+/// A batch takes the place of its first mesh in the draw order and the merged meshes are deleted.
+/// Has to run before the scene is loaded on the GPU
+/// </summary>
+void SceneGraph::BuildStaticBatches()
+{
+	struct Batch
+	{
+		Effect* pEffect;
+		CullMode cullMode;
+		size_t vertexCount;
+		std::vector<MeshGeometry::Placement> placements;
+	};
+
+	//Merged geometry only keeps the full level of detail and gets no impostor, meshes relying on either are left as separate draws
+	m_pStaticMeshes.erase(std::remove_if(m_pStaticMeshes.begin(), m_pStaticMeshes.end(), [](const Mesh* pMesh) { return pMesh->GetLods().size() > 1 || pMesh->GetImpostor(); }), m_pStaticMeshes.end());
+
+	std::vector<Batch> batches;
+	std::unordered_map<const Mesh*, std::vector<size_t>> batchesByFirstMesh;
+	for (const Mesh* pMesh : m_pStaticMeshes)
+	{
+		for (const Elite::FMatrix4& transform : pMesh->GetInstanceTransforms())
+		{
+			auto batchIt{ std::find_if(batches.begin(), batches.end(), [pMesh](const Batch& batch)
+				{ return batch.pEffect == pMesh->GetEffect() && batch.cullMode == pMesh->GetCullMode() && batch.vertexCount + pMesh->GetVertexCount() <= MAX_STATIC_BATCH_VERTEX_COUNT; }) };
+			if (batchIt == batches.end())
+			{
+				batchesByFirstMesh[pMesh].push_back(batches.size());
+				batches.push_back(Batch{ pMesh->GetEffect(), pMesh->GetCullMode(), 0, {} });
+				batchIt = batches.end() - 1;
+			}
+
+			batchIt->vertexCount += pMesh->GetVertexCount();
+			batchIt->placements.push_back(MeshGeometry::Placement{ pMesh->GetGeometry().get(), transform });
+		}
+	}
+
+	std::vector<Mesh*> pMeshes;
+	pMeshes.reserve(m_pMeshes.size());
+	for (Mesh* pMesh : m_pMeshes)
+	{
+		if (std::find(m_pStaticMeshes.cbegin(), m_pStaticMeshes.cend(), pMesh) == m_pStaticMeshes.cend())
+		{
+			pMeshes.push_back(pMesh);
+			continue;
+		}
+
+		auto batchIdxPair{ batchesByFirstMesh.find(pMesh) };
+		if (batchIdxPair == batchesByFirstMesh.end())
+			continue;
+
+		for (size_t batchIdx : batchIdxPair->second)
+		{
+			const Batch& batch{ batches[batchIdx] };
+			pMeshes.push_back(new Mesh(std::make_shared<const MeshGeometry>(batch.placements), batch.pEffect, batch.cullMode));
+		}
+	}
+
+	//Placements point into the geometry of the merged meshes, they go once every batch is built
+	for (Mesh* pMesh : m_pStaticMeshes)
+		Utils::SafeDelete(pMesh);
+
+	m_pStaticMeshes.clear();
+	m_pMeshes = std::move(pMeshes);
+}
+
 void SceneGraph::LoadSceneOnGPU(ID3D11Device* pDevice)
 {
 	for (Mesh* pMesh : m_pMeshes)
@@ -6,7 +6,7 @@ class Mesh;
 class SceneGraph
 {
 public:
-	explicit SceneGraph() : m_pMeshes{} {};
+	explicit SceneGraph() : m_pMeshes{}, m_pStaticMeshes{} {};
 	SceneGraph(const SceneGraph& other) = delete;
 	SceneGraph(SceneGraph&& other) noexcept;
 	SceneGraph& operator=(const SceneGraph& other) = delete;
@@ -15,6 +15,9 @@ public:
 
 	const std::vector<Mesh*>& GetMeshes() const;
 	void AddMesh(Mesh* pNewMesh);
+	//Static meshes never move, they are drawn like any mesh until BuildStaticBatches merges them
+	void AddStaticMesh(Mesh* pNewMesh);
+	void BuildStaticBatches();
 
 	void LoadSceneOnGPU(ID3D11Device* pDevice);
 	void ClearSceneFromGPU();
@@ -22,5 +25,7 @@ public:
 
 private:
 	std::vector<Mesh*> m_pMeshes;
+	//Also in m_pMeshes, waiting to be merged
+	std::vector<Mesh*> m_pStaticMeshes;
 };
 
@@ -0,0 +1,168 @@
+#pragma once
+#include <immintrin.h>
+#include <cstdint>
+#include <cfloat>
+
+//4-wide SSE (up to SSE4.1) helpers used by the batched software shading, one lane per fragment
+namespace Simd
+{
+	struct FVector3x4
+	{
+		__m128 x;
+		__m128 y;
+		__m128 z;
+	};
+
+	struct RGBColorx4
+	{
+		__m128 r;
+		__m128 g;
+		__m128 b;
+		__m128 a;
+	};
+
+#pragma region Vector
+	inline FVector3x4 operator+(const FVector3x4& v0, const FVector3x4& v1)
+	{
+		return { _mm_add_ps(v0.x, v1.x), _mm_add_ps(v0.y, v1.y), _mm_add_ps(v0.z, v1.z) };
+	}
+
+	inline FVector3x4 operator-(const FVector3x4& v0, const FVector3x4& v1)
+	{
+		return { _mm_sub_ps(v0.x, v1.x), _mm_sub_ps(v0.y, v1.y), _mm_sub_ps(v0.z, v1.z) };
+	}
+
+	inline FVector3x4 operator*(const FVector3x4& v, __m128 scale)
+	{
+		return { _mm_mul_ps(v.x, scale), _mm_mul_ps(v.y, scale), _mm_mul_ps(v.z, scale) };
+	}
+
+	inline __m128 Dot(const FVector3x4& v0, const FVector3x4& v1)
+	{
+		return _mm_add_ps(_mm_add_ps(_mm_mul_ps(v0.x, v1.x), _mm_mul_ps(v0.y, v1.y)), _mm_mul_ps(v0.z, v1.z));
+	}
+
+	inline FVector3x4 Cross(const FVector3x4& v0, const FVector3x4& v1)
+	{
+		return {
+			_mm_sub_ps(_mm_mul_ps(v0.y, v1.z), _mm_mul_ps(v0.z, v1.y)),
+			_mm_sub_ps(_mm_mul_ps(v0.z, v1.x), _mm_mul_ps(v0.x, v1.z)),
+			_mm_sub_ps(_mm_mul_ps(v0.x, v1.y), _mm_mul_ps(v0.y, v1.x)) };
+	}
+
+	inline void Normalize(FVector3x4& v)
+	{
+		const __m128 invLength{ _mm_div_ps(_mm_set1_ps(1.f), _mm_sqrt_ps(Dot(v, v))) };
+		v = v * invLength;
+	}
+#pragma endregion
+
+#pragma region Scalar
+	inline __m128 Clamp(__m128 value, float min, float max)
+	{
+		return _mm_min_ps(_mm_max_ps(value, _mm_set1_ps(min)), _mm_set1_ps(max));
+	}
+
+	/*! Polynomial evaluation, c0 + x * (c1 + x * (c2 + ...)) */
+	inline __m128 Polynomial5(__m128 x, float c0, float c1, float c2, float c3, float c4, float c5)
+	{
+		__m128 result{ _mm_set1_ps(c5) };
+		result = _mm_add_ps(_mm_mul_ps(result, x), _mm_set1_ps(c4));
+		result = _mm_add_ps(_mm_mul_ps(result, x), _mm_set1_ps(c3));
+		result = _mm_add_ps(_mm_mul_ps(result, x), _mm_set1_ps(c2));
+		result = _mm_add_ps(_mm_mul_ps(result, x), _mm_set1_ps(c1));
+		return _mm_add_ps(_mm_mul_ps(result, x), _mm_set1_ps(c0));
+	}
+
+	/*! Approximated log2 for positive values, minimax polynomial over the mantissa */
+	/*! Reference: http://jrfonseca.blogspot.com/2008/09/fast-sse2-pow-tables-or-polynomials.html */
+	inline __m128 Log2(__m128 x)
+	{
+		const __m128i bits{ _mm_castps_si128(_mm_max_ps(x, _mm_set1_ps(FLT_MIN))) };
+		const __m128 exponent{ _mm_cvtepi32_ps(_mm_sub_epi32(_mm_srli_epi32(bits, 23), _mm_set1_epi32(127))) };
+		const __m128 mantissa{ _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(bits, _mm_set1_epi32(0x007FFFFF)), _mm_set1_epi32(0x3F800000))) };
+
+		__m128 poly{ Polynomial5(mantissa, 3.1157899f, -3.3241990f, 2.5988452f, -1.2315303f, 3.1821337e-1f, -3.4436006e-2f) };
+		poly = _mm_mul_ps(poly, _mm_sub_ps(mantissa, _mm_set1_ps(1.f)));
+		return _mm_add_ps(poly, exponent);
+	}
+
+	/*! Approximated exp2, integer part goes in the exponent, polynomial for the fraction */
+	inline __m128 Exp2(__m128 x)
+	{
+		x = Clamp(x, -126.99999f, 129.f);
+		const __m128i intPart{ _mm_cvtps_epi32(_mm_sub_ps(x, _mm_set1_ps(0.5f))) };
+		const __m128 fracPart{ _mm_sub_ps(x, _mm_cvtepi32_ps(intPart)) };
+		const __m128 expIntPart{ _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(intPart, _mm_set1_epi32(127)), 23)) };
+		const __m128 expFracPart{ Polynomial5(fracPart, 9.9999994e-1f, 6.9315308e-1f, 2.4015361e-1f, 5.5826318e-2f, 8.9893397e-3f, 1.8775767e-3f) };
+		return _mm_mul_ps(expIntPart, expFracPart);
+	}
+
+	inline __m128 Pow(__m128 x, __m128 y)
+	{
+		return Exp2(_mm_mul_ps(Log2(x), y));
+	}
+#pragma endregion
+
+#pragma region Color
+	/*! Fixed point lerp of 4 RGBA8 colors, all channels at once in 16 bit lanes, t per color in [0, 32767] (1.15 fixed point) */
+	inline __m128i LerpRGBA8(__m128i c0, __m128i c1, __m128i t)
+	{
+		//Spread every color weight over the 4 channels of that color
+		const __m128i t16{ _mm_packs_epi32(t, t) };
+		const __m128i tPairs{ _mm_unpacklo_epi16(t16, t16) };
+		const __m128i tLow{ _mm_unpacklo_epi32(tPairs, tPairs) };
+		const __m128i tHigh{ _mm_unpackhi_epi32(tPairs, tPairs) };
+
+		//c0 + (c1 - c0) * t, mulhrs rounds and the channel differences stay within 9 bits
+		const __m128i zero{ _mm_setzero_si128() };
+		const __m128i c0Low{ _mm_unpacklo_epi8(c0, zero) };
+		const __m128i c0High{ _mm_unpackhi_epi8(c0, zero) };
+		const __m128i low{ _mm_add_epi16(c0Low, _mm_mulhrs_epi16(_mm_sub_epi16(_mm_unpacklo_epi8(c1, zero), c0Low), tLow)) };
+		const __m128i high{ _mm_add_epi16(c0High, _mm_mulhrs_epi16(_mm_sub_epi16(_mm_unpackhi_epi8(c1, zero), c0High), tHigh)) };
+		return _mm_packus_epi16(low, high);
+	}
+
+	/*! Same as RGBColor::MaxToOne followed by GetSDL_ARGBColor, for 4 colors */
+	inline __m128i GetSDL_ARGBColor(const RGBColorx4& c)
+	{
+		const __m128 maxValue{ _mm_max_ps(c.r, _mm_max_ps(c.g, c.b)) };
+		const __m128 scale{ _mm_div_ps(_mm_set1_ps(255.f), _mm_max_ps(maxValue, _mm_set1_ps(1.f))) };
+		const __m128i max{ _mm_set1_epi32(255) };
+		const __m128i zero{ _mm_setzero_si128() };
+
+		auto toByte = [&](__m128 channel, __m128 channelScale) {
+			return _mm_min_epi32(_mm_max_epi32(_mm_cvttps_epi32(_mm_mul_ps(channel, channelScale)), zero), max);
+		};
+
+		__m128i color{ toByte(c.b, scale) };
+		color = _mm_or_si128(color, _mm_slli_epi32(toByte(c.g, scale), 8));
+		color = _mm_or_si128(color, _mm_slli_epi32(toByte(c.r, scale), 16));
+		color = _mm_or_si128(color, _mm_slli_epi32(toByte(c.a, _mm_set1_ps(255.f)), 24));
+		return color;
+	}
+
+	/*! Unpack 4 RGBA8 colors, R in the lowest byte */
+	inline RGBColorx4 GetColorFromRGBA8(__m128i c)
+	{
+		const __m128i byteMask{ _mm_set1_epi32(0xFF) };
+		const __m128 inv255{ _mm_set1_ps(1.f / 255.f) };
+		return {
+			_mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(c, byteMask)), inv255),
+			_mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(c, 8), byteMask)), inv255),
+			_mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(c, 16), byteMask)), inv255),
+			_mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(c, 24)), inv255) };
+	}
+
+	inline RGBColorx4 GetColorFromSDL_ARGB(__m128i c)
+	{
+		const __m128i byteMask{ _mm_set1_epi32(0xFF) };
+		const __m128 inv255{ _mm_set1_ps(1.f / 255.f) };
+		return {
+			_mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(c, 16), byteMask)), inv255),
+			_mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(c, 8), byteMask)), inv255),
+			_mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(c, byteMask)), inv255),
+			_mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(c, 24)), inv255) };
+	}
+#pragma endregion
+}
@@ -0,0 +1,831 @@
+#pragma once
+#include "Struct.h"
+#include "Enum.h"
+#include "Mesh.h"
+#include "Impostor.h"
+#include "Utils.h"
+#include "SimdUtils.h"
+#include "VertexCompression.h"
+
+namespace Rasterizer
+{
+	//Screen space plane equation: value(x, y) = dx * x + dy * y + c
+	struct PlaneEquation
+	{
+		float dx;
+		float dy;
+		float c;
+	};
+
+	//Vertex stage output: raster space position with w holding 1/w, and the varyings of the effect already divided by w.
+	//Arrays keep at least one element for effects without varyings.
+	template<int VARYING_COUNT>
+	struct TransformedVertex
+	{
+		Elite::FPoint4 position;
+		float varyings[VARYING_COUNT > 0 ? VARYING_COUNT : 1];
+		bool isInside;
+	};
+
+	//Per triangle interpolation setup, varyings are stored divided by w for perspective correction
+	template<int VARYING_COUNT>
+	struct TriangleSetup
+	{
+		PlaneEquation barycentric[TRI_VERTEX_COUNT];
+		PlaneEquation depth;
+		PlaneEquation invW;
+		PlaneEquation varyings[VARYING_COUNT > 0 ? VARYING_COUNT : 1];
+	};
+
+	//Plane values of the 4 lanes of a quad, stepped incrementally along a row of quads and from row to row
+	struct QuadPlane
+	{
+		__m128 value;
+		__m128 quadStep;
+		__m128 rowStep;
+	};
+
+	//Vertex attribute reads of every vertex format, compact vertices are decoded attribute by attribute as the vertex stage needs them
+	inline Elite::FPoint3 GetPosition(const Vertex_Input& vertex, const VertexQuantization&) { return vertex.position; }
+	inline Elite::FVector3 GetNormal(const Vertex_Input& vertex) { return vertex.normal; }
+	inline Elite::FVector3 GetTangent(const Vertex_Input& vertex) { return vertex.tangent; }
+	inline Elite::FVector2 GetUV(const Vertex_Input& vertex) { return vertex.uv; }
+
+	inline Elite::FPoint3 GetPosition(const Vertex_Compact& vertex, const VertexQuantization& quantization) { return VertexCompression::DecodePosition(vertex, quantization); }
+	inline Elite::FVector3 GetNormal(const Vertex_Compact& vertex) { return VertexCompression::DecodeOctahedral(vertex.normal); }
+	inline Elite::FVector3 GetTangent(const Vertex_Compact& vertex) { return VertexCompression::DecodeOctahedral(vertex.tangent); }
+	inline Elite::FVector2 GetUV(const Vertex_Compact& vertex) { return VertexCompression::DecodeUV(vertex); }
+
+	template<VertexFormat FORMAT>
+	using InputVertex = std::conditional_t<FORMAT == VertexFormat::COMPACT, Vertex_Compact, Vertex_Input>;
+
+	template<VertexFormat FORMAT>
+	inline const Utils::ArrayView<InputVertex<FORMAT>>& GetInputVertices(const Mesh& mesh)
+	{
+		if constexpr (FORMAT == VertexFormat::COMPACT)
+			return mesh.GetCompactVertices();
+		else
+			return mesh.GetVertices();
+	}
+
+	/// <summary>
+	/// Vertex stage, only the varyings of the mask are computed
+	/// </summary>
+	/// <param name="vertex">Vertex in model space, Vertex_Input or Vertex_Compact</param>
+	/// <param name="quantization">Position decoding of compact vertices</param>
+	/// <param name="parameters">Mesh transforms and camera information</param>
+	/// <param name="frameBuffer">Render target, used for the viewport size</param>
+	/// <param name="output">Output vertex in raster space, isInside is false if the vertex is outside of the view frustum</param>
+	template<VaryingMask VARYINGS, typename VERTEX>
+	inline void TransformVertex(const VERTEX& vertex, const VertexQuantization& quantization, const DrawParameters& parameters, const FrameBuffer& frameBuffer, TransformedVertex<GetVaryingCount(VARYINGS)>& output)
+	{
+		//To View Space
+		const Elite::FPoint3 modelPosition{ GetPosition(vertex, quantization) };
+		Elite::FPoint4 position{ parameters.worldViewProjection * Elite::FPoint4(modelPosition) };
+
+		//Projection
+		position.x /= position.w;
+		position.y /= position.w;
+		position.z /= position.w;
+		position.w = 1 / position.w;
+
+		output.isInside = position.x >= -1.f && position.x <= 1.f
+			&& position.y >= -1.f && position.y <= 1.f
+			&& position.z >= 0.f && position.z <= 1.f;
+
+		//Triangles touching a vertex out of the frustum are dropped, their varyings are never read
+		if (!output.isInside)
+			return;
+
+		//To ScreenSpace
+		position.x = (position.x + 1.f) / 2.f * frameBuffer.width;
+		position.y = (1 - position.y) / 2.f * frameBuffer.height;
+		output.position = position;
+
+		const float invW{ position.w };
+		float* pVaryings{ output.varyings };
+		auto store = [&](float value) { *pVaryings++ = value * invW; };
+
+		if constexpr (HasVarying(VARYINGS, Varying::UV))
+		{
+			const Elite::FVector2 uv{ GetUV(vertex) };
+			store(uv.x);
+			store(uv.y);
+		}
+
+		if constexpr (HasVarying(VARYINGS, Varying::NORMAL))
+		{
+			const Elite::FVector3 normal{ parameters.world * Elite::FVector4(GetNormal(vertex)) };
+			store(normal.x);
+			store(normal.y);
+			store(normal.z);
+		}
+
+		if constexpr (HasVarying(VARYINGS, Varying::TANGENT))
+		{
+			const Elite::FVector3 tangent{ parameters.world * Elite::FVector4(GetTangent(vertex)) };
+			store(tangent.x);
+			store(tangent.y);
+			store(tangent.z);
+		}
+
+		if constexpr (HasVarying(VARYINGS, Varying::VIEW_VECTOR))
+		{
+			const Elite::FVector3 viewVector{ parameters.cameraPos - Elite::FPoint3(parameters.world * Elite::FPoint4(modelPosition)) };
+			store(viewVector.x);
+			store(viewVector.y);
+			store(viewVector.z);
+		}
+	}
+
+	/// <summary>
+	/// Prepare the transient vertex buffer for a new draw, invalidating the vertices transformed by the previous one
+	/// </summary>
+	/// <param name="buffer">Renderer owned scratch buffer</param>
+	/// <param name="vertexCount">Vertex count of the mesh to draw</param>
+	/// <returns>Transformed vertex storage, one element per mesh vertex</returns>
+	template<typename VERTEX>
+	inline VERTEX* MapTransientVertices(TransientVertexBuffer& buffer, size_t vertexCount)
+	{
+		static_assert(std::is_trivially_destructible<VERTEX>::value, "Transient vertices live in raw bytes and are never destroyed.");
+
+		if (buffer.vertices.size() < vertexCount * sizeof(VERTEX))
+			buffer.vertices.resize(vertexCount * sizeof(VERTEX));
+
+		if (buffer.stamps.size() < vertexCount)
+			buffer.stamps.resize(vertexCount, 0);
+
+		//Stamp 0 marks never transformed vertices, reset everything when wrapping around
+		if (++buffer.stamp == 0)
+		{
+			std::fill(buffer.stamps.begin(), buffer.stamps.end(), 0);
+			buffer.stamp = 1;
+		}
+
+		return reinterpret_cast<VERTEX*>(buffer.vertices.data());
+	}
+
+	/// <summary>
+	/// Build the screen space plane going through a value at every vertex
+	/// </summary>
+	inline PlaneEquation GetPlaneEquation(const PlaneEquation barycentric[TRI_VERTEX_COUNT], float v0, float v1, float v2)
+	{
+		return PlaneEquation{
+			barycentric[0].dx * v0 + barycentric[1].dx * v1 + barycentric[2].dx * v2,
+			barycentric[0].dy * v0 + barycentric[1].dy * v1 + barycentric[2].dy * v2,
+			barycentric[0].c * v0 + barycentric[1].c * v1 + barycentric[2].c * v2 };
+	}
+
+	/// <summary>
+	/// Start stepping a plane at the quad with its top left pixel on (x, y)
+	/// </summary>
+	inline QuadPlane GetQuadPlane(const PlaneEquation& plane, float x, float y)
+	{
+		const float origin{ plane.dx * x + plane.dy * y + plane.c };
+		return QuadPlane{
+			_mm_add_ps(_mm_set1_ps(origin), _mm_set_ps(plane.dx + plane.dy, plane.dy, plane.dx, 0.f)),
+			_mm_set1_ps(2.f * plane.dx),
+			_mm_set1_ps(2.f * plane.dy) };
+	}
+
+	/// <summary>
+	/// Triangle setup: culling and plane equations of the barycentric weights, depth, 1/w and attributes/w, culling resolved at compile time
+	/// </summary>
+	/// <param name="vertices">Transformed triangle vertices</param>
+	/// <param name="setup">output plane equations</param>
+	/// <returns>Return false if the triangle is degenerate or culled</returns>
+	template<CullMode CULL, int VARYING_COUNT>
+	inline bool SetupTriangle(const TransformedVertex<VARYING_COUNT>* const vertices[TRI_VERTEX_COUNT], TriangleSetup<VARYING_COUNT>& setup)
+	{
+		const Elite::FPoint4& p0{ vertices[0]->position };
+		const Elite::FPoint4& p1{ vertices[1]->position };
+		const Elite::FPoint4& p2{ vertices[2]->position };
+
+		//Positive area for counter clockwise triangles on screen, i.e. front faces
+		const float area{ (p1.x - p2.x) * (p0.y - p2.y) - (p1.y - p2.y) * (p0.x - p2.x) };
+		if constexpr (CULL == CullMode::BACKFACE)
+		{
+			if (area < FLT_EPSILON)
+				return false;
+		}
+		else if constexpr (CULL == CullMode::FRONTFACE)
+		{
+			if (area > -FLT_EPSILON)
+				return false;
+		}
+		else
+		{
+			if (abs(area) < FLT_EPSILON)
+				return false;
+		}
+
+		//Barycentric weights are the edge functions normalized by the triangle area
+		const float invArea{ 1.f / area };
+		PlaneEquation* barycentric{ setup.barycentric };
+		barycentric[0] = { (p2.y - p1.y) * invArea, (p1.x - p2.x) * invArea, (p1.y * (p2.x - p1.x) - p1.x * (p2.y - p1.y)) * invArea };
+		barycentric[1] = { (p0.y - p2.y) * invArea, (p2.x - p0.x) * invArea, (p2.y * (p0.x - p2.x) - p2.x * (p0.y - p2.y)) * invArea };
+		barycentric[2] = { -barycentric[0].dx - barycentric[1].dx, -barycentric[0].dy - barycentric[1].dy, 1.f - barycentric[0].c - barycentric[1].c };
+
+		//Depth is affine in screen space, everything else is interpolated perspective correct through 1/w
+		setup.depth = GetPlaneEquation(barycentric, p0.z, p1.z, p2.z);
+		setup.invW = GetPlaneEquation(barycentric, p0.w, p1.w, p2.w);
+
+		for (int varying{}; varying < VARYING_COUNT; ++varying)
+			setup.varyings[varying] = GetPlaneEquation(barycentric, vertices[0]->varyings[varying], vertices[1]->varyings[varying], vertices[2]->varyings[varying]);
+
+		return true;
+	}
+
+	/// <summary>
+	/// Depth test of the covered lanes of a quad, a fragment passes with a smaller depth than the stored one
+	/// </summary>
+	/// <returns>Coverage mask of the lanes passing the test</returns>
+	inline uint32_t TestDepth(__m128 depth, uint32_t coverageMask, const uint32_t pixelIndices[FRAGMENT_BLOCK_SIZE], const FrameBuffer& frameBuffer)
+	{
+		auto depthBuffer = [&](int lane) { return (coverageMask & (1 << lane)) ? frameBuffer.pDepthBuffer[pixelIndices[lane]] : 0.f; };
+		const __m128 storedDepth{ _mm_set_ps(depthBuffer(3), depthBuffer(2), depthBuffer(1), depthBuffer(0)) };
+		return coverageMask & uint32_t(_mm_movemask_ps(_mm_cmplt_ps(depth, storedDepth)));
+	}
+
+	/// <summary>
+	/// Pixel loop of a triangle: walks its aabb by 2x2 quads aligned on even pixels, stepping the plane equations of the setup from quad to quad
+	/// </summary>
+	/// <param name="setup">Plane equations of the triangle</param>
+	/// <param name="positions">Raster space positions of the vertices</param>
+	/// <param name="frameBuffer">Render target, the walk is clamped to it</param>
+	/// <param name="shadeQuad">Called for every quad with a pixel inside the triangle, with its top left pixel, coverage mask, depth, 1/w and varyings/w</param>
+	template<int VARYING_COUNT, typename QUAD_SHADER>
+	inline void RasterizeTriangle(const TriangleSetup<VARYING_COUNT>& setup, const Elite::FPoint4* const positions[TRI_VERTEX_COUNT], const FrameBuffer& frameBuffer, QUAD_SHADER&& shadeQuad)
+	{
+		Aabb2D aabb{ GetAabb2D(positions, frameBuffer.width, frameBuffer.height) };
+		const uint32_t left{ aabb.left & ~1u };
+		const uint32_t bot{ aabb.bot & ~1u };
+
+		QuadPlane rowBarycentric[TRI_VERTEX_COUNT];
+		for (int vertexIdx{}; vertexIdx < TRI_VERTEX_COUNT; ++vertexIdx)
+			rowBarycentric[vertexIdx] = GetQuadPlane(setup.barycentric[vertexIdx], float(left), float(bot));
+		QuadPlane rowDepth{ GetQuadPlane(setup.depth, float(left), float(bot)) };
+		QuadPlane rowInvW{ GetQuadPlane(setup.invW, float(left), float(bot)) };
+		QuadPlane rowVaryings[VARYING_COUNT > 0 ? VARYING_COUNT : 1];
+		for (int varying{}; varying < VARYING_COUNT; ++varying)
+			rowVaryings[varying] = GetQuadPlane(setup.varyings[varying], float(left), float(bot));
+
+		const __m128 zero{ _mm_setzero_ps() };
+
+		for (uint32_t r = bot; r < aabb.top; r += 2)
+		{
+			__m128 barycentric[TRI_VERTEX_COUNT]{ rowBarycentric[0].value, rowBarycentric[1].value, rowBarycentric[2].value };
+			__m128 depth{ rowDepth.value };
+			__m128 invW{ rowInvW.value };
+			__m128 varyings[VARYING_COUNT > 0 ? VARYING_COUNT : 1];
+			for (int varying{}; varying < VARYING_COUNT; ++varying)
+				varyings[varying] = rowVaryings[varying].value;
+
+			const uint32_t rowMask{ r + 1 < aabb.top ? 0xFu : 0x3u };
+			for (uint32_t c = left; c < aabb.right; c += 2)
+			{
+				//Inside test on the 3 barycentric weights
+				uint32_t coverageMask{ rowMask & (c + 1 < aabb.right ? 0xFu : 0x5u) };
+				const __m128 inside{ _mm_and_ps(_mm_and_ps(_mm_cmpgt_ps(barycentric[0], zero), _mm_cmpgt_ps(barycentric[1], zero)), _mm_cmpge_ps(barycentric[2], zero)) };
+				coverageMask &= uint32_t(_mm_movemask_ps(inside));
+				if (coverageMask != 0)
+					shadeQuad(c, r, coverageMask, depth, invW, varyings);
+
+				//Step to the next quad
+				for (int vertexIdx{}; vertexIdx < TRI_VERTEX_COUNT; ++vertexIdx)
+					barycentric[vertexIdx] = _mm_add_ps(barycentric[vertexIdx], rowBarycentric[vertexIdx].quadStep);
+				depth = _mm_add_ps(depth, rowDepth.quadStep);
+				invW = _mm_add_ps(invW, rowInvW.quadStep);
+				for (int varying{}; varying < VARYING_COUNT; ++varying)
+					varyings[varying] = _mm_add_ps(varyings[varying], rowVaryings[varying].quadStep);
+			}
+
+			//Step to the next row of quads
+			for (int vertexIdx{}; vertexIdx < TRI_VERTEX_COUNT; ++vertexIdx)
+				rowBarycentric[vertexIdx].value = _mm_add_ps(rowBarycentric[vertexIdx].value, rowBarycentric[vertexIdx].rowStep);
+			rowDepth.value = _mm_add_ps(rowDepth.value, rowDepth.rowStep);
+			rowInvW.value = _mm_add_ps(rowInvW.value, rowInvW.rowStep);
+			for (int varying{}; varying < VARYING_COUNT; ++varying)
+				rowVaryings[varying].value = _mm_add_ps(rowVaryings[varying].value, rowVaryings[varying].rowStep);
+		}
+	}
+
+	/// <summary>
+	/// Recover the perspective correct varyings of the mask and store them in the fragment block
+	/// </summary>
+	/// <param name="varyings">Interpolated varyings divided by w, in Varying order</param>
+	/// <param name="w">Interpolated w of every lane</param>
+	/// <param name="fragments">Block to fill, the members of the varyings outside of the mask are left untouched</param>
+	template<VaryingMask VARYINGS>
+	inline void StoreVaryings(const __m128 varyings[], __m128 w, FragmentBlock& fragments)
+	{
+		const __m128* pVarying{ varyings };
+		auto store = [&](float* pDestination) { _mm_store_ps(pDestination, _mm_mul_ps(*pVarying++, w)); };
+
+		if constexpr (HasVarying(VARYINGS, Varying::UV))
+		{
+			store(fragments.u);
+			store(fragments.v);
+		}
+
+		if constexpr (HasVarying(VARYINGS, Varying::NORMAL))
+		{
+			store(fragments.normalX);
+			store(fragments.normalY);
+			store(fragments.normalZ);
+		}
+
+		if constexpr (HasVarying(VARYINGS, Varying::TANGENT))
+		{
+			store(fragments.tangentX);
+			store(fragments.tangentY);
+			store(fragments.tangentZ);
+		}
+
+		if constexpr (HasVarying(VARYINGS, Varying::VIEW_VECTOR))
+		{
+			store(fragments.viewX);
+			store(fragments.viewY);
+			store(fragments.viewZ);
+		}
+	}
+
+	/// <summary>
+	/// Output merger: blend and write the covered fragments of a block
+	/// </summary>
+	/// <param name="fragments">Shaded fragments</param>
+	/// <param name="colors">Shaded colors, SDL ARGB packed</param>
+	/// <param name="pixelIndices">Framebuffer index of every covered lane</param>
+	/// <param name="frameBuffer">Color and depth buffers to write to</param>
+	template<BlendMode BLEND, bool DEPTH_WRITE>
+	inline void WriteFragments(const FragmentBlock& fragments, uint32_t colors[FRAGMENT_BLOCK_SIZE], const uint32_t pixelIndices[FRAGMENT_BLOCK_SIZE], const FrameBuffer& frameBuffer)
+	{
+		uint32_t mask{ fragments.coverageMask };
+
+		//Hard coded transparency blending mode following DirectX setup: src_Color * src_alpha + dest_Color * inv_src_alpha
+		if constexpr (BLEND == BlendMode::ALPHA_BLENDING)
+		{
+			//Fully transparent fragments leave the target as is, unless they write depth
+			if constexpr (!DEPTH_WRITE)
+			{
+				const __m128i alpha{ _mm_srli_epi32(_mm_load_si128(reinterpret_cast<const __m128i*>(colors)), 24) };
+				mask &= ~uint32_t(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(alpha, _mm_setzero_si128()))));
+				if (mask == 0)
+					return;
+			}
+
+			auto destColor = [&](int lane) { return (mask & (1 << lane)) ? int(frameBuffer.pColorBuffer[pixelIndices[lane]]) : 0; };
+			const Simd::RGBColorx4 src{ Simd::GetColorFromSDL_ARGB(_mm_load_si128(reinterpret_cast<const __m128i*>(colors))) };
+			const Simd::RGBColorx4 dest{ Simd::GetColorFromSDL_ARGB(_mm_set_epi32(destColor(3), destColor(2), destColor(1), destColor(0))) };
+			const __m128 invSrcAlpha{ _mm_sub_ps(_mm_set1_ps(1.f), src.a) };
+
+			const Simd::RGBColorx4 blended{
+				_mm_add_ps(_mm_mul_ps(src.r, src.a), _mm_mul_ps(dest.r, invSrcAlpha)),
+				_mm_add_ps(_mm_mul_ps(src.g, src.a), _mm_mul_ps(dest.g, invSrcAlpha)),
+				_mm_add_ps(_mm_mul_ps(src.b, src.a), _mm_mul_ps(dest.b, invSrcAlpha)),
+				_mm_set1_ps(1.f) };
+			_mm_store_si128(reinterpret_cast<__m128i*>(colors), Simd::GetSDL_ARGBColor(blended));
+		}
+
+		for (int lane{}; lane < FRAGMENT_BLOCK_SIZE; ++lane)
+		{
+			if ((mask & (1 << lane)) == 0)
+				continue;
+
+			if constexpr (DEPTH_WRITE)
+				frameBuffer.pDepthBuffer[pixelIndices[lane]] = fragments.depth[lane];
+
+			frameBuffer.pColorBuffer[pixelIndices[lane]] = colors[lane];
+		}
+	}
+
+	//Plane in model space, points with dot(normal, point) + offset < 0 are outside
+	struct FrustumPlane
+	{
+		Elite::FVector3 normal;
+		float offset;
+	};
+
+	//Per draw setup of the meshlet culling, in the model space of the mesh
+	struct MeshletCulling
+	{
+		FrustumPlane frustumPlanes[6];
+		Elite::FPoint3 cameraPosition;
+	};
+
+	/// <summary>
+	/// Frustum planes and camera position in model space, meshlet bounds are tested without being transformed
+	/// </summary>
+	inline MeshletCulling GetMeshletCulling(const DrawParameters& parameters)
+	{
+		//Planes of the clip space bounds -w <= x <= w, -w <= y <= w and 0 <= z <= w, combinations of the matrix rows
+		const Elite::FMatrix4& matrix{ parameters.worldViewProjection };
+		auto getPlane = [&matrix](int row, float sign, bool addW)
+		{
+			float plane[4];
+			for (int col{}; col < 4; ++col)
+				plane[col] = sign * matrix(row, col) + (addW ? matrix(3, col) : 0.f);
+
+			const float length{ sqrtf(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]) };
+			return FrustumPlane{ Elite::FVector3{ plane[0] / length, plane[1] / length, plane[2] / length }, plane[3] / length };
+		};
+
+		MeshletCulling culling{};
+		culling.frustumPlanes[0] = getPlane(0, 1.f, true);
+		culling.frustumPlanes[1] = getPlane(0, -1.f, true);
+		culling.frustumPlanes[2] = getPlane(1, 1.f, true);
+		culling.frustumPlanes[3] = getPlane(1, -1.f, true);
+		culling.frustumPlanes[4] = getPlane(2, 1.f, false);
+		culling.frustumPlanes[5] = getPlane(2, -1.f, true);
+		culling.cameraPosition = Elite::FPoint3(Elite::Inverse(parameters.world) * Elite::FPoint4(parameters.cameraPos));
+		return culling;
+	}
+
+	/// <summary>
+	/// Occlusion test of a bounding sphere against the depth buffer, through the screen rectangle and nearest depth of the cube around it
+	/// </summary>
+	/// <returns>True if every pixel the sphere can cover already holds a nearer depth</returns>
+	inline bool IsSphereOccluded(const Elite::FPoint3& center, float radius, const DrawParameters& parameters, const FrameBuffer& frameBuffer)
+	{
+		float minX{ FLT_MAX }, minY{ FLT_MAX }, maxX{ -FLT_MAX }, maxY{ -FLT_MAX };
+		float minDepth{ FLT_MAX };
+		for (int corner{}; corner < 8; ++corner)
+		{
+			const Elite::FPoint4 cornerPosition{
+				center.x + ((corner & 1) ? radius : -radius),
+				center.y + ((corner & 2) ? radius : -radius),
+				center.z + ((corner & 4) ? radius : -radius),
+				1.f };
+			const Elite::FPoint4 position{ parameters.worldViewProjection * cornerPosition };
+
+			//Crossing the near plane, the projection of the cube doesn't bound it anymore
+			if (position.w <= FLT_EPSILON)
+				return false;
+
+			const float invW{ 1.f / position.w };
+			minX = std::min(minX, position.x * invW);
+			maxX = std::max(maxX, position.x * invW);
+			minY = std::min(minY, position.y * invW);
+			maxY = std::max(maxY, position.y * invW);
+			minDepth = std::min(minDepth, position.z * invW);
+		}
+
+		//Same viewport transform as the vertex stage, clamped on the screen
+		const float width{ float(frameBuffer.width) };
+		const float height{ float(frameBuffer.height) };
+		const uint32_t left{ uint32_t(Elite::Clamp(floorf((minX + 1.f) / 2.f * width), 0.f, width - 1.f)) };
+		const uint32_t right{ uint32_t(Elite::Clamp(ceilf((maxX + 1.f) / 2.f * width), 0.f, width - 1.f)) };
+		const uint32_t top{ uint32_t(Elite::Clamp(floorf((1.f - maxY) / 2.f * height), 0.f, height - 1.f)) };
+		const uint32_t bot{ uint32_t(Elite::Clamp(ceilf((1.f - minY) / 2.f * height), 0.f, height - 1.f)) };
+
+		//Fragments pass the depth test with a smaller depth, the first stored depth above the nearest one ends the test
+		const __m128 nearest{ _mm_set1_ps(minDepth) };
+		for (uint32_t r{ top }; r <= bot; ++r)
+		{
+			const float* pRow{ frameBuffer.pDepthBuffer + size_t(r) * frameBuffer.width };
+			uint32_t c{ left };
+			for (; c + 4 <= right + 1; c += 4)
+			{
+				if (_mm_movemask_ps(_mm_cmpgt_ps(_mm_loadu_ps(pRow + c), nearest)) != 0)
+					return false;
+			}
+
+			for (; c <= right; ++c)
+			{
+				if (pRow[c] > minDepth)
+					return false;
+			}
+		}
+
+		return true;
+	}
+
+	/// <summary>
+	/// Frustum test of a bounding sphere in the model space of the culling setup
+	/// </summary>
+	/// <returns>False if the sphere is fully out of one of the planes</returns>
+	inline bool IsSphereInFrustum(const Elite::FPoint3& center, float radius, const MeshletCulling& culling)
+	{
+		for (const FrustumPlane& plane : culling.frustumPlanes)
+		{
+			if (Elite::Dot(plane.normal, Elite::FVector3(center)) + plane.offset < -radius)
+				return false;
+		}
+
+		return true;
+	}
+
+	/// <summary>
+	/// Instance culling: frustum and occlusion test of the bounding sphere of the whole mesh, before any of its meshlets
+	/// </summary>
+	/// <returns>False if none of the triangles of the instance can write a fragment</returns>
+	inline bool IsInstanceVisible(const Mesh& mesh, const MeshletCulling& culling, const DrawParameters& parameters, const FrameBuffer& frameBuffer)
+	{
+		const Elite::FPoint3 center{ (Elite::FVector3(mesh.GetBoundsMin()) + Elite::FVector3(mesh.GetBoundsMax())) * 0.5f };
+		const float radius{ Elite::Magnitude(mesh.GetBoundsMax() - mesh.GetBoundsMin()) * 0.5f };
+		return IsSphereInFrustum(center, radius, culling) && !IsSphereOccluded(center, radius, parameters, frameBuffer);
+	}
+
+	/// <summary>
+	/// Draw range culling: frustum and occlusion test of one instance merged in a static batch, before any of its meshlets
+	/// </summary>
+	/// <returns>False if none of the triangles of the range can write a fragment</returns>
+	inline bool IsDrawRangeVisible(const MeshDrawRange& range, const MeshletCulling& culling, const DrawParameters& parameters, const FrameBuffer& frameBuffer)
+	{
+		return IsSphereInFrustum(range.center, range.radius, culling) && !IsSphereOccluded(range.center, range.radius, parameters, frameBuffer);
+	}
+
+	/// <summary>
+	/// Meshlet culling: frustum test of the bounding sphere, normal cone test for the culled face and occlusion test against the depth buffer
+	/// </summary>
+	/// <param name="meshlet">Meshlet to test</param>
+	/// <param name="culling">Culling setup of the draw</param>
+	/// <param name="parameters">Mesh transforms and camera information</param>
+	/// <param name="frameBuffer">Depth buffer holding what is already drawn</param>
+	/// <returns>False if none of the triangles of the meshlet can write a fragment</returns>
+	template<CullMode CULL>
+	inline bool IsMeshletVisible(const Meshlet& meshlet, const MeshletCulling& culling, const DrawParameters& parameters, const FrameBuffer& frameBuffer)
+	{
+		//Triangles touching the outside of the frustum are dropped, a sphere fully out of one plane has no triangle left
+		if (!IsSphereInFrustum(meshlet.center, meshlet.radius, culling))
+			return false;
+
+		//Seen from anywhere in the sphere, every triangle shows the culled face
+		if constexpr (CULL == CullMode::BACKFACE || CULL == CullMode::FRONTFACE)
+		{
+			if (meshlet.coneCutoff < 1.f)
+			{
+				const Elite::FVector3 toCenter{ meshlet.center - culling.cameraPosition };
+				const float axisDot{ Elite::Dot(toCenter, meshlet.coneAxis) * (CULL == CullMode::BACKFACE ? 1.f : -1.f) };
+				if (axisDot >= meshlet.coneCutoff * Elite::Magnitude(toCenter) + meshlet.radius)
+					return false;
+			}
+		}
+
+		return !IsSphereOccluded(meshlet.center, meshlet.radius, parameters, frameBuffer);
+	}
+
+	/// <summary>
+	/// Software triangle and pixel loop for the instances of one mesh.
+	/// Every render state is a template parameter so the inner loop holds no state branches and the effect shading is called non-virtually.
+	/// </summary>
+	/// <param name="mesh">Mesh to rasterize</param>
+	/// <param name="effect">Mesh effect, must be of type EFFECT</param>
+	/// <param name="pInstances">Transforms, level of detail and camera information of every instance to draw</param>
+	/// <param name="instanceCount">Number of instances</param>
+	/// <param name="frameBuffer">Color and depth buffers to render to</param>
+	/// <param name="transientBuffer">Scratch storage of the transformed vertices</param>
+	template<typename EFFECT, CullMode CULL, VertexFormat FORMAT, BlendMode BLEND, bool DEPTH_WRITE>
+	void RasterizeMesh(const Mesh& mesh, const Effect& effect, const DrawParameters* pInstances, size_t instanceCount, const FrameBuffer& frameBuffer, TransientVertexBuffer& transientBuffer)
+	{
+		static_assert(std::is_base_of<Effect, EFFECT>::value, "Software pipelines can only be instantiated for effects.");
+
+		//Only the varyings the effect declares are transformed, stored and interpolated
+		constexpr VaryingMask varyingMask{ EFFECT::VARYINGS };
+		constexpr int varyingCount{ GetVaryingCount(varyingMask) };
+		using Vertex = TransformedVertex<varyingCount>;
+
+		const EFFECT& material{ static_cast<const EFFECT&>(effect) };
+		const auto& vertices{ GetInputVertices<FORMAT>(mesh) };
+		const VertexQuantization& quantization{ mesh.GetVertexQuantization() };
+		const auto& indexes{ mesh.GetIndexes() };
+		const PrimitiveTopology topology{ PrimitiveTopology::TRIANGLELIST };
+
+		const size_t step{ size_t(topology) };
+		uint32_t triangleIndexes[TRI_VERTEX_COUNT];
+
+		for (size_t instanceIdx{}; instanceIdx < instanceCount; ++instanceIdx)
+		{
+			const DrawParameters& parameters{ pInstances[instanceIdx] };
+
+			//Whole instances, then whole meshlets, out of the frustum, facing away or hidden behind what is already drawn are skipped before any vertex transform
+			const MeshletCulling culling{ GetMeshletCulling(parameters) };
+			if (!IsInstanceVisible(mesh, culling, parameters, frameBuffer))
+				continue;
+
+			//Static batches are culled per merged instance, then per meshlet. Other meshes are a single range: the meshlets of their level of detail
+			const std::vector<MeshDrawRange>& drawRanges{ mesh.GetDrawRanges() };
+			const size_t rangeCount{ drawRanges.empty() ? 1 : drawRanges.size() };
+			for (size_t rangeIdx{}; rangeIdx < rangeCount; ++rangeIdx)
+			{
+				Utils::ArrayView<Meshlet> meshlets{ mesh.GetLodMeshlets(parameters.lod) };
+				uint32_t firstVertex{};
+				size_t vertexCount{ vertices.size() };
+				if (!drawRanges.empty())
+				{
+					const MeshDrawRange& range{ drawRanges[rangeIdx] };
+					if (!IsDrawRangeVisible(range, culling, parameters, frameBuffer))
+						continue;
+
+					meshlets = { mesh.GetMeshlets().data() + range.firstMeshlet, range.meshletCount };
+					firstVertex = range.firstVertex;
+					vertexCount = range.vertexCount;
+				}
+
+				//Vertices shared by several triangles are only transformed once per range, only the vertices of a visible range are mapped
+				Vertex* const pTransformedVertices{ MapTransientVertices<Vertex>(transientBuffer, vertexCount) };
+				uint32_t* const pStamps{ transientBuffer.stamps.data() };
+				const uint32_t stamp{ transientBuffer.stamp };
+				auto getVertex = [&](uint32_t vertexIdx) -> const Vertex*
+				{
+					const uint32_t rangeVertexIdx{ vertexIdx - firstVertex };
+					Vertex* pVertex{ pTransformedVertices + rangeVertexIdx };
+					if (pStamps[rangeVertexIdx] != stamp)
+					{
+						TransformVertex<varyingMask>(vertices[vertexIdx], quantization, parameters, frameBuffer, *pVertex);
+						pStamps[rangeVertexIdx] = stamp;
+					}
+
+					return pVertex;
+				};
+
+				for (const Meshlet& meshlet : meshlets)
+				{
+					if (!IsMeshletVisible<CULL>(meshlet, culling, parameters, frameBuffer))
+						continue;
+
+					const size_t lastIdx{ size_t(meshlet.firstIndex) + meshlet.indexCount };
+					for (size_t idx{ meshlet.firstIndex }; idx + TRI_VERTEX_COUNT <= lastIdx; idx += step)
+					{
+						//check if the triangle generated is valid (i.e. degenerate triangle aren't valid)
+						if (!CreateTriangle(topology, indexes, idx, triangleIndexes))
+							continue;
+
+						//Frustum culling, the triangle is dropped if one of its vertices is out
+						const Vertex* const triangle[TRI_VERTEX_COUNT]{ getVertex(triangleIndexes[0]), getVertex(triangleIndexes[1]), getVertex(triangleIndexes[2]) };
+						if (!triangle[0]->isInside || !triangle[1]->isInside || !triangle[2]->isInside)
+							continue;
+
+						TriangleSetup<varyingCount> setup;
+						if (!SetupTriangle<CULL>(triangle, setup))
+							continue;
+
+						const Elite::FPoint4* const positions[TRI_VERTEX_COUNT]{ &triangle[0]->position, &triangle[1]->position, &triangle[2]->position };
+						RasterizeTriangle(setup, positions, frameBuffer, [&](uint32_t c, uint32_t r, uint32_t coverageMask, __m128 depth, __m128 invW, const __m128 varyings[])
+						{
+							const uint32_t pixelIdx{ c + (r * frameBuffer.width) };
+							const uint32_t pixelIndices[FRAGMENT_BLOCK_SIZE]{ pixelIdx, pixelIdx + 1, pixelIdx + frameBuffer.width, pixelIdx + frameBuffer.width + 1 };
+							coverageMask = TestDepth(depth, coverageMask, pixelIndices, frameBuffer);
+							if (coverageMask == 0)
+								return;
+
+							//Perspective correct attributes: one reciprocal per pixel
+							const __m128 w{ _mm_div_ps(_mm_set1_ps(1.f), invW) };
+							FragmentBlock fragments;
+							fragments.coverageMask = coverageMask;
+							_mm_store_ps(fragments.positionX, _mm_add_ps(_mm_set1_ps(float(c)), _mm_set_ps(1.f, 0.f, 1.f, 0.f)));
+							_mm_store_ps(fragments.positionY, _mm_add_ps(_mm_set1_ps(float(r)), _mm_set_ps(1.f, 1.f, 0.f, 0.f)));
+							_mm_store_ps(fragments.depth, depth);
+							StoreVaryings<varyingMask>(varyings, w, fragments);
+
+							//A blended quad only reading fully transparent texels changes nothing, it is dropped before shading
+							bool isCulled{ false };
+							if constexpr (EFFECT::ALPHA_CULLING && BLEND == BlendMode::ALPHA_BLENDING && !DEPTH_WRITE)
+								isCulled = material.EFFECT::IsBlockTransparent(fragments);
+
+							//Qualified call: no virtual dispatch, the effect shading can be inlined
+							if (!isCulled)
+							{
+								alignas(16) uint32_t colors[FRAGMENT_BLOCK_SIZE];
+								material.EFFECT::PixelShadingBlock(fragments, colors);
+								WriteFragments<BLEND, DEPTH_WRITE>(fragments, colors, pixelIndices, frameBuffer);
+							}
+						});
+					}
+				}
+			}
+		}
+	}
+
+	/// <summary>
+	/// Draw the impostor of a mesh: two triangles textured with the frame captured nearest to the view direction.
+	/// Fragments are moved back onto the captured surface through the depth atlas, so the impostor is depth tested like the mesh
+	/// </summary>
+	/// <param name="impostor">Impostor of the mesh</param>
+	/// <param name="parameters">Mesh transforms and camera information</param>
+	/// <param name="filterMode">Color atlas filtering</param>
+	/// <param name="frameBuffer">Color and depth buffers to render to</param>
+	inline void RasterizeImpostor(const Impostor& impostor, const DrawParameters& parameters, FilterMode filterMode, const FrameBuffer& frameBuffer)
+	{
+		constexpr VaryingMask varyingMask{ GetVaryingFlag(Varying::UV) };
+		constexpr int varyingCount{ GetVaryingCount(varyingMask) };
+		using Vertex = TransformedVertex<varyingCount>;
+
+		const Elite::FPoint3 cameraPosition{ Elite::Inverse(parameters.world) * Elite::FPoint4(parameters.cameraPos) };
+		const Impostor::Frame frame{ Impostor::GetFrame(Impostor::GetFrameIndex(cameraPosition - impostor.GetCenter())) };
+		const float radius{ impostor.GetRadius() };
+		const float cellSize{ 1.f / Impostor::FRAME_GRID_SIZE };
+
+		//Quad corners on the frame plane through the center, top left first like the atlas rows
+		Vertex corners[4];
+		for (int cornerIdx{}; cornerIdx < 4; ++cornerIdx)
+		{
+			const float s{ float(cornerIdx & 1) };
+			const float t{ float(cornerIdx >> 1) };
+			Vertex_Input corner{};
+			corner.position = impostor.GetCenter() + frame.right * (radius * (2.f * s - 1.f)) + frame.up * (radius * (1.f - 2.f * t));
+			corner.uv = frame.uvMin + Elite::FVector2{ s, t } * cellSize;
+			TransformVertex<varyingMask>(corner, VertexQuantization{}, parameters, frameBuffer, corners[cornerIdx]);
+
+			//Dropped at the frustum borders like the triangles of a mesh
+			if (!corners[cornerIdx].isInside)
+				return;
+		}
+
+		const Texture& colorAtlas{ impostor.GetColorAtlas() };
+		const Elite::FMatrix4& matrix{ parameters.worldViewProjection };
+		auto shadeQuad = [&](uint32_t c, uint32_t r, uint32_t coverageMask, __m128, __m128 invW, const __m128 varyings[])
+		{
+			FragmentBlock fragments;
+			StoreVaryings<varyingMask>(varyings, _mm_div_ps(_mm_set1_ps(1.f), invW), fragments);
+
+			//The coverage captured in alpha is filtered like the colors, half covered texels are the silhouette
+			Simd::RGBColorx4 color{ colorAtlas.Sample(_mm_load_ps(fragments.u), _mm_load_ps(fragments.v), filterMode) };
+			coverageMask &= uint32_t(_mm_movemask_ps(_mm_cmpge_ps(color.a, _mm_set1_ps(0.5f))));
+			if (coverageMask == 0)
+				return;
+
+			//Surface point behind the quad at the captured depth, projected again for the depth test
+			for (int lane{}; lane < FRAGMENT_BLOCK_SIZE; ++lane)
+			{
+				if ((coverageMask & (1 << lane)) == 0)
+					continue;
+
+				const float s{ (fragments.u[lane] - frame.uvMin.x) * Impostor::FRAME_GRID_SIZE };
+				const float t{ (fragments.v[lane] - frame.uvMin.y) * Impostor::FRAME_GRID_SIZE };
+				const float depth{ impostor.SampleDepth(fragments.u[lane], fragments.v[lane]) };
+				const Elite::FPoint3 surface{ impostor.GetCenter() + frame.right * (radius * (2.f * s - 1.f)) + frame.up * (radius * (1.f - 2.f * t)) + frame.direction * (radius * (1.f - 2.f * depth)) };
+				const float clipZ{ matrix(2, 0) * surface.x + matrix(2, 1) * surface.y + matrix(2, 2) * surface.z + matrix(2, 3) };
+				const float clipW{ matrix(3, 0) * surface.x + matrix(3, 1) * surface.y + matrix(3, 2) * surface.z + matrix(3, 3) };
+				fragments.depth[lane] = clipZ / clipW;
+			}
+
+			const uint32_t pixelIdx{ c + (r * frameBuffer.width) };
+			const uint32_t pixelIndices[FRAGMENT_BLOCK_SIZE]{ pixelIdx, pixelIdx + 1, pixelIdx + frameBuffer.width, pixelIdx + frameBuffer.width + 1 };
+			fragments.coverageMask = TestDepth(_mm_load_ps(fragments.depth), coverageMask, pixelIndices, frameBuffer);
+			if (fragments.coverageMask == 0)
+				return;
+
+			color.a = _mm_set1_ps(1.f);
+			alignas(16) uint32_t colors[FRAGMENT_BLOCK_SIZE];
+			_mm_store_si128(reinterpret_cast<__m128i*>(colors), Simd::GetSDL_ARGBColor(color));
+			WriteFragments<BlendMode::NO_BLENDING, true>(fragments, colors, pixelIndices, frameBuffer);
+		};
+
+		//Facing the camera or not, the quad is never culled
+		const Vertex* const triangles[2][TRI_VERTEX_COUNT]{ { &corners[0], &corners[2], &corners[1] }, { &corners[1], &corners[2], &corners[3] } };
+		for (const auto& triangle : triangles)
+		{
+			TriangleSetup<varyingCount> setup;
+			if (!SetupTriangle<CullMode::NONE>(triangle, setup))
+				continue;
+
+			const Elite::FPoint4* const positions[TRI_VERTEX_COUNT]{ &triangle[0]->position, &triangle[1]->position, &triangle[2]->position };
+			RasterizeTriangle(setup, positions, frameBuffer, shadeQuad);
+		}
+	}
+
+	/// <summary>
+	/// Pipeline instantiations of one effect, cull mode and vertex format, indexed by [BlendMode][DepthWrite]
+	/// </summary>
+	template<typename EFFECT, CullMode CULL, VertexFormat FORMAT>
+	struct SoftwarePipelineTable
+	{
+		static constexpr SoftwarePipeline pipelines[int(BlendMode::COUNT)][2]
+		{
+			{ &RasterizeMesh<EFFECT, CULL, FORMAT, BlendMode::NO_BLENDING, false>, &RasterizeMesh<EFFECT, CULL, FORMAT, BlendMode::NO_BLENDING, true> },
+			{ &RasterizeMesh<EFFECT, CULL, FORMAT, BlendMode::ALPHA_BLENDING, false>, &RasterizeMesh<EFFECT, CULL, FORMAT, BlendMode::ALPHA_BLENDING, true> }
+		};
+	};
+
+	template<typename EFFECT, CullMode CULL>
+	SoftwarePipeline GetSoftwarePipeline(VertexFormat vertexFormat, BlendMode blendMode, bool depthWrite)
+	{
+		if (vertexFormat == VertexFormat::COMPACT)
+			return SoftwarePipelineTable<EFFECT, CULL, VertexFormat::COMPACT>::pipelines[int(blendMode)][depthWrite];
+
+		return SoftwarePipelineTable<EFFECT, CULL, VertexFormat::FULL>::pipelines[int(blendMode)][depthWrite];
+	}
+
+	/// <summary>
+	/// Pick the pipeline instantiation matching the render states, meant to be called once per mesh
+	/// </summary>
+	/// <param name="cullMode">Resolved cull mode (MESHBASED is not a valid value)</param>
+	/// <param name="vertexFormat">Vertex format of the mesh</param>
+	/// <param name="blendMode">Blend mode</param>
+	/// <param name="depthWrite">Wether or not depth is written</param>
+	/// <returns>Pipeline function</returns>
+	template<typename EFFECT>
+	SoftwarePipeline GetSoftwarePipeline(CullMode cullMode, VertexFormat vertexFormat, BlendMode blendMode, bool depthWrite)
+	{
+		switch (cullMode)
+		{
+		case CullMode::NONE:
+			return GetSoftwarePipeline<EFFECT, CullMode::NONE>(vertexFormat, blendMode, depthWrite);
+		case CullMode::FRONTFACE:
+			return GetSoftwarePipeline<EFFECT, CullMode::FRONTFACE>(vertexFormat, blendMode, depthWrite);
+		default:
+			return GetSoftwarePipeline<EFFECT, CullMode::BACKFACE>(vertexFormat, blendMode, depthWrite);
+		}
+	}
+}
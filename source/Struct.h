@@ -1,8 +1,38 @@
 #pragma once
 #include "Emath.h"
 #include "ERGBColor.h"
+#include "Enum.h"
+#include <vector>
+#include <string>
+
+class Mesh;
+class Effect;
 
 const int TRI_VERTEX_COUNT{ 3 };
+const int FRAGMENT_BLOCK_SIZE{ 4 };
+
+//Set of Varying flags, declares which attributes an effect reads so only those are computed and interpolated
+using VaryingMask = uint32_t;
+const VaryingMask ALL_VARYINGS{ (1u << uint32_t(Varying::COUNT)) - 1 };
+
+constexpr VaryingMask GetVaryingFlag(Varying varying) { return 1u << uint32_t(varying); }
+constexpr bool HasVarying(VaryingMask mask, Varying varying) { return (mask & GetVaryingFlag(varying)) != 0; }
+constexpr int GetVaryingSize(Varying varying) { return varying == Varying::UV ? 2 : 3; }
+
+//Number of floats preceding a varying when only the varyings of the mask are stored, in Varying order
+constexpr int GetVaryingOffset(VaryingMask mask, Varying varying)
+{
+	int offset{};
+	for (int idx{}; idx < int(varying); ++idx)
+	{
+		if (HasVarying(mask, Varying(idx)))
+			offset += GetVaryingSize(Varying(idx));
+	}
+
+	return offset;
+}
+
+constexpr int GetVaryingCount(VaryingMask mask) { return GetVaryingOffset(mask, Varying::COUNT); }
 
 struct Vertex_Input
 {
@@ -12,6 +42,59 @@ struct Vertex_Input
 	Elite::FVector2 uv;
 };
 
+//Quantized vertex, 20 bytes instead of 44: position in 16 bit steps of the mesh bounds, octahedral normal and tangent in 16 bit snorm, half float uv
+struct Vertex_Compact
+{
+	uint16_t position[3];
+	uint16_t padding;
+	int16_t normal[2];
+	int16_t tangent[2];
+	uint16_t uv[2];
+};
+
+//Decoded position of a compact vertex: offset + quantized position * scale
+struct VertexQuantization
+{
+	Elite::FPoint3 positionOffset;
+	Elite::FVector3 positionScale;
+};
+
+//Run of consecutive triangles of a mesh culled as a whole, bounding sphere and normal cone in model space.
+//The triangles all face away from viewers in the cone around -coneAxis, a cutoff of 1 or more means the cone can't cull
+struct Meshlet
+{
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	Elite::FPoint3 center;
+	float radius;
+	Elite::FVector3 coneAxis;
+	float coneCutoff;
+};
+
+//Level of detail, a range of the mesh indexes and the meshlets covering it. All levels index the same vertices
+struct MeshLod
+{
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	uint32_t firstMeshlet;
+	uint32_t meshletCount;
+	//Largest distance the simplified surface moved from the full one, in model space units
+	float error;
+};
+
+//Draw record of one mesh instance merged in a static batch: its vertices, its indexes, its meshlets and its bounding sphere in world space
+struct MeshDrawRange
+{
+	uint32_t firstVertex;
+	uint32_t vertexCount;
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	uint32_t firstMeshlet;
+	uint32_t meshletCount;
+	Elite::FPoint3 center;
+	float radius;
+};
+
 struct Vertex_Output
 {
 	Elite::FPoint4 position;
@@ -21,6 +104,26 @@ struct Vertex_Output
 	Elite::FVector2 uv;
 };
 
+//Fragments of a 2x2 pixel quad in SoA form, lane i is pixel (x + (i & 1), y + (i >> 1))
+struct alignas(16) FragmentBlock
+{
+	float positionX[FRAGMENT_BLOCK_SIZE];
+	float positionY[FRAGMENT_BLOCK_SIZE];
+	float depth[FRAGMENT_BLOCK_SIZE];
+	float u[FRAGMENT_BLOCK_SIZE];
+	float v[FRAGMENT_BLOCK_SIZE];
+	float normalX[FRAGMENT_BLOCK_SIZE];
+	float normalY[FRAGMENT_BLOCK_SIZE];
+	float normalZ[FRAGMENT_BLOCK_SIZE];
+	float tangentX[FRAGMENT_BLOCK_SIZE];
+	float tangentY[FRAGMENT_BLOCK_SIZE];
+	float tangentZ[FRAGMENT_BLOCK_SIZE];
+	float viewX[FRAGMENT_BLOCK_SIZE];
+	float viewY[FRAGMENT_BLOCK_SIZE];
+	float viewZ[FRAGMENT_BLOCK_SIZE];
+	uint32_t coverageMask;
+};
+
 struct Aabb2D
 {
 	uint32_t bot;
@@ -35,4 +138,40 @@ struct DirectionalLight
 	Elite::RGBColor color;
 	Elite::FVector3 nDirection;
 	float intensity;
-};
\ No newline at end of file
+};
+
+struct FrameBuffer
+{
+	uint32_t* pColorBuffer;
+	float* pDepthBuffer;
+	uint32_t width;
+	uint32_t height;
+};
+
+struct DrawParameters
+{
+	Elite::FMatrix4 worldViewProjection;
+	Elite::FMatrix4 world;
+	Elite::FPoint3 cameraPos;
+	uint32_t lod;
+};
+
+//One channel of a packed texture, taken from a channel (0 R to 3 A) of a source image. An empty path fills the channel with 255
+struct TextureChannel
+{
+	std::string texturePath;
+	uint32_t sourceChannel;
+};
+
+//Scratch storage of the software vertex stage, reused from mesh to mesh.
+//A vertex is transformed the first time a triangle references it, stamps tell which vertices are already transformed for the current draw.
+struct TransientVertexBuffer
+{
+	std::vector<uint8_t> vertices;
+	std::vector<uint32_t> stamps;
+	uint32_t stamp;
+};
+
+//Software raster pipeline instantiated for a concrete effect, cull mode, blend mode and depth write setup.
+//Draws every instance of a mesh in one call, one DrawParameters per instance
+using SoftwarePipeline = void(*)(const Mesh& mesh, const Effect& effect, const DrawParameters* pInstances, size_t instanceCount, const FrameBuffer& frameBuffer, TransientVertexBuffer& transientBuffer);
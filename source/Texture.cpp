@@ -1,38 +1,183 @@
 #include "pch.h"
 #include "Texture.h"
 #include <SDL_image.h>
+#include <atomic>
+#include <cstring>
+#include <cstdio>
+#include <fstream>
+#include <filesystem>
 #include "Utils.h"
+#include "Struct.h"
+#include "VirtualTextureStreamer.h"
 
-Texture::Texture(const std::string& texturePath)
-	: m_pTexture{ nullptr }
+namespace
+{
+	//Per thread cache of decoded compressed blocks, direct mapped on texture id and block index
+	struct DecodedBlock
+	{
+		uint32_t textureId;
+		size_t blockIdx;
+		uint32_t texels[BlockCompression::BLOCK_TEXEL_COUNT];
+	};
+
+	const size_t DECODED_BLOCK_CACHE_SIZE{ 256 };
+	thread_local DecodedBlock g_DecodedBlockCache[DECODED_BLOCK_CACHE_SIZE]{};
+
+	//Id 0 marks empty cache entries
+	std::atomic<uint32_t> g_NextTextureId{ 1 };
+
+	//Cache file header, the blocks follow at TEXTURE_CACHE_DATA_OFFSET so they stay cache line aligned in the mapping,
+	//then the alpha range of every block
+	struct TextureCacheHeader
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint64_t sourceHash;
+		uint32_t format;
+		uint32_t width;
+		uint32_t height;
+		uint32_t mipLevelCount;
+		uint64_t blockDataSize;
+	};
+
+	const uint32_t TEXTURE_CACHE_MAGIC{ 0x48435854 }; //"TXCH"
+	const uint32_t TEXTURE_CACHE_VERSION{ 2 };
+	const size_t TEXTURE_CACHE_DATA_OFFSET{ 64 };
+	static_assert(sizeof(TextureCacheHeader) <= TEXTURE_CACHE_DATA_OFFSET, "Texture cache header overlaps the blocks.");
+}
+
+Texture::Texture()
+	: m_Blocks{}
+	, m_CacheFile{}
+	, m_pBlocks{ nullptr }
+	, m_MipLevels{}
+	, m_AlphaRanges{}
+	, m_Format{ TextureFormat::RGBA8 }
+	, m_BlockByteSize{ RGBA8_BLOCK_BYTE_SIZE }
+	, m_SourceHash{ }
+	, m_Id{ g_NextTextureId++ }
+	, m_Pages{}
+	, m_PageFeedback{ nullptr }
+	, m_PageFilePath{}
+	, m_pTexture{ nullptr }
 	, m_pTextureView{ nullptr }
-	, m_pTextureSurface{ IMG_Load(texturePath.c_str()) }
-{}
+{
+}
+
+Texture::Texture(const std::string& texturePath, TextureFormat format)
+	: Texture{}
+{
+	//The cache is only valid for the exact source bytes it was converted from
+	const std::string cachePath{ GetCachePath(texturePath, format) };
+	uint64_t sourceHash{ Utils::HASH_SEED };
+	const bool isHashed{ Utils::HashFile(texturePath, sourceHash) };
+	if (isHashed && MapCache(cachePath, sourceHash))
+		return;
+
+	uint32_t width{}, height{};
+	std::vector<uint32_t> texels;
+	if (!LoadRGBA8Image(texturePath, width, height, texels))
+	{
+		std::cout << "Could not load Texture: " << texturePath << std::endl;
+		AllocateMipChain(1, 1);
+		GetRGBA8Block(0)[0] = 0xFF000000;
+		ComputeAlphaRanges();
+		return;
+	}
+
+	Initialize(width, height, texels.data(), format);
+	if (isHashed)
+	{
+		m_SourceHash = sourceHash;
+		WriteCache(cachePath, sourceHash);
+	}
+}
+
+Texture::Texture(uint32_t width, uint32_t height, const std::vector<uint32_t>& texels, TextureFormat format, uint64_t sourceHash)
+	: Texture{}
+{
+	m_SourceHash = sourceHash;
+	Initialize(width, height, texels.data(), format);
+}
 
 Texture::~Texture()
 {
+	//The page file only lives as long as the texture, it is rewritten on every load
+	if (IsVirtual())
+	{
+		VirtualTextureStreamer::GetInstance()->Unregister(this);
+		std::remove(m_PageFilePath.c_str());
+	}
+
 	ClearGPUResources();
-	SDL_FreeSurface(m_pTextureSurface);
 }
 
 void Texture::LoadToGPU(ID3D11Device* pDevice)
 {
 	//Set texture descriptor
 	D3D11_TEXTURE2D_DESC texDesc{};
-	texDesc.Width = m_pTextureSurface->w;
-	texDesc.Height = m_pTextureSurface->h;
-	texDesc.MipLevels = 1;
+	texDesc.Width = GetWidth();
+	texDesc.Height = GetHeight();
+	texDesc.MipLevels = GetMipLevelCount();
 	texDesc.ArraySize = 1;
-	texDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
 	texDesc.SampleDesc.Count = 1;
 	texDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
 
-	D3D11_SUBRESOURCE_DATA initData{};
-	initData.pSysMem = m_pTextureSurface->pixels;
-	initData.SysMemPitch = UINT(m_pTextureSurface->pitch);
-	initData.SysMemSlicePitch = UINT(m_pTextureSurface->h * m_pTextureSurface->pitch);
+	switch (m_Format)
+	{
+	case TextureFormat::BC1:
+		texDesc.Format = DXGI_FORMAT_BC1_UNORM;
+		break;
+	case TextureFormat::BC3:
+		texDesc.Format = DXGI_FORMAT_BC3_UNORM;
+		break;
+	case TextureFormat::BC5:
+		texDesc.Format = DXGI_FORMAT_BC5_UNORM;
+		break;
+	default:
+		texDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+		break;
+	}
+
+	//The hardware path has no virtual texturing, the whole mip chain is read back from the page file for the upload
+	BlockStorage virtualBlocks;
+	if (IsVirtual())
+		virtualBlocks = ReadAllBlocks();
+	const uint8_t* pBlocks{ IsVirtual() ? virtualBlocks.data() : m_pBlocks };
+	const size_t blockCount{ GetBlockCount() };
+
+	//Upload the mip chain generated at load. Compressed blocks are uploaded as they are, RGBA8 blocks go back to a linear layout
+	std::vector<uint32_t> linearTexels;
+	if (m_Format == TextureFormat::RGBA8)
+		linearTexels.resize(blockCount * BlockCompression::BLOCK_TEXEL_COUNT);
+
+	const size_t blockByteSize{ m_BlockByteSize };
+	std::vector<D3D11_SUBRESOURCE_DATA> initData(m_MipLevels.size());
+	for (size_t levelIdx{}; levelIdx < m_MipLevels.size(); ++levelIdx)
+	{
+		const MipLevel& level{ m_MipLevels[levelIdx] };
+		if (m_Format == TextureFormat::RGBA8)
+		{
+			uint32_t* pLinear{ linearTexels.data() + level.firstBlock * BlockCompression::BLOCK_TEXEL_COUNT };
+			for (uint32_t row{}; row < level.height; ++row)
+			{
+				for (uint32_t col{}; col < level.width; ++col)
+					pLinear[size_t(row) * level.width + col] = reinterpret_cast<const uint32_t*>(pBlocks + GetBlockIndex(level, col, row) * blockByteSize)[GetIndexInBlock(col, row)];
+			}
 
-	HRESULT result{ pDevice->CreateTexture2D(&texDesc, &initData, &m_pTexture) };
+			initData[levelIdx].pSysMem = pLinear;
+			initData[levelIdx].SysMemPitch = UINT(level.width * sizeof(uint32_t));
+			initData[levelIdx].SysMemSlicePitch = UINT(level.width * level.height * sizeof(uint32_t));
+		}
+		else
+		{
+			initData[levelIdx].pSysMem = pBlocks + level.firstBlock * blockByteSize;
+			initData[levelIdx].SysMemPitch = UINT(level.blockCountX * blockByteSize);
+			initData[levelIdx].SysMemSlicePitch = UINT(level.blockCountX * level.blockCountY * blockByteSize);
+		}
+	}
+
+	HRESULT result{ pDevice->CreateTexture2D(&texDesc, initData.data(), &m_pTexture) };
 	if (FAILED(result))
 	{
 		std::cout << "Could not create Texture: " << std::endl;
@@ -57,19 +202,831 @@ void Texture::ClearGPUResources()
 }
 
 /// <summary>
-/// Clamped Sample pixel from texture
+/// Clamped Sample pixel from texture, point sampled from the base level (or the finest resident level of a virtual texture)
 /// </summary>
 /// <param name="uv">normalized pixel coordinate in space</param>
 /// <returns>Pixel color</returns>
 Elite::RGBColor Texture::Sample(const Elite::FVector2& uv) const
 {
+	const float u{ Elite::Clamp(uv.x, 0.f, 1.f) };
+	const float v{ Elite::Clamp(uv.y, 0.f, 1.f) };
+	const MipLevel& level{ m_MipLevels[GetResidentLevel(0, u, u, v, v)] };
+	const uint32_t col{ std::min(uint32_t(u * level.width), level.width - 1) };
+	const uint32_t row{ std::min(uint32_t(v * level.height), level.height - 1) };
+	const uint32_t texel{ GetDecodedBlock(GetBlockIndex(level, col, row), GetBlockData(level, col / BLOCK_SIZE, row / BLOCK_SIZE))[GetIndexInBlock(col, row)] };
+	const float inv255{ 1.f / 255.f };
+
+	return Elite::RGBColor(float(texel & 0xFF) * inv255, float((texel >> 8) & 0xFF) * inv255, float((texel >> 16) & 0xFF) * inv255, float(texel >> 24) * inv255);
+}
+
+/// <summary>
+/// Clamped Sample of a 2x2 pixel quad from texture, the mip level is selected from the uv derivatives across the quad
+/// POINT: nearest texel of the nearest mip, LINEAR: bilinear on the nearest mip, ANISOTROPIC: trilinear
+/// </summary>
+/// <param name="u">normalized horizontal coordinates, lanes in FragmentBlock order</param>
+/// <param name="v">normalized vertical coordinates, lanes in FragmentBlock order</param>
+/// <param name="filterMode">Filtering applied</param>
+/// <returns>Pixel colors</returns>
+Simd::RGBColorx4 Texture::Sample(__m128 u, __m128 v, FilterMode filterMode) const
+{
+	const float maxLod{ float(m_MipLevels.size() - 1) };
+	//A NaN lod (degenerate or NaN uvs) would pass the clamps below and index past the mip chain, it is taken as magnified like negative ones
+	float lod{ GetQuadLod(u, v) };
+	if (!(lod >= 0.f))
+		lod = 0.f;
+
+	//Filtering stays on packed RGBA8 texels, colors are only unpacked to floats once at the end
+	__m128i texels{};
+	switch (filterMode)
+	{
+	case FilterMode::POINT:
+		texels = SamplePoint(m_MipLevels[GetResidentLevel(size_t(Elite::Clamp(lod + 0.5f, 0.f, maxLod)), u, v)], u, v);
+		break;
+	case FilterMode::LINEAR:
+		texels = SampleBilinear(m_MipLevels[GetResidentLevel(size_t(Elite::Clamp(lod + 0.5f, 0.f, maxLod)), u, v)], u, v);
+		break;
+	default:
+	{
+		//A virtual texture missing the wanted level falls back to bilinear on a coarser resident one
+		const float clampedLod{ Elite::Clamp(lod, 0.f, maxLod) };
+		const size_t levelIdx{ size_t(clampedLod) };
+		const size_t residentLevelIdx{ GetResidentLevel(levelIdx, u, v) };
+		const int levelBlend{ int((clampedLod - float(levelIdx)) * 32767.f) };
+		texels = SampleBilinear(m_MipLevels[residentLevelIdx], u, v);
+		if (levelBlend > 0 && residentLevelIdx == levelIdx && GetResidentLevel(levelIdx + 1, u, v) == levelIdx + 1)
+			texels = Simd::LerpRGBA8(texels, SampleBilinear(m_MipLevels[levelIdx + 1], u, v), _mm_set1_epi32(levelBlend));
+		break;
+	}
+	}
+
+	return Simd::GetColorFromRGBA8(texels);
+}
+
+/// <summary>
+/// Load an image file decoded to RGBA8 texels (R in the lowest byte), row by row
+/// </summary>
+/// <param name="texturePath">Image file</param>
+/// <param name="width">Image width</param>
+/// <param name="height">Image height</param>
+/// <param name="texels">Decoded texels</param>
+/// <returns>False when the file couldn't be loaded</returns>
+bool Texture::LoadRGBA8Image(const std::string& texturePath, uint32_t& width, uint32_t& height, std::vector<uint32_t>& texels)
+{
+	SDL_Surface* pSurface{ IMG_Load(texturePath.c_str()) };
+	if (!pSurface)
+		return false;
+
+	//Decode once to RGBA8 whatever the file format, the samplers then read the texels without any format lookup
+	SDL_Surface* pConverted{ SDL_ConvertSurfaceFormat(pSurface, SDL_PIXELFORMAT_RGBA32, 0) };
+	SDL_FreeSurface(pSurface);
+	if (!pConverted)
+		return false;
+
+	width = uint32_t(pConverted->w);
+	height = uint32_t(pConverted->h);
+	texels.resize(size_t(width) * height);
+
+	SDL_LockSurface(pConverted);
+	const uint8_t* pRow{ static_cast<const uint8_t*>(pConverted->pixels) };
+	for (uint32_t row{}; row < height; ++row, pRow += pConverted->pitch)
+		std::memcpy(texels.data() + size_t(row) * width, pRow, width * sizeof(uint32_t));
+	SDL_UnlockSurface(pConverted);
+
+	SDL_FreeSurface(pConverted);
+	return true;
+}
+
+/// <summary>
+/// Build the blocks of the whole mip chain from the base level texels
+/// </summary>
+/// <param name="width">Base level width</param>
+/// <param name="height">Base level height</param>
+/// <param name="pTexels">RGBA8 texels, row by row</param>
+/// <param name="format">Storage format, compressed formats fall back to RGBA8 when the size isn't made of whole blocks</param>
+void Texture::Initialize(uint32_t width, uint32_t height, const uint32_t* pTexels, TextureFormat format)
+{
+	AllocateMipChain(width, height);
+
+	//Swizzle the base level into blocks
+	for (uint32_t row{}; row < height; ++row)
+	{
+		for (uint32_t col{}; col < width; ++col)
+			GetRGBA8Block(GetBlockIndex(m_MipLevels[0], col, row))[GetIndexInBlock(col, row)] = pTexels[size_t(row) * width + col];
+	}
+
+	GenerateMipChain();
+
+	if (format != TextureFormat::RGBA8)
+	{
+		//DirectX only accepts block compressed textures with a base level made of whole blocks
+		if (width % BLOCK_SIZE == 0 && height % BLOCK_SIZE == 0)
+			Compress(format);
+		else
+			std::cout << "Texture size is not a multiple of 4, kept uncompressed" << std::endl;
+	}
+
+	ComputeAlphaRanges();
+}
+
+/// <summary>
+/// Lay out every level of the mip chain down to 1x1
+/// </summary>
+/// <param name="width">Base level width</param>
+/// <param name="height">Base level height</param>
+/// <returns>Block count of the whole mip chain</returns>
+size_t Texture::LayoutMipChain(uint32_t width, uint32_t height)
+{
+	m_MipLevels.clear();
+	size_t blockCount{};
+	while (true)
+	{
+		const uint32_t blockCountX{ (width + BLOCK_SIZE - 1) / BLOCK_SIZE };
+		const uint32_t blockCountY{ (height + BLOCK_SIZE - 1) / BLOCK_SIZE };
+		m_MipLevels.push_back(MipLevel{ blockCount, width, height, blockCountX, blockCountY, 0, 0, 0 });
+		blockCount += size_t(blockCountX) * blockCountY;
+
+		if (width == 1 && height == 1)
+			break;
+
+		width = std::max(width / 2, 1u);
+		height = std::max(height / 2, 1u);
+	}
+
+	return blockCount;
+}
+
+/// <summary>
+/// Lay out the mip chain and allocate RGBA8 blocks for all of its levels
+/// </summary>
+/// <param name="width">Base level width</param>
+/// <param name="height">Base level height</param>
+void Texture::AllocateMipChain(uint32_t width, uint32_t height)
+{
+	const size_t blockCount{ LayoutMipChain(width, height) };
+	m_Format = TextureFormat::RGBA8;
+	m_BlockByteSize = RGBA8_BLOCK_BYTE_SIZE;
+	m_Blocks.assign(blockCount * RGBA8_BLOCK_BYTE_SIZE, 0);
+	m_pBlocks = m_Blocks.data();
+}
+
+/// <summary>
+/// Box filter every level down from the base level until 1x1, the texture is still RGBA8 at this point
+/// </summary>
+void Texture::GenerateMipChain()
+{
+	//Average 2x2 texels, all 4 channels at once in 16 bit lanes
+	const __m128i zero{ _mm_setzero_si128() };
+	const __m128i rounding{ _mm_set1_epi16(2) };
+	for (size_t levelIdx{ 1 }; levelIdx < m_MipLevels.size(); ++levelIdx)
+	{
+		const MipLevel& source{ m_MipLevels[levelIdx - 1] };
+		const MipLevel& level{ m_MipLevels[levelIdx] };
+
+		for (uint32_t row{}; row < level.height; ++row)
+		{
+			const uint32_t top{ std::min(2 * row, source.height - 1) };
+			const uint32_t bottom{ std::min(2 * row + 1, source.height - 1) };
+
+			for (uint32_t col{}; col < level.width; ++col)
+			{
+				const uint32_t left{ std::min(2 * col, source.width - 1) };
+				const uint32_t right{ std::min(2 * col + 1, source.width - 1) };
+				auto texel = [&](uint32_t sourceCol, uint32_t sourceRow) { return _mm_cvtsi32_si128(int(GetRGBA8Block(GetBlockIndex(source, sourceCol, sourceRow))[GetIndexInBlock(sourceCol, sourceRow)])); };
+				const __m128i topTexels{ _mm_unpacklo_epi8(_mm_unpacklo_epi32(texel(left, top), texel(right, top)), zero) };
+				const __m128i bottomTexels{ _mm_unpacklo_epi8(_mm_unpacklo_epi32(texel(left, bottom), texel(right, bottom)), zero) };
+
+				__m128i sum{ _mm_add_epi16(topTexels, bottomTexels) };
+				sum = _mm_add_epi16(sum, _mm_srli_si128(sum, 8));
+				sum = _mm_srli_epi16(_mm_add_epi16(sum, rounding), 2);
+				GetRGBA8Block(GetBlockIndex(level, col, row))[GetIndexInBlock(col, row)] = uint32_t(_mm_cvtsi128_si32(_mm_packus_epi16(sum, sum)));
+			}
+		}
+	}
+}
+
+/// <summary>
+/// Encode every RGBA8 block of the mip chain to a block compressed format
+/// </summary>
+/// <param name="format">BC1, BC3 or BC5</param>
+void Texture::Compress(TextureFormat format)
+{
+	const size_t blockByteSize{ BlockCompression::GetBlockByteSize(format) };
+	const size_t blockCount{ m_Blocks.size() / RGBA8_BLOCK_BYTE_SIZE };
+	decltype(m_Blocks) compressedBlocks(blockCount * blockByteSize);
 
-	uint32_t* pixels{ (uint32_t*)m_pTextureSurface->pixels };
-	int col{ int(Elite::Clamp(uv.x, 0.f, 1.f) * m_pTextureSurface->w) };
-	int row{ int(Elite::Clamp(uv.y, 0.f, 1.f) * m_pTextureSurface->h) };
-	int pixelIndex{ row * m_pTextureSurface->w + col };
-	uint8_t r, g, b, a;
+	for (const MipLevel& level : m_MipLevels)
+	{
+		for (uint32_t blockRow{}; blockRow < level.blockCountY; ++blockRow)
+		{
+			for (uint32_t blockCol{}; blockCol < level.blockCountX; ++blockCol)
+			{
+				//Levels smaller than a block repeat their edge texels instead of encoding the padding
+				uint32_t texels[BlockCompression::BLOCK_TEXEL_COUNT];
+				for (uint32_t idx{}; idx < BlockCompression::BLOCK_TEXEL_COUNT; ++idx)
+				{
+					const uint32_t col{ std::min(blockCol * BLOCK_SIZE + idx % BLOCK_SIZE, level.width - 1) };
+					const uint32_t row{ std::min(blockRow * BLOCK_SIZE + idx / BLOCK_SIZE, level.height - 1) };
+					texels[idx] = GetRGBA8Block(GetBlockIndex(level, col, row))[GetIndexInBlock(col, row)];
+				}
+
+				const size_t blockIdx{ level.firstBlock + size_t(blockRow) * level.blockCountX + blockCol };
+				BlockCompression::EncodeBlock(format, texels, compressedBlocks.data() + blockIdx * blockByteSize);
+			}
+		}
+	}
+
+	m_Blocks.swap(compressedBlocks);
+	m_pBlocks = m_Blocks.data();
+	m_Format = format;
+	m_BlockByteSize = blockByteSize;
+}
 
-	SDL_GetRGBA(pixels[pixelIndex], m_pTextureSurface->format, &r, &g, &b, &a);
-	return Elite::RGBColor(float(r), float(g), float(b), float(a)) / 255.f;
-}
\ No newline at end of file
+/// <summary>
+/// Alpha bounds of every block, from the stored blocks so they match what sampling decodes
+/// </summary>
+void Texture::ComputeAlphaRanges()
+{
+	m_AlphaRanges.resize(GetBlockCount());
+	for (const MipLevel& level : m_MipLevels)
+	{
+		for (uint32_t blockRow{}; blockRow < level.blockCountY; ++blockRow)
+		{
+			for (uint32_t blockCol{}; blockCol < level.blockCountX; ++blockCol)
+			{
+				//Texels past the level edges are padding, never sampled
+				const size_t blockIdx{ level.firstBlock + size_t(blockRow) * level.blockCountX + blockCol };
+				const uint32_t* pTexels{ GetDecodedBlock(blockIdx, m_pBlocks + blockIdx * m_BlockByteSize) };
+				AlphaRange range{ 0xFF, 0 };
+				for (uint32_t row{}; row < std::min(BLOCK_SIZE, level.height - blockRow * BLOCK_SIZE); ++row)
+				{
+					for (uint32_t col{}; col < std::min(BLOCK_SIZE, level.width - blockCol * BLOCK_SIZE); ++col)
+					{
+						const uint8_t alpha{ uint8_t(pTexels[row * BLOCK_SIZE + col] >> 24) };
+						range.min = std::min(range.min, alpha);
+						range.max = std::max(range.max, alpha);
+					}
+				}
+				m_AlphaRanges[blockIdx] = range;
+			}
+		}
+	}
+}
+
+uint32_t* Texture::GetRGBA8Block(size_t blockIdx)
+{
+	return reinterpret_cast<uint32_t*>(m_Blocks.data() + blockIdx * RGBA8_BLOCK_BYTE_SIZE);
+}
+
+/// <summary>
+/// Storage of a block, a virtual texture looks the block up in its resident pages
+/// </summary>
+/// <param name="level">Mip level</param>
+/// <param name="blockCol">Block column in the level</param>
+/// <param name="blockRow">Block row in the level</param>
+/// <returns>Block data, its page must be resident</returns>
+const uint8_t* Texture::GetBlockData(const MipLevel& level, uint32_t blockCol, uint32_t blockRow) const
+{
+	if (!IsVirtual())
+		return m_pBlocks + (level.firstBlock + size_t(blockRow) * level.blockCountX + blockCol) * m_BlockByteSize;
+
+	const BlockStorage& page{ m_Pages[level.firstPage + size_t(blockRow / PAGE_BLOCK_COUNT) * level.pageCountX + blockCol / PAGE_BLOCK_COUNT] };
+	return page.data() + (size_t(blockRow % PAGE_BLOCK_COUNT) * PAGE_BLOCK_COUNT + blockCol % PAGE_BLOCK_COUNT) * m_BlockByteSize;
+}
+
+/// <summary>
+/// Texels of a block, compressed blocks are decoded through the per thread cache
+/// </summary>
+/// <param name="blockIdx">Block index over the whole mip chain, identifies the block in the cache</param>
+/// <param name="pBlock">Block data</param>
+/// <returns>16 RGBA8 texels, valid until the next call on this thread</returns>
+const uint32_t* Texture::GetDecodedBlock(size_t blockIdx, const uint8_t* pBlock) const
+{
+	if (m_Format == TextureFormat::RGBA8)
+		return reinterpret_cast<const uint32_t*>(pBlock);
+
+	//The id offsets the slot so that textures sampled at the same uv don't evict each other
+	DecodedBlock& entry{ g_DecodedBlockCache[(blockIdx + size_t(m_Id) * 61) % DECODED_BLOCK_CACHE_SIZE] };
+	if (entry.textureId != m_Id || entry.blockIdx != blockIdx)
+	{
+		BlockCompression::DecodeBlock(m_Format, pBlock, entry.texels);
+		entry.textureId = m_Id;
+		entry.blockIdx = blockIdx;
+	}
+
+	return entry.texels;
+}
+
+/// <summary>
+/// Level of detail of a 2x2 pixel quad, from the largest uv footprint of a pixel step along x or y
+/// </summary>
+/// <param name="u">normalized horizontal coordinates, lanes in FragmentBlock order</param>
+/// <param name="v">normalized vertical coordinates, lanes in FragmentBlock order</param>
+/// <returns>Unclamped lod, negative when magnified</returns>
+float Texture::GetQuadLod(__m128 u, __m128 v) const
+{
+	alignas(16) float us[FRAGMENT_BLOCK_SIZE], vs[FRAGMENT_BLOCK_SIZE];
+	_mm_store_ps(us, u);
+	_mm_store_ps(vs, v);
+
+	const float width{ float(GetWidth()) };
+	const float height{ float(GetHeight()) };
+	const float dudx{ (us[1] - us[0]) * width }, dvdx{ (vs[1] - vs[0]) * height };
+	const float dudy{ (us[2] - us[0]) * width }, dvdy{ (vs[2] - vs[0]) * height };
+	const float footprintSquared{ std::max(dudx * dudx + dvdx * dvdx, dudy * dudy + dvdy * dvdy) };
+
+	return 0.5f * std::log2(footprintSquared);
+}
+
+/// <summary>
+/// Gather 4 texels of a mip level
+/// </summary>
+/// <param name="level">Mip level</param>
+/// <param name="col">Texel columns, in range</param>
+/// <param name="row">Texel rows, in range</param>
+/// <returns>RGBA8 texels</returns>
+__m128i Texture::FetchTexels(const MipLevel& level, __m128i col, __m128i row) const
+{
+	//Same addressing as GetBlockIndex and GetIndexInBlock
+	static_assert(BLOCK_SIZE == 4, "Block addressing is written with shifts for 4x4 blocks.");
+	const __m128i blockIdx{ _mm_add_epi32(_mm_mullo_epi32(_mm_srli_epi32(row, 2), _mm_set1_epi32(int(level.blockCountX))), _mm_srli_epi32(col, 2)) };
+	const __m128i inBlockMask{ _mm_set1_epi32(BLOCK_SIZE - 1) };
+	const __m128i inBlockIdx{ _mm_or_si128(_mm_slli_epi32(_mm_and_si128(row, inBlockMask), 2), _mm_and_si128(col, inBlockMask)) };
+
+	if (m_Format == TextureFormat::RGBA8 && !IsVirtual())
+	{
+		alignas(16) int32_t texelIndices[FRAGMENT_BLOCK_SIZE];
+		_mm_store_si128(reinterpret_cast<__m128i*>(texelIndices), _mm_or_si128(_mm_slli_epi32(blockIdx, 4), inBlockIdx));
+
+		const uint32_t* pTexels{ reinterpret_cast<const uint32_t*>(m_pBlocks) + level.firstBlock * BlockCompression::BLOCK_TEXEL_COUNT };
+		return _mm_set_epi32(int(pTexels[texelIndices[3]]), int(pTexels[texelIndices[2]]), int(pTexels[texelIndices[1]]), int(pTexels[texelIndices[0]]));
+	}
+
+	alignas(16) int32_t blockIndices[FRAGMENT_BLOCK_SIZE], blockCols[FRAGMENT_BLOCK_SIZE], blockRows[FRAGMENT_BLOCK_SIZE], inBlockIndices[FRAGMENT_BLOCK_SIZE];
+	_mm_store_si128(reinterpret_cast<__m128i*>(blockIndices), blockIdx);
+	_mm_store_si128(reinterpret_cast<__m128i*>(blockCols), _mm_srli_epi32(col, 2));
+	_mm_store_si128(reinterpret_cast<__m128i*>(blockRows), _mm_srli_epi32(row, 2));
+	_mm_store_si128(reinterpret_cast<__m128i*>(inBlockIndices), inBlockIdx);
+
+	//The lanes of a quad mostly share a block, only look it up again when it changes
+	alignas(16) uint32_t texels[FRAGMENT_BLOCK_SIZE];
+	const uint32_t* pBlock{ GetDecodedBlock(level.firstBlock + blockIndices[0], GetBlockData(level, blockCols[0], blockRows[0])) };
+	texels[0] = pBlock[inBlockIndices[0]];
+	for (int lane{ 1 }; lane < FRAGMENT_BLOCK_SIZE; ++lane)
+	{
+		if (blockIndices[lane] != blockIndices[lane - 1])
+			pBlock = GetDecodedBlock(level.firstBlock + blockIndices[lane], GetBlockData(level, blockCols[lane], blockRows[lane]));
+		texels[lane] = pBlock[inBlockIndices[lane]];
+	}
+
+	return _mm_load_si128(reinterpret_cast<const __m128i*>(texels));
+}
+
+__m128i Texture::SamplePoint(const MipLevel& level, __m128 u, __m128 v) const
+{
+	const __m128i col{ _mm_min_epi32(_mm_cvttps_epi32(_mm_mul_ps(Simd::Clamp(u, 0.f, 1.f), _mm_set1_ps(float(level.width)))), _mm_set1_epi32(int(level.width) - 1)) };
+	const __m128i row{ _mm_min_epi32(_mm_cvttps_epi32(_mm_mul_ps(Simd::Clamp(v, 0.f, 1.f), _mm_set1_ps(float(level.height)))), _mm_set1_epi32(int(level.height) - 1)) };
+	return FetchTexels(level, col, row);
+}
+
+/// <summary>
+/// Bilinear filter of 4 pixels in 16 bit fixed point, the 4 channels of a texel are filtered together
+/// </summary>
+/// <param name="level">Mip level</param>
+/// <param name="u">normalized horizontal coordinates</param>
+/// <param name="v">normalized vertical coordinates</param>
+/// <returns>RGBA8 colors</returns>
+__m128i Texture::SampleBilinear(const MipLevel& level, __m128 u, __m128 v) const
+{
+	//Texel centers are on half integers
+	const __m128 half{ _mm_set1_ps(0.5f) };
+	const __m128 x{ _mm_sub_ps(_mm_mul_ps(Simd::Clamp(u, 0.f, 1.f), _mm_set1_ps(float(level.width))), half) };
+	const __m128 y{ _mm_sub_ps(_mm_mul_ps(Simd::Clamp(v, 0.f, 1.f), _mm_set1_ps(float(level.height))), half) };
+	const __m128 xFloor{ _mm_floor_ps(x) };
+	const __m128 yFloor{ _mm_floor_ps(y) };
+
+	const __m128i zero{ _mm_setzero_si128() };
+	const __m128i one{ _mm_set1_epi32(1) };
+	const __m128i col{ _mm_cvttps_epi32(xFloor) };
+	const __m128i row{ _mm_cvttps_epi32(yFloor) };
+	const __m128i col0{ _mm_max_epi32(col, zero) };
+	const __m128i col1{ _mm_min_epi32(_mm_add_epi32(col, one), _mm_set1_epi32(int(level.width) - 1)) };
+	const __m128i row0{ _mm_max_epi32(row, zero) };
+	const __m128i row1{ _mm_min_epi32(_mm_add_epi32(row, one), _mm_set1_epi32(int(level.height) - 1)) };
+
+	//Blend weights in 1.15 fixed point
+	const __m128 fixedOne{ _mm_set1_ps(32767.f) };
+	const __m128i blendX{ _mm_cvtps_epi32(_mm_mul_ps(_mm_sub_ps(x, xFloor), fixedOne)) };
+	const __m128i blendY{ _mm_cvtps_epi32(_mm_mul_ps(_mm_sub_ps(y, yFloor), fixedOne)) };
+
+	const __m128i top{ Simd::LerpRGBA8(FetchTexels(level, col0, row0), FetchTexels(level, col1, row0), blendX) };
+	const __m128i bottom{ Simd::LerpRGBA8(FetchTexels(level, col0, row1), FetchTexels(level, col1, row1), blendX) };
+	return Simd::LerpRGBA8(top, bottom, blendY);
+}
+
+/// <summary>
+/// Heap memory held by the blocks, a texture mapped from its cache file only uses the OS file cache
+/// </summary>
+size_t Texture::GetMemorySize() const
+{
+	if (!IsVirtual())
+		return m_Blocks.size();
+
+	size_t memorySize{};
+	for (const BlockStorage& page : m_Pages)
+		memorySize += page.size();
+	return memorySize;
+}
+
+/// <summary>
+/// Alpha bounds of every texel a 2x2 pixel quad can read, with the same level selection as Sample.
+/// Lets transparent shading skip the quads that only see fully transparent texels
+/// </summary>
+/// <param name="u">normalized horizontal coordinates, lanes in FragmentBlock order</param>
+/// <param name="v">normalized vertical coordinates, lanes in FragmentBlock order</param>
+/// <param name="filterMode">Filtering the quad will be sampled with</param>
+/// <returns>Alpha range over the blocks under the quad footprint</returns>
+Texture::AlphaRange Texture::GetAlphaRange(__m128 u, __m128 v, FilterMode filterMode) const
+{
+	const float maxLod{ float(m_MipLevels.size() - 1) };
+	//Same NaN guard as Sample
+	float lod{ GetQuadLod(u, v) };
+	if (!(lod >= 0.f))
+		lod = 0.f;
+
+	//Trilinear filtering may also read the next level
+	size_t firstLevelIdx{}, lastLevelIdx{};
+	if (filterMode == FilterMode::ANISOTROPIC)
+	{
+		const size_t levelIdx{ size_t(Elite::Clamp(lod, 0.f, maxLod)) };
+		firstLevelIdx = GetResidentLevel(levelIdx, u, v);
+		lastLevelIdx = firstLevelIdx == levelIdx ? std::min(levelIdx + 1, m_MipLevels.size() - 1) : firstLevelIdx;
+	}
+	else
+	{
+		firstLevelIdx = GetResidentLevel(size_t(Elite::Clamp(lod + 0.5f, 0.f, maxLod)), u, v);
+		lastLevelIdx = firstLevelIdx;
+	}
+
+	alignas(16) float us[FRAGMENT_BLOCK_SIZE], vs[FRAGMENT_BLOCK_SIZE];
+	_mm_store_ps(us, Simd::Clamp(u, 0.f, 1.f));
+	_mm_store_ps(vs, Simd::Clamp(v, 0.f, 1.f));
+	const float uMin{ *std::min_element(us, us + FRAGMENT_BLOCK_SIZE) }, uMax{ *std::max_element(us, us + FRAGMENT_BLOCK_SIZE) };
+	const float vMin{ *std::min_element(vs, vs + FRAGMENT_BLOCK_SIZE) }, vMax{ *std::max_element(vs, vs + FRAGMENT_BLOCK_SIZE) };
+
+	AlphaRange range{ 0xFF, 0 };
+	for (size_t levelIdx{ firstLevelIdx }; levelIdx <= lastLevelIdx; ++levelIdx)
+	{
+		//Bilinear footprint of the extreme coordinates, it holds the point sampled texels as well
+		const MipLevel& level{ m_MipLevels[levelIdx] };
+		const uint32_t firstBlockCol{ uint32_t(Elite::Clamp(uMin * level.width - 0.5f, 0.f, float(level.width - 1))) / BLOCK_SIZE };
+		const uint32_t lastBlockCol{ uint32_t(Elite::Clamp(uMax * level.width + 0.5f, 0.f, float(level.width - 1))) / BLOCK_SIZE };
+		const uint32_t firstBlockRow{ uint32_t(Elite::Clamp(vMin * level.height - 0.5f, 0.f, float(level.height - 1))) / BLOCK_SIZE };
+		const uint32_t lastBlockRow{ uint32_t(Elite::Clamp(vMax * level.height + 0.5f, 0.f, float(level.height - 1))) / BLOCK_SIZE };
+
+		for (uint32_t blockRow{ firstBlockRow }; blockRow <= lastBlockRow; ++blockRow)
+		{
+			const AlphaRange* pRanges{ m_AlphaRanges.data() + level.firstBlock + size_t(blockRow) * level.blockCountX };
+			for (uint32_t blockCol{ firstBlockCol }; blockCol <= lastBlockCol; ++blockCol)
+			{
+				range.min = std::min(range.min, pRanges[blockCol].min);
+				range.max = std::max(range.max, pRanges[blockCol].max);
+			}
+		}
+	}
+
+	return range;
+}
+
+size_t Texture::GetBlockCount() const
+{
+	const MipLevel& lastLevel{ m_MipLevels.back() };
+	return lastLevel.firstBlock + size_t(lastLevel.blockCountX) * lastLevel.blockCountY;
+}
+
+#pragma region Cache
+/// <summary>
+/// Cache file of a source converted to a format, next to the source
+/// </summary>
+/// <param name="sourcePath">Image file, or any unique path next to the sources of a baked texture</param>
+/// <param name="format">Requested storage format</param>
+/// <returns>Cache file path</returns>
+std::string Texture::GetCachePath(const std::string& sourcePath, TextureFormat format)
+{
+	switch (format)
+	{
+	case TextureFormat::BC1:
+		return sourcePath + ".bc1.texcache";
+	case TextureFormat::BC3:
+		return sourcePath + ".bc3.texcache";
+	case TextureFormat::BC5:
+		return sourcePath + ".bc5.texcache";
+	default:
+		return sourcePath + ".rgba8.texcache";
+	}
+}
+
+/// <summary>
+/// Map a texture from its cache file
+/// </summary>
+/// <param name="cachePath">Cache file</param>
+/// <param name="sourceHash">Hash of everything the texture was converted from</param>
+/// <returns>Texture sampling straight from the mapped file, nullptr when the cache is missing or stale</returns>
+std::unique_ptr<Texture> Texture::LoadCache(const std::string& cachePath, uint64_t sourceHash)
+{
+	std::unique_ptr<Texture> pTexture{ new Texture{} };
+	if (!pTexture->MapCache(cachePath, sourceHash))
+		return nullptr;
+
+	return pTexture;
+}
+
+/// <summary>
+/// Write the converted mip chain to a cache file. It is written next to its final path then renamed,
+/// so a load running at the same time never maps a partial file
+/// </summary>
+/// <param name="cachePath">Cache file</param>
+/// <param name="sourceHash">Hash of everything the texture was converted from</param>
+/// <returns>False when the file couldn't be written, the texture itself is unaffected</returns>
+bool Texture::WriteCache(const std::string& cachePath, uint64_t sourceHash) const
+{
+	if (!m_pBlocks)
+		return false;
+
+	const size_t blockDataSize{ GetBlockCount() * m_BlockByteSize };
+	TextureCacheHeader header{};
+	header.magic = TEXTURE_CACHE_MAGIC;
+	header.version = TEXTURE_CACHE_VERSION;
+	header.sourceHash = sourceHash;
+	header.format = uint32_t(m_Format);
+	header.width = GetWidth();
+	header.height = GetHeight();
+	header.mipLevelCount = GetMipLevelCount();
+	header.blockDataSize = blockDataSize;
+
+	uint8_t headerBytes[TEXTURE_CACHE_DATA_OFFSET]{};
+	std::memcpy(headerBytes, &header, sizeof(header));
+
+	const std::string tempPath{ cachePath + "." + std::to_string(m_Id) + ".tmp" };
+	{
+		std::ofstream file{ tempPath, std::ios::binary | std::ios::trunc };
+		file.write(reinterpret_cast<const char*>(headerBytes), std::streamsize(sizeof(headerBytes)));
+		file.write(reinterpret_cast<const char*>(m_pBlocks), std::streamsize(blockDataSize));
+		file.write(reinterpret_cast<const char*>(m_AlphaRanges.data()), std::streamsize(m_AlphaRanges.size() * sizeof(AlphaRange)));
+		if (!file)
+		{
+			file.close();
+			std::remove(tempPath.c_str());
+			std::cout << "Could not write texture cache: " << cachePath << std::endl;
+			return false;
+		}
+	}
+
+	//Renaming fails when the cache exists and is mapped by another texture, it is valid then anyway
+	std::error_code error{};
+	std::filesystem::rename(tempPath, cachePath, error);
+	if (error)
+	{
+		std::remove(tempPath.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+/// <summary>
+/// Map the blocks of a cache file, the header has to match the source and the mip chain layout
+/// </summary>
+/// <param name="cachePath">Cache file</param>
+/// <param name="sourceHash">Hash of everything the texture was converted from</param>
+/// <returns>False when the cache is missing or stale, the texture is left empty</returns>
+bool Texture::MapCache(const std::string& cachePath, uint64_t sourceHash)
+{
+	MappedFile cacheFile{};
+	if (!cacheFile.Open(cachePath) || cacheFile.GetSize() < TEXTURE_CACHE_DATA_OFFSET)
+		return false;
+
+	TextureCacheHeader header{};
+	std::memcpy(&header, cacheFile.GetData(), sizeof(header));
+	if (header.magic != TEXTURE_CACHE_MAGIC || header.version != TEXTURE_CACHE_VERSION || header.sourceHash != sourceHash
+		|| header.format >= uint32_t(TextureFormat::COUNT) || header.width == 0 || header.height == 0)
+		return false;
+
+	const size_t blockCount{ LayoutMipChain(header.width, header.height) };
+	const TextureFormat format{ TextureFormat(header.format) };
+	const size_t blockByteSize{ BlockCompression::GetBlockByteSize(format) };
+	if (header.mipLevelCount != m_MipLevels.size() || header.blockDataSize != blockCount * blockByteSize
+		|| cacheFile.GetSize() < TEXTURE_CACHE_DATA_OFFSET + header.blockDataSize + blockCount * sizeof(AlphaRange))
+	{
+		m_MipLevels.clear();
+		return false;
+	}
+
+	//The alpha ranges are copied out, they outlive the mapping of a virtual texture
+	m_AlphaRanges.resize(blockCount);
+	std::memcpy(m_AlphaRanges.data(), cacheFile.GetData() + TEXTURE_CACHE_DATA_OFFSET + header.blockDataSize, blockCount * sizeof(AlphaRange));
+
+	m_Format = format;
+	m_BlockByteSize = blockByteSize;
+	m_SourceHash = sourceHash;
+	m_CacheFile = std::move(cacheFile);
+	m_pBlocks = m_CacheFile.GetData() + TEXTURE_CACHE_DATA_OFFSET;
+	return true;
+}
+#pragma endregion
+
+#pragma region VirtualTexturing
+/// <summary>
+/// Move the mip chain to a page file, only the levels fitting in one page stay in memory.
+/// Called once after load, the texture then has to be registered to the VirtualTextureStreamer
+/// </summary>
+/// <param name="pageFilePath">File written with every page, the texture stays resident when it can't be written</param>
+void Texture::Virtualize(const std::string& pageFilePath)
+{
+	std::ofstream file{ pageFilePath, std::ios::binary | std::ios::trunc };
+	if (!file)
+	{
+		std::cout << "Could not create page file, texture kept resident: " << pageFilePath << std::endl;
+		return;
+	}
+
+	size_t pageCount{};
+	for (MipLevel& level : m_MipLevels)
+	{
+		level.firstPage = pageCount;
+		level.pageCountX = (level.blockCountX + PAGE_BLOCK_COUNT - 1) / PAGE_BLOCK_COUNT;
+		level.pageCountY = (level.blockCountY + PAGE_BLOCK_COUNT - 1) / PAGE_BLOCK_COUNT;
+		pageCount += size_t(level.pageCountX) * level.pageCountY;
+	}
+
+	//Pages always hold 32x32 blocks, the ones past the level edges are left empty
+	m_Pages.resize(pageCount);
+	m_PageFeedback = std::make_unique<std::atomic<uint8_t>[]>(pageCount);
+	BlockStorage page(GetPageByteSize());
+	for (const MipLevel& level : m_MipLevels)
+	{
+		for (uint32_t pageRow{}; pageRow < level.pageCountY; ++pageRow)
+		{
+			for (uint32_t pageCol{}; pageCol < level.pageCountX; ++pageCol)
+			{
+				std::fill(page.begin(), page.end(), uint8_t(0));
+				for (uint32_t blockRow{ pageRow * PAGE_BLOCK_COUNT }; blockRow < std::min((pageRow + 1) * PAGE_BLOCK_COUNT, level.blockCountY); ++blockRow)
+				{
+					const uint32_t firstBlockCol{ pageCol * PAGE_BLOCK_COUNT };
+					const uint32_t blockCount{ std::min(PAGE_BLOCK_COUNT, level.blockCountX - firstBlockCol) };
+					std::memcpy(page.data() + size_t(blockRow % PAGE_BLOCK_COUNT) * PAGE_BLOCK_COUNT * m_BlockByteSize,
+						m_pBlocks + (level.firstBlock + size_t(blockRow) * level.blockCountX + firstBlockCol) * m_BlockByteSize,
+						blockCount * m_BlockByteSize);
+				}
+
+				const size_t pageIdx{ level.firstPage + size_t(pageRow) * level.pageCountX + pageCol };
+				file.write(reinterpret_cast<const char*>(page.data()), std::streamsize(page.size()));
+				if (IsPagePinned(pageIdx))
+					m_Pages[pageIdx] = page;
+			}
+		}
+	}
+
+	if (!file)
+	{
+		std::cout << "Could not write page file, texture kept resident: " << pageFilePath << std::endl;
+		file.close();
+		std::remove(pageFilePath.c_str());
+		m_Pages.clear();
+		m_PageFeedback.reset();
+		return;
+	}
+
+	BlockStorage{}.swap(m_Blocks);
+	m_CacheFile.Close();
+	m_pBlocks = nullptr;
+	m_PageFilePath = pageFilePath;
+}
+
+uint32_t Texture::GetPageMipLevel(size_t pageIdx) const
+{
+	uint32_t levelIdx{};
+	while (levelIdx + 1 < m_MipLevels.size() && m_MipLevels[levelIdx + 1].firstPage <= pageIdx)
+		++levelIdx;
+	return levelIdx;
+}
+
+bool Texture::IsPagePinned(size_t pageIdx) const
+{
+	const MipLevel& level{ m_MipLevels[GetPageMipLevel(pageIdx)] };
+	return level.pageCountX * level.pageCountY == 1;
+}
+
+/// <summary>
+/// Read and clear the feedback of a page
+/// </summary>
+/// <param name="pageIdx">Page index over the whole mip chain</param>
+/// <returns>True when the page was wanted by sampling since the last call</returns>
+bool Texture::ConsumePageFeedback(size_t pageIdx)
+{
+	return m_PageFeedback[pageIdx].exchange(0, std::memory_order_relaxed) != 0;
+}
+
+void Texture::SetPage(size_t pageIdx, BlockStorage&& blocks)
+{
+	m_Pages[pageIdx] = std::move(blocks);
+}
+
+void Texture::EvictPage(size_t pageIdx)
+{
+	BlockStorage{}.swap(m_Pages[pageIdx]);
+}
+
+/// <summary>
+/// Gather the whole mip chain of a virtual texture from its page file, in the resident block layout
+/// </summary>
+/// <returns>Blocks of every level</returns>
+Texture::BlockStorage Texture::ReadAllBlocks() const
+{
+	BlockStorage blocks(GetBlockCount() * m_BlockByteSize);
+	BlockStorage page(GetPageByteSize());
+	std::ifstream file{ m_PageFilePath, std::ios::binary };
+	for (const MipLevel& level : m_MipLevels)
+	{
+		for (uint32_t pageRow{}; pageRow < level.pageCountY; ++pageRow)
+		{
+			for (uint32_t pageCol{}; pageCol < level.pageCountX; ++pageCol)
+			{
+				const size_t pageIdx{ level.firstPage + size_t(pageRow) * level.pageCountX + pageCol };
+				file.seekg(std::streamoff(pageIdx * page.size()));
+				file.read(reinterpret_cast<char*>(page.data()), std::streamsize(page.size()));
+
+				for (uint32_t blockRow{ pageRow * PAGE_BLOCK_COUNT }; blockRow < std::min((pageRow + 1) * PAGE_BLOCK_COUNT, level.blockCountY); ++blockRow)
+				{
+					const uint32_t firstBlockCol{ pageCol * PAGE_BLOCK_COUNT };
+					const uint32_t blockCount{ std::min(PAGE_BLOCK_COUNT, level.blockCountX - firstBlockCol) };
+					std::memcpy(blocks.data() + (level.firstBlock + size_t(blockRow) * level.blockCountX + firstBlockCol) * m_BlockByteSize,
+						page.data() + size_t(blockRow % PAGE_BLOCK_COUNT) * PAGE_BLOCK_COUNT * m_BlockByteSize,
+						blockCount * m_BlockByteSize);
+				}
+			}
+		}
+	}
+
+	if (!file)
+		std::cout << "Could not read page file: " << m_PageFilePath << std::endl;
+
+	return blocks;
+}
+
+/// <summary>
+/// Finest level from levelIdx down whose pages under the footprint are all resident.
+/// Every page wanted on the way is flagged in the feedback for the streamer
+/// </summary>
+/// <param name="levelIdx">Wanted level</param>
+/// <param name="uMin">Footprint left, normalized</param>
+/// <param name="uMax">Footprint right, normalized</param>
+/// <param name="vMin">Footprint top, normalized</param>
+/// <param name="vMax">Footprint bottom, normalized</param>
+/// <returns>Level to sample, levels fitting in one page are always resident</returns>
+size_t Texture::GetResidentLevel(size_t levelIdx, float uMin, float uMax, float vMin, float vMax) const
+{
+	if (!IsVirtual())
+		return levelIdx;
+
+	for (; levelIdx < m_MipLevels.size(); ++levelIdx)
+	{
+		//One texel of margin for the bilinear neighbours
+		const MipLevel& level{ m_MipLevels[levelIdx] };
+		const uint32_t pageTexelCount{ PAGE_BLOCK_COUNT * BLOCK_SIZE };
+		const uint32_t firstPageCol{ uint32_t(Elite::Clamp(uMin * level.width - 1.f, 0.f, float(level.width - 1))) / pageTexelCount };
+		const uint32_t lastPageCol{ uint32_t(Elite::Clamp(uMax * level.width + 1.f, 0.f, float(level.width - 1))) / pageTexelCount };
+		const uint32_t firstPageRow{ uint32_t(Elite::Clamp(vMin * level.height - 1.f, 0.f, float(level.height - 1))) / pageTexelCount };
+		const uint32_t lastPageRow{ uint32_t(Elite::Clamp(vMax * level.height + 1.f, 0.f, float(level.height - 1))) / pageTexelCount };
+
+		bool isResident{ true };
+		for (uint32_t pageRow{ firstPageRow }; pageRow <= lastPageRow; ++pageRow)
+		{
+			for (uint32_t pageCol{ firstPageCol }; pageCol <= lastPageCol; ++pageCol)
+			{
+				const size_t pageIdx{ level.firstPage + size_t(pageRow) * level.pageCountX + pageCol };
+				//Only written when clear, so threads sampling the same page don't keep bouncing its cache line
+				if (m_PageFeedback[pageIdx].load(std::memory_order_relaxed) == 0)
+					m_PageFeedback[pageIdx].store(1, std::memory_order_relaxed);
+				isResident &= IsPageResident(pageIdx);
+			}
+		}
+
+		if (isResident)
+			return levelIdx;
+	}
+
+	return m_MipLevels.size() - 1;
+}
+
+size_t Texture::GetResidentLevel(size_t levelIdx, __m128 u, __m128 v) const
+{
+	if (!IsVirtual())
+		return levelIdx;
+
+	alignas(16) float us[FRAGMENT_BLOCK_SIZE], vs[FRAGMENT_BLOCK_SIZE];
+	_mm_store_ps(us, Simd::Clamp(u, 0.f, 1.f));
+	_mm_store_ps(vs, Simd::Clamp(v, 0.f, 1.f));
+	return GetResidentLevel(levelIdx, *std::min_element(us, us + FRAGMENT_BLOCK_SIZE), *std::max_element(us, us + FRAGMENT_BLOCK_SIZE),
+		*std::min_element(vs, vs + FRAGMENT_BLOCK_SIZE), *std::max_element(vs, vs + FRAGMENT_BLOCK_SIZE));
+}
+#pragma endregion
@@ -1,13 +1,22 @@
 #pragma once
 #include <string>
-#include <SDL_surface.h>
+#include <vector>
+#include <memory>
+#include <future>
+#include <atomic>
 #include "ERGBColor.h"
 #include "EMath.h"
+#include "Enum.h"
+#include "SimdUtils.h"
+#include "Utils.h"
+#include "BlockCompression.h"
+#include "MappedFile.h"
 
 class Texture final
 {
 public:
-	explicit Texture(const std::string& texturePath);
+	explicit Texture(const std::string& texturePath, TextureFormat format = TextureFormat::RGBA8);
+	explicit Texture(uint32_t width, uint32_t height, const std::vector<uint32_t>& texels, TextureFormat format = TextureFormat::RGBA8, uint64_t sourceHash = 0);
 	Texture(const Texture& texture) = delete;
 	Texture(Texture&& texture) noexcept = delete;
 	Texture& operator=(const Texture& texture) = delete;
@@ -17,13 +26,157 @@ public:
 	ID3D11ShaderResourceView* GetTextureResourceView() const { return m_pTextureView; };
 
 	Elite::RGBColor Sample(const Elite::FVector2& uv) const;
+	Simd::RGBColorx4 Sample(__m128 u, __m128 v, FilterMode filterMode) const;
+
+	//Alpha bounds of the texels a sample can read, precomputed for every block of every level
+	struct AlphaRange
+	{
+		uint8_t min;
+		uint8_t max;
+	};
+	AlphaRange GetAlphaRange(__m128 u, __m128 v, FilterMode filterMode) const;
 
 	void LoadToGPU(ID3D11Device* pDevice);
 	void ClearGPUResources();
 
+	uint32_t GetWidth() const { return m_MipLevels[0].width; };
+	uint32_t GetHeight() const { return m_MipLevels[0].height; };
+	uint32_t GetMipLevelCount() const { return uint32_t(m_MipLevels.size()); };
+	TextureFormat GetFormat() const { return m_Format; };
+	size_t GetMemorySize() const;
+	//Hash of the files the texture was converted from, for packed textures also which channel of which file fills each channel.
+	//What anything baked from the texture is keyed on, zero when it wasn't loaded from files
+	uint64_t GetSourceHash() const { return m_SourceHash; };
+
+	static bool LoadRGBA8Image(const std::string& texturePath, uint32_t& width, uint32_t& height, std::vector<uint32_t>& texels);
+
+	//The converted mip chain is cached in a file next to its source, later loads map it instead of decoding and compressing again
+	static std::string GetCachePath(const std::string& sourcePath, TextureFormat format);
+	static std::unique_ptr<Texture> LoadCache(const std::string& cachePath, uint64_t sourceHash);
+	bool WriteCache(const std::string& cachePath, uint64_t sourceHash) const;
+
+	//Every level is stored as 4x4 texel blocks laid out row by row, a RGBA8 block is one 64 bytes cache line
+	static constexpr uint32_t BLOCK_SIZE{ BlockCompression::BLOCK_SIZE };
+	static constexpr size_t RGBA8_BLOCK_BYTE_SIZE{ BlockCompression::BLOCK_TEXEL_COUNT * sizeof(uint32_t) };
+	using BlockStorage = std::vector<uint8_t, Utils::AlignedAllocator<uint8_t, RGBA8_BLOCK_BYTE_SIZE>>;
+
+#pragma region VirtualTexturing
+	//A virtual texture keeps its pages in a page file, the VirtualTextureStreamer makes the sampled ones resident
+	void Virtualize(const std::string& pageFilePath);
+	bool IsVirtual() const { return !m_PageFilePath.empty(); };
+	const std::string& GetPageFilePath() const { return m_PageFilePath; };
+	size_t GetPageCount() const { return m_Pages.size(); };
+	size_t GetPageByteSize() const { return size_t(PAGE_BLOCK_COUNT) * PAGE_BLOCK_COUNT * m_BlockByteSize; };
+	uint32_t GetPageMipLevel(size_t pageIdx) const;
+	bool IsPageResident(size_t pageIdx) const { return !m_Pages[pageIdx].empty(); };
+	bool IsPagePinned(size_t pageIdx) const;
+	bool ConsumePageFeedback(size_t pageIdx);
+	void SetPage(size_t pageIdx, BlockStorage&& blocks);
+	void EvictPage(size_t pageIdx);
+#pragma endregion
+
 private:
-	SDL_Surface* m_pTextureSurface;
+	//Pages are squares of 32x32 blocks (128x128 texels), levels that fit in one page stay resident
+	static constexpr uint32_t PAGE_BLOCK_COUNT{ 32 };
+
+	struct MipLevel
+	{
+		size_t firstBlock;
+		uint32_t width;
+		uint32_t height;
+		uint32_t blockCountX;
+		uint32_t blockCountY;
+		size_t firstPage;
+		uint32_t pageCountX;
+		uint32_t pageCountY;
+	};
+
+	//RGBA8 blocks hold texels in RGBA8 byte order (R in the lowest byte), row by row, compressed blocks follow the BC layouts.
+	//Sampling reads the blocks through m_pBlocks, pointing in m_Blocks or straight in the mapped cache file
+	BlockStorage m_Blocks;
+	MappedFile m_CacheFile;
+	const uint8_t* m_pBlocks;
+	std::vector<MipLevel> m_MipLevels;
+	//One range per block, indexed like the blocks
+	std::vector<AlphaRange> m_AlphaRanges;
+	TextureFormat m_Format;
+	size_t m_BlockByteSize;
+	uint64_t m_SourceHash;
+	uint32_t m_Id;
+	//Virtual texture pages, empty when not resident. The feedback holds one flag per page, set when sampling wants that page.
+	//The flags are atomic as the rasterizer threads sample concurrently, they only signal a page is wanted so relaxed order is enough
+	std::vector<BlockStorage> m_Pages;
+	mutable std::unique_ptr<std::atomic<uint8_t>[]> m_PageFeedback;
+	std::string m_PageFilePath;
 	ID3D11Texture2D* m_pTexture;
 	ID3D11ShaderResourceView* m_pTextureView;
+
+	static size_t GetBlockIndex(const MipLevel& level, uint32_t col, uint32_t row)
+	{
+		return level.firstBlock + size_t(row / BLOCK_SIZE) * level.blockCountX + col / BLOCK_SIZE;
+	}
+
+	static uint32_t GetIndexInBlock(uint32_t col, uint32_t row)
+	{
+		return (row % BLOCK_SIZE) * BLOCK_SIZE + col % BLOCK_SIZE;
+	}
+
+	Texture();
+
+	void Initialize(uint32_t width, uint32_t height, const uint32_t* pTexels, TextureFormat format);
+	size_t LayoutMipChain(uint32_t width, uint32_t height);
+	void AllocateMipChain(uint32_t width, uint32_t height);
+	bool MapCache(const std::string& cachePath, uint64_t sourceHash);
+	size_t GetBlockCount() const;
+	void GenerateMipChain();
+	void Compress(TextureFormat format);
+	void ComputeAlphaRanges();
+	uint32_t* GetRGBA8Block(size_t blockIdx);
+	BlockStorage ReadAllBlocks() const;
+	const uint8_t* GetBlockData(const MipLevel& level, uint32_t blockCol, uint32_t blockRow) const;
+	const uint32_t* GetDecodedBlock(size_t blockIdx, const uint8_t* pBlock) const;
+	size_t GetResidentLevel(size_t levelIdx, float uMin, float uMax, float vMin, float vMax) const;
+	size_t GetResidentLevel(size_t levelIdx, __m128 u, __m128 v) const;
+	float GetQuadLod(__m128 u, __m128 v) const;
+	__m128i FetchTexels(const MipLevel& level, __m128i col, __m128i row) const;
+	__m128i SamplePoint(const MipLevel& level, __m128 u, __m128 v) const;
+	__m128i SampleBilinear(const MipLevel& level, __m128 u, __m128 v) const;
 };
 
+//Texture loaded on the ThreadPool, resolved to the texture the first time it is used
+class TextureHandle final
+{
+public:
+	TextureHandle() : m_Future{}, m_pTexture{ nullptr } {};
+	explicit TextureHandle(std::shared_future<std::unique_ptr<Texture>> future) : m_Future{ std::move(future) }, m_pTexture{ nullptr } {};
+	TextureHandle(const TextureHandle& other) : m_Future{ other.m_Future }, m_pTexture{ other.m_pTexture.load(std::memory_order_acquire) } {};
+	TextureHandle& operator=(const TextureHandle& other)
+	{
+		m_Future = other.m_Future;
+		m_pTexture.store(other.m_pTexture.load(std::memory_order_acquire), std::memory_order_release);
+		return *this;
+	};
+
+	/// <summary>
+	/// Texture once loaded, the first call waits for the load to finish
+	/// </summary>
+	/// <returns>Loaded texture, nullptr for an empty handle or a failed load</returns>
+	const Texture* Get() const
+	{
+		const Texture* pTexture{ m_pTexture.load(std::memory_order_acquire) };
+		if (!pTexture && m_Future.valid())
+		{
+			pTexture = m_Future.get().get();
+			m_pTexture.store(pTexture, std::memory_order_release);
+		}
+		return pTexture;
+	};
+
+	bool IsValid() const { return m_Future.valid(); };
+	bool IsReady() const { return m_Future.valid() && m_Future.wait_for(std::chrono::seconds{ 0 }) == std::future_status::ready; };
+
+private:
+	std::shared_future<std::unique_ptr<Texture>> m_Future;
+	//Resolved texture cached so shading doesn't go through the future every sample
+	mutable std::atomic<const Texture*> m_pTexture;
+};
@@ -0,0 +1,57 @@
+#include "pch.h"
+#include "ThreadPool.h"
+
+ThreadPool* ThreadPool::m_Instance = nullptr;
+
+ThreadPool* ThreadPool::GetInstance()
+{
+	return m_Instance ? m_Instance : (m_Instance = new ThreadPool());
+}
+
+ThreadPool::ThreadPool()
+	: m_Workers{}
+	, m_Tasks{}
+	, m_Mutex{}
+	, m_Condition{}
+	, m_IsStopping{ false }
+{
+	//Leave a core to the main thread
+	const unsigned int workerCount{ std::max(std::thread::hardware_concurrency(), 2u) - 1 };
+	m_Workers.reserve(workerCount);
+	for (unsigned int workerIdx{}; workerIdx < workerCount; ++workerIdx)
+		m_Workers.emplace_back(&ThreadPool::RunWorker, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+	//Queued tasks still run, their futures may be waited on by the objects being destroyed
+	{
+		std::lock_guard<std::mutex> lock{ m_Mutex };
+		m_IsStopping = true;
+	}
+	m_Condition.notify_all();
+
+	for (std::thread& worker : m_Workers)
+		worker.join();
+
+	m_Instance = nullptr;
+}
+
+void ThreadPool::RunWorker()
+{
+	while (true)
+	{
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock{ m_Mutex };
+			m_Condition.wait(lock, [this]() { return m_IsStopping || !m_Tasks.empty(); });
+			if (m_Tasks.empty())
+				return;
+
+			task = std::move(m_Tasks.front());
+			m_Tasks.pop();
+		}
+
+		task();
+	}
+}
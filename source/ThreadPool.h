@@ -0,0 +1,59 @@
+#pragma once
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <type_traits>
+
+//Fixed set of worker threads running queued tasks in submission order, used for loading work off the main thread
+class ThreadPool
+{
+public:
+	static ThreadPool* GetInstance();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool(ThreadPool&&) noexcept = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+	ThreadPool& operator=(ThreadPool&&) noexcept = delete;
+	~ThreadPool();
+
+	/// <summary>
+	/// Queue a task on the workers
+	/// </summary>
+	/// <param name="task">Callable without parameters</param>
+	/// <returns>Future of the task result, exceptions thrown by the task are rethrown by get</returns>
+	template<typename TASK>
+	std::future<std::invoke_result_t<std::decay_t<TASK>>> Enqueue(TASK&& task)
+	{
+		using Result = std::invoke_result_t<std::decay_t<TASK>>;
+
+		//std::function needs a copyable callable, the packaged task is shared with the queued wrapper
+		auto pTask{ std::make_shared<std::packaged_task<Result()>>(std::forward<TASK>(task)) };
+		std::future<Result> result{ pTask->get_future() };
+		{
+			std::lock_guard<std::mutex> lock{ m_Mutex };
+			m_Tasks.emplace([pTask]() { (*pTask)(); });
+		}
+		m_Condition.notify_one();
+		return result;
+	}
+
+	size_t GetWorkerCount() const { return m_Workers.size(); };
+
+private:
+	ThreadPool();
+
+	static ThreadPool* m_Instance;
+
+	std::vector<std::thread> m_Workers;
+	std::queue<std::function<void()>> m_Tasks;
+	std::mutex m_Mutex;
+	std::condition_variable m_Condition;
+	bool m_IsStopping;
+
+	void RunWorker();
+};
@@ -3,9 +3,10 @@
 #include "Texture.h"
 #include "ProjectSettings.h"
 #include "Utils.h"
+#include "SoftwarePipeline.h"
 
-TransparentDiffuseEffect::TransparentDiffuseEffect(ID3D11Device* pDevice, const std::wstring& shaderPath, const Texture* pDiffuse)
-	: Effect(shaderPath, MaterialType::TRANSPARENT_MATERIAL, pDiffuse)
+TransparentDiffuseEffect::TransparentDiffuseEffect(ID3D11Device* pDevice, const std::wstring& shaderPath, TextureHandle diffuseMap)
+	: Effect(shaderPath, MaterialType::TRANSPARENT_MATERIAL, diffuseMap)
 	, m_pDXNoBlendingState(nullptr)
 	, m_pDXWriteEnabledDepthState(nullptr)
 {
@@ -90,7 +91,33 @@ void TransparentDiffuseEffect::ClearGPUResources()
 /// <returns>Final pixel color</returns>
 Elite::RGBColor TransparentDiffuseEffect::PixelShading(const Vertex_Output& pixelInfo) const
 {
-	return m_pDiffuseMap ? m_pDiffuseMap->Sample(pixelInfo.uv) : Elite::RGBColor{};
+	const Texture* pDiffuseMap{ m_DiffuseMap.Get() };
+	return pDiffuseMap ? pDiffuseMap->Sample(pixelInfo.uv) : Elite::RGBColor{};
+}
+
+/// <summary>
+/// Vectorized pixel shading
+/// </summary>
+/// <param name="fragments">Interpolated fragments information</param>
+/// <param name="outColors">Final fragments colors, SDL ARGB packed</param>
+void TransparentDiffuseEffect::PixelShadingBlock(const FragmentBlock& fragments, uint32_t outColors[FRAGMENT_BLOCK_SIZE]) const
+{
+	Simd::RGBColorx4 pixelColor{ _mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps() };
+	if (const Texture* pDiffuseMap{ m_DiffuseMap.Get() })
+		pixelColor = pDiffuseMap->Sample(_mm_load_ps(fragments.u), _mm_load_ps(fragments.v), ProjectSettings::GetInstance()->GetFilterMode());
+
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(outColors), Simd::GetSDL_ARGBColor(pixelColor));
+}
+
+/// <summary>
+/// Quad culling from the precomputed alpha bounds of the diffuse map
+/// </summary>
+/// <param name="fragments">Interpolated fragments information</param>
+/// <returns>True when every texel the quad would sample is fully transparent</returns>
+bool TransparentDiffuseEffect::IsBlockTransparent(const FragmentBlock& fragments) const
+{
+	const Texture* pDiffuseMap{ m_DiffuseMap.Get() };
+	return !pDiffuseMap || pDiffuseMap->GetAlphaRange(_mm_load_ps(fragments.u), _mm_load_ps(fragments.v), ProjectSettings::GetInstance()->GetFilterMode()).max == 0;
 }
 
 ID3D11BlendState* TransparentDiffuseEffect::GetBlendState() const
@@ -101,4 +128,19 @@ ID3D11BlendState* TransparentDiffuseEffect::GetBlendState() const
 ID3D11DepthStencilState* TransparentDiffuseEffect::GetDepthState() const
 {
 	return ProjectSettings::GetInstance()->UseTransparency() ? m_pDXDefaultDepthState : m_pDXWriteEnabledDepthState;
+}
+
+BlendMode TransparentDiffuseEffect::GetBlendMode() const
+{
+	return ProjectSettings::GetInstance()->UseTransparency() ? BlendMode::ALPHA_BLENDING : BlendMode::NO_BLENDING;
+}
+
+bool TransparentDiffuseEffect::IsDepthWriteEnabled() const
+{
+	return !ProjectSettings::GetInstance()->UseTransparency();
+}
+
+SoftwarePipeline TransparentDiffuseEffect::GetSoftwarePipeline(CullMode cullMode, VertexFormat vertexFormat) const
+{
+	return Rasterizer::GetSoftwarePipeline<TransparentDiffuseEffect>(cullMode, vertexFormat, GetBlendMode(), IsDepthWriteEnabled());
 }
\ No newline at end of file
@@ -4,7 +4,10 @@
 class TransparentDiffuseEffect final : public Effect
 {
 public:
-	explicit TransparentDiffuseEffect(ID3D11Device* pDevice, const std::wstring& shaderPath, const Texture* pDiffuse);
+	static constexpr VaryingMask VARYINGS{ GetVaryingFlag(Varying::UV) };
+	static constexpr bool ALPHA_CULLING{ true };
+
+	explicit TransparentDiffuseEffect(ID3D11Device* pDevice, const std::wstring& shaderPath, TextureHandle diffuseMap);
 
 	TransparentDiffuseEffect(const TransparentDiffuseEffect& other) = delete;
 	TransparentDiffuseEffect(TransparentDiffuseEffect&& other) noexcept = delete;
@@ -16,8 +19,13 @@ public:
 	virtual void ClearGPUResources() override;
 
 	virtual Elite::RGBColor PixelShading(const Vertex_Output& pixelInfo) const override;
+	virtual void PixelShadingBlock(const FragmentBlock& fragments, uint32_t outColors[FRAGMENT_BLOCK_SIZE]) const override;
+	bool IsBlockTransparent(const FragmentBlock& fragments) const;
 	virtual ID3D11BlendState* GetBlendState() const override;
 	virtual ID3D11DepthStencilState* GetDepthState() const override;
+	virtual BlendMode GetBlendMode() const override;
+	virtual bool IsDepthWriteEnabled() const override;
+	virtual SoftwarePipeline GetSoftwarePipeline(CullMode cullMode, VertexFormat vertexFormat) const override;
 
 private:
 	ID3D11BlendState* m_pDXNoBlendingState;
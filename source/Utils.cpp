@@ -1,72 +1,74 @@
 #include "pch.h"
 #include "Utils.h"
 #include <fstream>
+#include <charconv>
+#include <cstring>
+#include <future>
 #include "Enum.h"
 #include "Texture.h"
+#include "MappedFile.h"
+#include "ThreadPool.h"
 
-#pragma region Rasterizer
+#pragma region Utils
 
 /// <summary>
-/// Vertex Transofmration
+/// Hash bytes with 64 bit FNV-1a
 /// </summary>
-/// <param name="originalVertices">triangle vertices in model space</param>
-/// <param name="transformedVertices">output triangle vertices in raster space</param>
-/// <param name="worldViewProjectionMatrix">world view projection matrix</param>
-/// <param name="worldMatrix">Triangle world matrix</param>
-/// <param name="cameraPos">Camera position</param>
-/// <param name="width">window width</param>
-/// <param name="height">widnow height</param>
-/// <returns>Return true if triangle wasn't clipped out, false otherwise.</returns>
-bool Rasterizer::ConvertVerticesWorldToScreenSpace(const Vertex_Input originalVertices[TRI_VERTEX_COUNT], Vertex_Output transformedVertices[TRI_VERTEX_COUNT], const Elite::FMatrix4& worldViewProjectionMatrix, const Elite::FMatrix4& worldMatrix, const Elite::FPoint3& cameraPos, uint32_t width, uint32_t height)
+/// <param name="pData">Bytes to hash</param>
+/// <param name="byteSize">Byte count</param>
+/// <param name="hash">Hash the bytes are folded into, chains several buffers in one hash</param>
+/// <returns>Updated hash</returns>
+uint64_t Utils::Hash(const void* pData, size_t byteSize, uint64_t hash)
 {
-	for (int idx{}; idx < TRI_VERTEX_COUNT; ++idx)
+	const uint8_t* pBytes{ static_cast<const uint8_t*>(pData) };
+	for (size_t byteIdx{}; byteIdx < byteSize; ++byteIdx)
+		hash = (hash ^ pBytes[byteIdx]) * 0x100000001B3ull;
+	return hash;
+}
+
+/// <summary>
+/// Fold the content of a file into a hash
+/// </summary>
+/// <param name="filePath">File to hash</param>
+/// <param name="hash">Hash the file content is folded into</param>
+/// <returns>False when the file can't be read</returns>
+bool Utils::HashFile(const std::string& filePath, uint64_t& hash)
+{
+	std::ifstream file{ filePath, std::ios::binary };
+	if (!file)
+		return false;
+
+	std::vector<char> buffer(1 << 16);
+	while (file)
 	{
-		//To View Space
-		Elite::FPoint4 tPosition{ worldViewProjectionMatrix * Elite::FPoint4(originalVertices[idx].position) };
-
-		//Projection
-		tPosition.x /= tPosition.w;
-		tPosition.y /= tPosition.w;
-		tPosition.z /= tPosition.w;
-		tPosition.w = 1 / tPosition.w;
-
-		if (tPosition.x < -1.f || tPosition.x > 1.f
-			|| tPosition.y < -1.f || tPosition.y > 1.f
-			|| tPosition.z < 0.f || tPosition.z > 1.f)
-			return false;
-
-		//To ScreanSpace
-		tPosition.x = (tPosition.x + 1.f) / 2.f * width;
-		tPosition.y = (1 - tPosition.y) / 2.f * height;
-
-		transformedVertices[idx].position = tPosition;
-		transformedVertices[idx].uv = originalVertices[idx].uv;
-		transformedVertices[idx].normal = Elite::FVector3(worldMatrix * Elite::FVector4(originalVertices[idx].normal));
-		transformedVertices[idx].tangent = Elite::FVector3(worldMatrix * Elite::FVector4(originalVertices[idx].tangent));
-		transformedVertices[idx].viewVector = cameraPos - Elite::FPoint3(worldMatrix * Elite::FPoint4(originalVertices[idx].position));
+		file.read(buffer.data(), std::streamsize(buffer.size()));
+		hash = Hash(buffer.data(), size_t(file.gcount()), hash);
 	}
-
-	return true;
+	return file.eof();
 }
 
+#pragma endregion
+
+#pragma region Rasterizer
+
 /// <summary>
 /// Get Axis Aligned bounding box for the current triangle
 /// </summary>
-/// <param name="vertices">Triangle vertices</param>
+/// <param name="positions">Triangle vertices positions in raster space</param>
 /// <param name="width">Window width</param>
 /// <param name="height">Window window height</param>
 /// <returns>Bounding box data</returns>
-Aabb2D Rasterizer::GetAabb2D(const Vertex_Output vertices[TRI_VERTEX_COUNT], uint32_t width, uint32_t height)
+Aabb2D Rasterizer::GetAabb2D(const Elite::FPoint4* const positions[TRI_VERTEX_COUNT], uint32_t width, uint32_t height)
 {
 	int bot{ INT_MAX }, left{ INT_MAX }, top{ -INT_MAX }, right{ -INT_MAX };
 
 	for (int idx{}; idx < TRI_VERTEX_COUNT; ++idx)
 	{
-		auto vertex{ vertices[idx] };
-		left = int(vertex.position.x) < left ? int(vertex.position.x) : left;
-		right = int(vertex.position.x + 1) > right ? int(vertex.position.x + 1) : right;
-		bot = int(vertex.position.y) < bot ? int(vertex.position.y) : bot;
-		top = int(vertex.position.y + 1) > top ? int(vertex.position.y + 1) : top;
+		const Elite::FPoint4& position{ *positions[idx] };
+		left = int(position.x) < left ? int(position.x) : left;
+		right = int(position.x + 1) > right ? int(position.x + 1) : right;
+		bot = int(position.y) < bot ? int(position.y) : bot;
+		top = int(position.y + 1) > top ? int(position.y + 1) : top;
 	}
 
 	left = std::clamp(left, 0, int(width));
@@ -77,73 +79,15 @@ Aabb2D Rasterizer::GetAabb2D(const Vertex_Output vertices[TRI_VERTEX_COUNT], uin
 	return Aabb2D{ uint32_t(bot), uint32_t(left), uint32_t(top), uint32_t(right) };
 }
 
-/// <summary>
-/// Rasterizer Inside outside test
-/// </summary>
-/// <param name="vertices">Triangle vertices</param>
-/// <param name="pixel">Pixel to test</param>
-/// <param name="culling">Chosen cullmode</param>
-/// <param name="w0">out weight of vertex 0</param>
-/// <param name="w1">out weight of vertex 1</param>
-/// <param name="w2"out weight of vertex 1></param>
-/// <returns>Return wether or not the pixel is inside the triangle</returns>
-bool Rasterizer::IsPixelInTriangle(const Vertex_Output vertices[TRI_VERTEX_COUNT], const Elite::FPoint2& pixel, CullMode culling, float& w0, float& w1, float& w2)
-{
-	const Vertex_Output& v0{ vertices[0] };
-	const Vertex_Output& v1{ vertices[1] };
-	const Vertex_Output& v2{ vertices[2] };
-
-	Elite::FVector2 edge_v1v2{ v2.position - v1.position };
-	Elite::FVector2 edge_v2v0{ v0.position - v2.position };
-	float tempW0, tempW1, invTriArea;
-
-	tempW0 = Cross(pixel - Elite::FPoint2(v1.position), edge_v1v2);
-	tempW1 = Cross(pixel - Elite::FPoint2(v2.position), edge_v2v0);
-
-	//Change tests based on culling mode
-	switch (culling)
-	{
-	case CullMode::NONE:
-		if (abs(tempW0) < FLT_EPSILON || abs(tempW1) < FLT_EPSILON)
-			return false;
-		break;
-	case CullMode::BACKFACE:
-		if (tempW0 < FLT_EPSILON || tempW1 < FLT_EPSILON)
-			return false;
-		break;
-	case CullMode::FRONTFACE:
-		if (tempW0 > -FLT_EPSILON || tempW1 > -FLT_EPSILON)
-			return false;
-		break;
-	}
-
-	invTriArea = 1 / Cross(-edge_v1v2, edge_v2v0);
-
-	tempW0 = tempW0 * invTriArea;
-	if (tempW0 < 0.f || tempW0 > 1.f)
-		return false;
-
-	tempW1 = tempW1 * invTriArea;
-	if (tempW1 < 0.f || tempW0 + tempW1 > 1.f)
-		return false;
-
-	w0 = tempW0;
-	w1 = tempW1;
-	w2 = 1 - (w0 + w1);
-
-	return true;
-}
-
 /// <summary>
 /// Assemble triangle based on topology and start index
 /// </summary>
 /// <param name="topology">Topology used to create Index buffer</param>
-/// <param name="vertices">Vertex buffer</param>
 /// <param name="indexes">Index Buffer</param>
 /// <param name="currentIdx">Index of vertex 0 for the current triangle</param>
-/// <param name="outTriangle">output trinangle vertices</param>
+/// <param name="outTriangle">output triangle vertex indexes</param>
 /// <returns>Returns wether or not a valid tirangle was contructed</returns>
-bool Rasterizer::CreateTriangle(PrimitiveTopology topology, const std::vector<Vertex_Input>& vertices, const std::vector<uint32_t>& indexes, size_t currentIdx, Vertex_Input outTriangle[TRI_VERTEX_COUNT])
+bool Rasterizer::CreateTriangle(PrimitiveTopology topology, const Utils::ArrayView<uint32_t>& indexes, size_t currentIdx, uint32_t outTriangle[TRI_VERTEX_COUNT])
 {
 	bool isValidTri{ true };
 	uint32_t idx1{ indexes[currentIdx] };
@@ -153,24 +97,24 @@ bool Rasterizer::CreateTriangle(PrimitiveTopology topology, const std::vector<Ve
 	switch (topology)
 	{
 	case PrimitiveTopology::TRIANGLELIST:
-		outTriangle[0] = vertices[idx1];
-		outTriangle[1] = vertices[idx2];
-		outTriangle[2] = vertices[idx3];
+		outTriangle[0] = idx1;
+		outTriangle[1] = idx2;
+		outTriangle[2] = idx3;
 		break;
 	case PrimitiveTopology::TRIANGLESTRIP:
 		if (idx1 != idx2 && idx2 != idx3 && idx3 != idx1)
 		{
 			if ((currentIdx & 1) == 0)
 			{
-				outTriangle[0] = vertices[idx1];
-				outTriangle[1] = vertices[idx2];
-				outTriangle[2] = vertices[idx3];
+				outTriangle[0] = idx1;
+				outTriangle[1] = idx2;
+				outTriangle[2] = idx3;
 			}
 			else
 			{
-				outTriangle[0] = vertices[idx1];
-				outTriangle[1] = vertices[idx3];
-				outTriangle[2] = vertices[idx2];
+				outTriangle[0] = idx1;
+				outTriangle[1] = idx3;
+				outTriangle[2] = idx2;
 			}
 		}
 		else
@@ -181,163 +125,320 @@ bool Rasterizer::CreateTriangle(PrimitiveTopology topology, const std::vector<Ve
 	return isValidTri;
 }
 
-/// <summary>
-/// Interpolate pixel attributes
-/// </summary>
-/// <param name="pixePos">Current pixel</param>
-/// <param name="screenVertices">Rasterized triangle vertices</param>
-/// <param name="zInterpolated">Interpolated depth value</param>
-/// <param name="w0">Vertex 0 weight</param>
-/// <param name="w1">Vertex 1 weight</param>
-/// <param name="w2">Vertex 2 weight</param>
-/// <returns>Interpolated pixel information</returns>
-Vertex_Output Rasterizer::GetInterpolatedPixelInfo(const Elite::FPoint2& pixePos, const Vertex_Output screenVertices[TRI_VERTEX_COUNT], float zInterpolated, float w0, float w1, float w2)
-{
-	Vertex_Output out{};
-
-	const Vertex_Output& screenV0{ screenVertices[0] };
-	const Vertex_Output& screenV1{ screenVertices[1] };
-	const Vertex_Output& screenV2{ screenVertices[2] };
-	//vertices W components already stored as 1 / w
-	float interpolatedW0{ screenV0.position.w * w0 };
-	float interpolatedW1{ screenV1.position.w * w1 };
-	float interpolatedW2{ screenV2.position.w * w2 };
-
-	float w = 1 / (interpolatedW0 + interpolatedW1 + interpolatedW2);
-
-	out.position = Elite::FPoint4{ pixePos, Elite::Clamp(Elite::Remap(zInterpolated, 0.975f, 1.f), 0.f, 1.f), w };
-	out.uv = (screenV0.uv * interpolatedW0 + screenV1.uv * interpolatedW1 + screenV2.uv * interpolatedW2) * w;
-	out.normal = (screenV0.normal * interpolatedW0 + screenV1.normal * interpolatedW1 + screenV2.normal * interpolatedW2) * w;
-	Elite::Normalize(out.normal);
-	out.tangent = (screenV0.tangent * interpolatedW0 + screenV1.tangent * interpolatedW1 + screenV2.tangent * interpolatedW2) * w;
-	Elite::Normalize(out.tangent);
-	out.viewVector = (screenV0.viewVector * interpolatedW0 + screenV1.viewVector * interpolatedW1 + screenV2.viewVector * interpolatedW2) * w;
-	Elite::Normalize(out.viewVector);
-
-	return out;
-}
-
 #pragma endregion
 
 
 #pragma region OBJReader
 
-/// <summary>
-/// Load data from Obj file
-/// </summary>
-/// <param name="objPath">Path to Obj</param>
-/// <param name="vertexBuffer">output vertexBuffer</param>
-/// <param name="indexBuffer">output indexBuffer</param>
-void ObjReader::LoadModel(const std::string& objPath, std::vector<Vertex_Input>& vertexBuffer, std::vector<uint32_t>& indexBuffer)
+namespace
 {
-	std::ifstream objStream{ objPath, std::ios::in | std::ios::ate };
+	//Face corner as parsed, 0-based indices and -1 for a missing attribute.
+	//Negative OBJ indices are resolved against their own chunk and flagged, the chunk offset is added when merging
+	struct ObjCorner
+	{
+		int position;
+		int uv;
+		int normal;
+		uint8_t relativeMask;
+	};
+
+	const uint8_t RELATIVE_POSITION{ 1 << 0 };
+	const uint8_t RELATIVE_UV{ 1 << 1 };
+	const uint8_t RELATIVE_NORMAL{ 1 << 2 };
+
+	//Attributes and triangulated faces of one newline aligned part of the file
+	struct ObjChunk
+	{
+		std::vector<Elite::FPoint3> positions;
+		std::vector<Elite::FVector2> uvs;
+		std::vector<Elite::FVector3> normals;
+		std::vector<ObjCorner> corners;
+	};
 
-	if (!objStream.is_open())
-		std::cout << "Error: Could not open obj file \"" << objPath << "\".";
+	//Files are only split in chunks at least this big, smaller files are parsed on the calling thread
+	const size_t OBJ_MIN_CHUNK_SIZE{ 1 << 20 };
 
-	std::string line{};
-	std::vector<Elite::FPoint3> tmpVertices;
-	std::vector<Elite::FVector3> tmpVNormals;
-	std::vector<Elite::FVector2> tmpUVs;
-	std::vector<std::string> tmpFaces;
+	const char* SkipSpaces(const char* pText, const char* pEnd)
+	{
+		while (pText < pEnd && (*pText == ' ' || *pText == '\t'))
+			++pText;
+		return pText;
+	}
+
+	bool IsKeyword(const char* pText, const char* pEnd, const char* keyword)
+	{
+		const size_t length{ std::strlen(keyword) };
+		return size_t(pEnd - pText) > length && std::memcmp(pText, keyword, length) == 0 && (pText[length] == ' ' || pText[length] == '\t');
+	}
+
+	/// <summary>
+	/// Parse space separated floats, values that can't be parsed are left untouched
+	/// </summary>
+	void ParseFloats(const char* pText, const char* pEnd, float* pValues, int count)
+	{
+		for (int valueIdx{}; valueIdx < count; ++valueIdx)
+		{
+			pText = SkipSpaces(pText, pEnd);
+			const std::from_chars_result result{ std::from_chars(pText, pEnd, pValues[valueIdx]) };
+			if (result.ec != std::errc{})
+				return;
+			pText = result.ptr;
+		}
+	}
 
-	//Parse all data in temporary arrays
-	objStream.seekg(0, std::ios::beg);
-	while (!objStream.eof())
+	/// <summary>
+	/// Parse one index of a face corner, 1-based or negative counting back from the last element defined
+	/// </summary>
+	/// <param name="pText">Index text</param>
+	/// <param name="pEnd">End of the line</param>
+	/// <param name="elementCount">Elements of this kind already defined in the chunk</param>
+	/// <param name="index">Output 0-based index, -1 when missing</param>
+	/// <param name="relativeMask">Corner flags, relativeFlag is set for negative indices</param>
+	/// <param name="relativeFlag">Flag of this kind of index</param>
+	/// <returns>First character after the index</returns>
+	const char* ParseIndex(const char* pText, const char* pEnd, size_t elementCount, int& index, uint8_t& relativeMask, uint8_t relativeFlag)
 	{
-		std::getline(objStream, line, '\n');
+		int value{};
+		const std::from_chars_result result{ std::from_chars(pText, pEnd, value) };
+		if (result.ec != std::errc{} || value == 0)
+			return result.ptr;
 
-		if (line._Starts_with("f "))
+		if (value > 0)
 		{
-			tmpFaces.push_back(line);
+			index = value - 1;
 		}
 		else
 		{
-			float f0, f1, f2;
-			sscanf_s(line.c_str(), "%*s %f %f %f", &f0, &f1, &f2);
+			index = int(elementCount) + value;
+			relativeMask |= relativeFlag;
+		}
+		return result.ptr;
+	}
 
-			if (line._Starts_with("v "))
+	/// <summary>
+	/// Parse a face in any of the v, v/t, v//n and v/t/n forms, polygons are triangulated as a fan around their first corner
+	/// </summary>
+	void ParseFace(const char* pText, const char* pEnd, ObjChunk& chunk)
+	{
+		ObjCorner first{}, previous{};
+		int cornerCount{};
+		while ((pText = SkipSpaces(pText, pEnd)) < pEnd)
+		{
+			ObjCorner corner{ -1, -1, -1, 0 };
+			pText = ParseIndex(pText, pEnd, chunk.positions.size(), corner.position, corner.relativeMask, RELATIVE_POSITION);
+			if (pText < pEnd && *pText == '/')
 			{
-				tmpVertices.push_back({ f0, f1, f2 });
+				if (++pText < pEnd && *pText != '/')
+					pText = ParseIndex(pText, pEnd, chunk.uvs.size(), corner.uv, corner.relativeMask, RELATIVE_UV);
+				if (pText < pEnd && *pText == '/')
+					pText = ParseIndex(pText + 1, pEnd, chunk.normals.size(), corner.normal, corner.relativeMask, RELATIVE_NORMAL);
 			}
-			else if (line._Starts_with("vn "))
+
+			//Skip whatever is left of a malformed corner
+			while (pText < pEnd && *pText != ' ' && *pText != '\t')
+				++pText;
+
+			if (corner.position == -1 && (corner.relativeMask & RELATIVE_POSITION) == 0)
+				continue;
+
+			if (cornerCount == 0)
 			{
-				tmpVNormals.push_back({ f0, f1, f2 });
+				first = corner;
 			}
-			else if (line._Starts_with("vt "))
+			else if (cornerCount >= 2)
 			{
-				tmpUVs.push_back({ f0, 1 - f1 });
+				chunk.corners.push_back(first);
+				chunk.corners.push_back(previous);
+				chunk.corners.push_back(corner);
 			}
+
+			previous = corner;
+			++cornerCount;
 		}
 	}
 
-	indexBuffer.reserve(tmpFaces.size());
-	vertexBuffer.reserve(tmpFaces.size());
-	int vIdx, uVIdx, nVIdx;
+	/// <summary>
+	/// Parse the v, vt, vn and f lines of a part of the file, other lines are ignored
+	/// </summary>
+	void ParseChunk(const char* pBegin, const char* pEnd, ObjChunk& chunk)
+	{
+		const char* pLine{ pBegin };
+		while (pLine < pEnd)
+		{
+			const char* pLineEnd{ static_cast<const char*>(std::memchr(pLine, '\n', size_t(pEnd - pLine))) };
+			if (!pLineEnd)
+				pLineEnd = pEnd;
+			const char* pNextLine{ pLineEnd < pEnd ? pLineEnd + 1 : pEnd };
+			if (pLineEnd > pLine && pLineEnd[-1] == '\r')
+				--pLineEnd;
+
+			//Elements are always added, even when malformed, so the indices of the following ones stay right
+			const char* pText{ SkipSpaces(pLine, pLineEnd) };
+			if (IsKeyword(pText, pLineEnd, "v"))
+			{
+				float values[3]{};
+				ParseFloats(pText + 1, pLineEnd, values, 3);
+				chunk.positions.push_back({ values[0], values[1], values[2] });
+			}
+			else if (IsKeyword(pText, pLineEnd, "vt"))
+			{
+				float values[2]{};
+				ParseFloats(pText + 2, pLineEnd, values, 2);
+				chunk.uvs.push_back({ values[0], 1 - values[1] });
+			}
+			else if (IsKeyword(pText, pLineEnd, "vn"))
+			{
+				float values[3]{};
+				ParseFloats(pText + 2, pLineEnd, values, 3);
+				chunk.normals.push_back({ values[0], values[1], values[2] });
+			}
+			else if (IsKeyword(pText, pLineEnd, "f"))
+			{
+				ParseFace(pText + 1, pLineEnd, chunk);
+			}
+
+			pLine = pNextLine;
+		}
+	}
+}
+
+/// <summary>
+/// Load data from Obj file. The file is mapped and split in newline aligned chunks parsed in parallel on the ThreadPool
+/// </summary>
+/// <param name="objPath">Path to Obj</param>
+/// <param name="vertexBuffer">output vertexBuffer</param>
+/// <param name="indexBuffer">output indexBuffer</param>
+void ObjReader::LoadModel(const std::string& objPath, std::vector<Vertex_Input>& vertexBuffer, std::vector<uint32_t>& indexBuffer)
+{
+	MappedFile objFile{};
+	if (!objFile.Open(objPath))
+	{
+		std::cout << "Error: Could not open obj file \"" << objPath << "\".";
+		return;
+	}
+
+	const char* const pText{ reinterpret_cast<const char*>(objFile.GetData()) };
+	const size_t textSize{ objFile.GetSize() };
+	const size_t chunkCount{ std::clamp(textSize / OBJ_MIN_CHUNK_SIZE, size_t(1), ThreadPool::GetInstance()->GetWorkerCount() + 1) };
+
+	//Chunks end right after a newline
+	std::vector<const char*> chunkBounds(chunkCount + 1, pText + textSize);
+	chunkBounds[0] = pText;
+	for (size_t chunkIdx{ 1 }; chunkIdx < chunkCount; ++chunkIdx)
+	{
+		const char* pSplit{ std::max(pText + textSize * chunkIdx / chunkCount, chunkBounds[chunkIdx - 1]) };
+		const char* pNewLine{ static_cast<const char*>(std::memchr(pSplit, '\n', size_t(pText + textSize - pSplit))) };
+		chunkBounds[chunkIdx] = pNewLine ? pNewLine + 1 : pText + textSize;
+	}
+
+	//The calling thread parses the first chunk itself
+	std::vector<ObjChunk> chunks(chunkCount);
+	std::vector<std::future<void>> chunkTasks;
+	for (size_t chunkIdx{ 1 }; chunkIdx < chunkCount; ++chunkIdx)
+		chunkTasks.push_back(ThreadPool::GetInstance()->Enqueue([&chunkBounds, &chunks, chunkIdx]() { ParseChunk(chunkBounds[chunkIdx], chunkBounds[chunkIdx + 1], chunks[chunkIdx]); }));
+	ParseChunk(chunkBounds[0], chunkBounds[1], chunks[0]);
+	for (std::future<void>& chunkTask : chunkTasks)
+		chunkTask.get();
+
+	//Merge the chunks, relative indices get the offset of their chunk
+	std::vector<Elite::FPoint3> positions;
+	std::vector<Elite::FVector3> normals;
+	std::vector<Elite::FVector2> uvs;
+	std::vector<ObjCorner> corners;
+	for (const ObjChunk& chunk : chunks)
+	{
+		const int positionOffset{ int(positions.size()) }, uvOffset{ int(uvs.size()) }, normalOffset{ int(normals.size()) };
+		positions.insert(positions.end(), chunk.positions.cbegin(), chunk.positions.cend());
+		uvs.insert(uvs.end(), chunk.uvs.cbegin(), chunk.uvs.cend());
+		normals.insert(normals.end(), chunk.normals.cbegin(), chunk.normals.cend());
+
+		for (ObjCorner corner : chunk.corners)
+		{
+			corner.position += (corner.relativeMask & RELATIVE_POSITION) ? positionOffset : 0;
+			corner.uv += (corner.relativeMask & RELATIVE_UV) ? uvOffset : 0;
+			corner.normal += (corner.relativeMask & RELATIVE_NORMAL) ? normalOffset : 0;
+			corners.push_back(corner);
+		}
+	}
+
+	indexBuffer.reserve(corners.size());
+	vertexBuffer.reserve(corners.size() / 3);
+
+	//Corners already turned into a vertex, looked up in constant time so loading stays linear in the face count
+	std::unordered_map<VertexKey, uint32_t, VertexKeyHash> vertexIndices;
+	vertexIndices.reserve(corners.size() / 2);
 
 	//construct vertex and index buffer based on faces information
-	for (const std::string& faceStr : tmpFaces)
+	auto isValid = [](int index, size_t count) { return index >= 0 && size_t(index) < count; };
+	size_t invalidFaceCount{};
+	for (size_t cornerIdx{}; cornerIdx + 2 < corners.size(); cornerIdx += 3)
 	{
-		int iv0, iv1, iv2, iuv0, iuv1, iuv2, in0, in1, in2;
-		sscanf_s(faceStr.c_str(), "f %d/%d/%d %d/%d/%d %d/%d/%d", &iv0, &iuv0, &in0, &iv1, &iuv1, &in1, &iv2, &iuv2, &in2);
-
-		vIdx = iv0 - 1;
-		const Elite::FPoint3& p0{ tmpVertices[vIdx] };
-		vIdx = iv1 - 1;
-		const Elite::FPoint3& p1{ tmpVertices[vIdx] };
-		vIdx = iv2 - 1;
-		const Elite::FPoint3& p2{ tmpVertices[vIdx] };
-
-		uVIdx = iuv0 - 1;
-		const Elite::FVector2& uv0{ tmpUVs[uVIdx] };
-		uVIdx = iuv1 - 1;
-		const Elite::FVector2& uv1{ tmpUVs[uVIdx] };
-		uVIdx = iuv2 - 1;
-		const Elite::FVector2& uv2{ tmpUVs[uVIdx] };
-
-		nVIdx = in0 - 1;
-		const Elite::FVector3& n0{ tmpVNormals[nVIdx] };
-		nVIdx = in1 - 1;
-		const Elite::FVector3& n1{ tmpVNormals[nVIdx] };
-		nVIdx = in2 - 1;
-		const Elite::FVector3& n2{ tmpVNormals[nVIdx] };
+		const ObjCorner& c0{ corners[cornerIdx] };
+		const ObjCorner& c1{ corners[cornerIdx + 1] };
+		const ObjCorner& c2{ corners[cornerIdx + 2] };
+		if (!isValid(c0.position, positions.size()) || !isValid(c1.position, positions.size()) || !isValid(c2.position, positions.size()))
+		{
+			++invalidFaceCount;
+			continue;
+		}
+
+		const Elite::FPoint3& p0{ positions[c0.position] };
+		const Elite::FPoint3& p1{ positions[c1.position] };
+		const Elite::FPoint3& p2{ positions[c2.position] };
+		const Elite::FVector3 edge0{ p1 - p0 };
+		const Elite::FVector3 edge1{ p2 - p0 };
+
+		//Missing uvs default to 0, missing normals to the face normal
+		auto getUV = [&](const ObjCorner& corner) { return isValid(corner.uv, uvs.size()) ? uvs[corner.uv] : Elite::FVector2{}; };
+		const Elite::FVector3 faceNormal{ Elite::GetNormalized(Elite::Cross(edge0, edge1)) };
+		auto getNormal = [&](const ObjCorner& corner) { return isValid(corner.normal, normals.size()) ? normals[corner.normal] : faceNormal; };
+
+		const Elite::FVector2 uv0{ getUV(c0) }, uv1{ getUV(c1) }, uv2{ getUV(c2) };
+		const Elite::FVector3 n0{ getNormal(c0) }, n1{ getNormal(c1) }, n2{ getNormal(c2) };
 
 		Vertex_Input v0{ p0, n0, Elite::FVector3{}, uv0 };
 		Vertex_Input v1{ p1, n1, Elite::FVector3{}, uv1 };
 		Vertex_Input v2{ p2, n2, Elite::FVector3{}, uv2 };
-		uint32_t idxV0{ GetVertexIdx(v0, vertexBuffer) };
-		uint32_t idxV1{ GetVertexIdx(v1, vertexBuffer) };
-		uint32_t idxV2{ GetVertexIdx(v2, vertexBuffer) };
+		//A corner without normal takes the normal of its face, so it is only shared within the face: negative keys never match a normal index
+		const int faceKey{ -1 - int(cornerIdx / 3) };
+		auto getKey = [&](const ObjCorner& corner) { return VertexKey{ corner.position, corner.uv, isValid(corner.normal, normals.size()) ? corner.normal : faceKey }; };
+		const VertexKey key0{ getKey(c0) };
+		const VertexKey key1{ getKey(c1) };
+		const VertexKey key2{ getKey(c2) };
+		uint32_t idxV0{ GetVertexIdx(key0, vertexIndices) };
+		uint32_t idxV1{ GetVertexIdx(key1, vertexIndices) };
+		uint32_t idxV2{ GetVertexIdx(key2, vertexIndices) };
 
 		if (idxV0 == -1 || idxV1 == -1 || idxV2 == -1)
 		{
-			//Calculate vertex tangent
+			//Calculate vertex tangent, along the first edge when the uvs don't give a direction
 			//https://stackoverflow.com/questions/5255806/how-to-calculate-tangent-and-binormal
-			const Elite::FVector3 edge0{ p1 - p0 };
-			const Elite::FVector3 edge1{ p2 - p0 };
 			const Elite::FVector2 diffX{ uv1.x - uv0.x, uv2.x - uv0.x };
 			const Elite::FVector2 diffY{ uv1.y - uv0.y, uv2.y - uv0.y };
-			float r = 1.f / Cross(diffX, diffY);
+			const float uvArea{ Cross(diffX, diffY) };
 
-			Elite::FVector3 tangent{ (edge0 * diffY.y - edge1 * diffY.x) * r };
+			const Elite::FVector3 tangent{ abs(uvArea) > FLT_EPSILON ? (edge0 * diffY.y - edge1 * diffY.x) * (1.f / uvArea) : edge0 };
 
 			if (idxV0 == -1)
 			{
 				v0.tangent = Elite::GetNormalized(Elite::Reject(tangent, n0));
 				idxV0 = int(vertexBuffer.size());
 				vertexBuffer.push_back(std::move(v0));
+				vertexIndices.emplace(key0, idxV0);
 			}
 			if (idxV1 == -1)
 			{
 				v1.tangent = Elite::GetNormalized(Elite::Reject(tangent, n1));
 				idxV1 = int(vertexBuffer.size());
 				vertexBuffer.push_back(std::move(v1));
+				vertexIndices.emplace(key1, idxV1);
 			}
 			if (idxV2 == -1)
 			{
 				v2.tangent = Elite::GetNormalized(Elite::Reject(tangent, n2));
 				idxV2 = int(vertexBuffer.size());
 				vertexBuffer.push_back(std::move(v2));
+				vertexIndices.emplace(key2, idxV2);
 			}
 		}
 
@@ -345,21 +446,21 @@ void ObjReader::LoadModel(const std::string& objPath, std::vector<Vertex_Input>&
 		indexBuffer.push_back(idxV1);
 		indexBuffer.push_back(idxV2);
 	}
+
+	if (invalidFaceCount > 0)
+		std::cout << "Warning: " << invalidFaceCount << " faces with invalid indices skipped in obj file \"" << objPath << "\"." << std::endl;
 }
 
 /// <summary>
 /// Look for existing vertex in buffer
 /// </summary>
-/// <param name="vertex">Vertex to check</param>
-/// <param name="vertexBuffer">Existing vertices</param>
+/// <param name="key">Index triple of the face corner</param>
+/// <param name="vertexIndices">Vertex index of every corner already in the buffer</param>
 /// <returns>Vertex index or -1 if not found</returns>
-uint32_t ObjReader::GetVertexIdx(const Vertex_Input& vertex, const std::vector<Vertex_Input>& vertexBuffer)
+uint32_t ObjReader::GetVertexIdx(const VertexKey& key, const std::unordered_map<VertexKey, uint32_t, VertexKeyHash>& vertexIndices)
 {
-	std::vector<Vertex_Input>::const_iterator cIt = std::find_if(vertexBuffer.cbegin(), vertexBuffer.cend(), [&vertex](const Vertex_Input& vBuffer) {
-		return vBuffer.position == vertex.position && vBuffer.uv == vertex.uv && vBuffer.normal == vertex.normal;
-		});
-
-	return cIt == vertexBuffer.cend() ? -1 : uint32_t(std::distance(vertexBuffer.cbegin(), cIt));
+	const auto cIt{ vertexIndices.find(key) };
+	return cIt == vertexIndices.cend() ? -1 : cIt->second;
 }
 
 #pragma endregion
@@ -3,6 +3,8 @@
 #include <iostream>
 #include <iomanip>
 #include <vector>
+#include <new>
+#include <unordered_map>
 #include "EMath.h"
 #include "Struct.h"
 #include "Enum.h"
@@ -67,22 +69,78 @@ namespace Utils
 			pObj = nullptr;
 		}
 	}
+
+	//Allocator for std containers with over-aligned storage, e.g. on cache lines
+	template<typename T, size_t ALIGNMENT>
+	struct AlignedAllocator
+	{
+		using value_type = T;
+
+		template<typename U>
+		struct rebind { using other = AlignedAllocator<U, ALIGNMENT>; };
+
+		AlignedAllocator() = default;
+		template<typename U>
+		AlignedAllocator(const AlignedAllocator<U, ALIGNMENT>&) noexcept {}
+
+		T* allocate(size_t count) { return static_cast<T*>(::operator new(count * sizeof(T), std::align_val_t{ ALIGNMENT })); }
+		void deallocate(T* pData, size_t) noexcept { ::operator delete(pData, std::align_val_t{ ALIGNMENT }); }
+
+		template<typename U>
+		bool operator==(const AlignedAllocator<U, ALIGNMENT>&) const noexcept { return true; }
+		template<typename U>
+		bool operator!=(const AlignedAllocator<U, ALIGNMENT>&) const noexcept { return false; }
+	};
+
+	//Non owning view over contiguous elements, from a std::vector or straight from a mapped file
+	template<typename T>
+	struct ArrayView
+	{
+		const T* pData;
+		size_t count;
+
+		const T* data() const { return pData; };
+		size_t size() const { return count; };
+		bool empty() const { return count == 0; };
+		const T* begin() const { return pData; };
+		const T* end() const { return pData + count; };
+		const T& operator[](size_t idx) const { return pData[idx]; };
+	};
+
+	//64 bit FNV-1a, used to tell if the source of a cached file changed
+	const uint64_t HASH_SEED{ 0xCBF29CE484222325ull };
+	uint64_t Hash(const void* pData, size_t byteSize, uint64_t hash = HASH_SEED);
+	bool HashFile(const std::string& filePath, uint64_t& hash);
 };
 
 namespace Rasterizer
 {
-	bool ConvertVerticesWorldToScreenSpace(const Vertex_Input originalVertices[TRI_VERTEX_COUNT], Vertex_Output transformedVertices[TRI_VERTEX_COUNT], const Elite::FMatrix4& worldViewProjectionMatrix, const Elite::FMatrix4& worldMatrix, const Elite::FPoint3& cameraPos, uint32_t width, uint32_t height);
-	Aabb2D GetAabb2D(const Vertex_Output vertices[TRI_VERTEX_COUNT], uint32_t width, uint32_t height);
-	bool IsPixelInTriangle(const Vertex_Output vertices[TRI_VERTEX_COUNT], const Elite::FPoint2& pixel, CullMode culling, float& w0, float& w1, float& w2);
-	bool CreateTriangle(PrimitiveTopology topology, const std::vector<Vertex_Input>& vertices, const std::vector<uint32_t>& indexes, size_t currentIdx, Vertex_Input outTriangle[TRI_VERTEX_COUNT]);
-
-	Vertex_Output GetInterpolatedPixelInfo(const Elite::FPoint2& pixePos, const Vertex_Output screenVertices[TRI_VERTEX_COUNT], float zInterpolated, float w0, float w1, float w2);
+	Aabb2D GetAabb2D(const Elite::FPoint4* const positions[TRI_VERTEX_COUNT], uint32_t width, uint32_t height);
+	bool CreateTriangle(PrimitiveTopology topology, const Utils::ArrayView<uint32_t>& indexes, size_t currentIdx, uint32_t outTriangle[TRI_VERTEX_COUNT]);
 }
 
 namespace ObjReader
 {
+	//Face corner, identified by its position/uv/normal index triple
+	struct VertexKey
+	{
+		int position;
+		int uv;
+		int normal;
+
+		bool operator==(const VertexKey& other) const { return position == other.position && uv == other.uv && normal == other.normal; };
+	};
+
+	struct VertexKeyHash
+	{
+		size_t operator()(const VertexKey& key) const
+		{
+			return size_t((uint64_t(uint32_t(key.position)) * 0x9E3779B97F4A7C15ull) ^ (uint64_t(uint32_t(key.uv)) * 0xC2B2AE3D27D4EB4Full) ^ (uint64_t(uint32_t(key.normal)) * 0x165667B19E3779F9ull));
+		};
+	};
+
 	void LoadModel(const std::string& objPath, std::vector<Vertex_Input>& vertexBuffer, std::vector<uint32_t>& indexBuffer);
 
-	uint32_t GetVertexIdx(const Vertex_Input& vertex, const std::vector<Vertex_Input>& vertexBuffer);
+	uint32_t GetVertexIdx(const VertexKey& key, const std::unordered_map<VertexKey, uint32_t, VertexKeyHash>& vertexIndices);
 }
 
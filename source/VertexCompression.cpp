@@ -0,0 +1,116 @@
+#include "pch.h"
+#include "VertexCompression.h"
+
+namespace
+{
+	int16_t EncodeSnorm(float value)
+	{
+		return int16_t(std::round(Elite::Clamp(value, -1.f, 1.f) * VertexCompression::SNORM_MAX));
+	}
+
+	void EncodeOctahedralSnorm(const Elite::FVector3& vector, int16_t encoded[2])
+	{
+		const Elite::FVector2 octahedral{ VertexCompression::EncodeOctahedral(vector) };
+		encoded[0] = EncodeSnorm(octahedral.x);
+		encoded[1] = EncodeSnorm(octahedral.y);
+	}
+}
+
+/// <summary>
+/// Octahedral encoding of a unit vector in [-1, 1]: projected on the octahedron, the lower half folded over the corners of the upper one
+/// </summary>
+Elite::FVector2 VertexCompression::EncodeOctahedral(const Elite::FVector3& vector)
+{
+	const float sum{ std::abs(vector.x) + std::abs(vector.y) + std::abs(vector.z) };
+	if (sum <= 0.f)
+		return {};
+
+	float x{ vector.x / sum };
+	float y{ vector.y / sum };
+	if (vector.z < 0.f)
+	{
+		const float foldedX{ (1.f - std::abs(y)) * (x >= 0.f ? 1.f : -1.f) };
+		y = (1.f - std::abs(x)) * (y >= 0.f ? 1.f : -1.f);
+		x = foldedX;
+	}
+
+	return { x, y };
+}
+
+/// <summary>
+/// Quantization spreading the 16 bit position steps over the bounds of a mesh
+/// </summary>
+VertexQuantization VertexCompression::GetQuantization(const Elite::FPoint3& boundsMin, const Elite::FPoint3& boundsMax)
+{
+	VertexQuantization quantization{};
+	quantization.positionOffset = boundsMin;
+	for (int axis{}; axis < 3; ++axis)
+		quantization.positionScale[axis] = (boundsMax[axis] - boundsMin[axis]) / POSITION_STEP_COUNT;
+
+	return quantization;
+}
+
+/// <summary>
+/// Quantize a vertex, the position has to lie within the bounds of the quantization
+/// </summary>
+Vertex_Compact VertexCompression::EncodeVertex(const Vertex_Input& vertex, const VertexQuantization& quantization)
+{
+	Vertex_Compact compact{};
+	for (int axis{}; axis < 3; ++axis)
+	{
+		const float scale{ quantization.positionScale[axis] };
+		const float steps{ scale > 0.f ? (vertex.position[axis] - quantization.positionOffset[axis]) / scale : 0.f };
+		compact.position[axis] = uint16_t(Elite::Clamp(std::round(steps), 0.f, POSITION_STEP_COUNT));
+	}
+
+	EncodeOctahedralSnorm(vertex.normal, compact.normal);
+	EncodeOctahedralSnorm(vertex.tangent, compact.tangent);
+	compact.uv[0] = EncodeHalf(vertex.uv.x);
+	compact.uv[1] = EncodeHalf(vertex.uv.y);
+	return compact;
+}
+
+Vertex_Input VertexCompression::DecodeVertex(const Vertex_Compact& vertex, const VertexQuantization& quantization)
+{
+	return Vertex_Input{ DecodePosition(vertex, quantization), DecodeOctahedral(vertex.normal), DecodeOctahedral(vertex.tangent), DecodeUV(vertex) };
+}
+
+/*! Float to IEEE half, rounded to nearest even, too large values become infinity */
+/*! Reference: https://gist.github.com/rygorous/2156668 */
+uint16_t VertexCompression::EncodeHalf(float value)
+{
+	const uint32_t infinityBits{ 255u << 23 };
+	const uint32_t halfMaxBits{ (127u + 16u) << 23 };
+	const uint32_t denormalMagicBits{ ((127u - 15u) + (23u - 10u) + 1u) << 23 };
+
+	uint32_t bits{};
+	std::memcpy(&bits, &value, sizeof(bits));
+	const uint32_t sign{ bits & 0x80000000u };
+	bits ^= sign;
+
+	uint32_t half{};
+	if (bits >= halfMaxBits)
+	{
+		//NaN stays a quiet NaN, everything else out of range is infinity
+		half = bits > infinityBits ? 0x7E00u : 0x7C00u;
+	}
+	else if (bits < (113u << 23))
+	{
+		//Denormal result, the float addition does the rounding
+		float magnitude{};
+		float denormalMagic{};
+		std::memcpy(&magnitude, &bits, sizeof(magnitude));
+		std::memcpy(&denormalMagic, &denormalMagicBits, sizeof(denormalMagic));
+		magnitude += denormalMagic;
+		std::memcpy(&bits, &magnitude, sizeof(bits));
+		half = bits - denormalMagicBits;
+	}
+	else
+	{
+		const uint32_t isMantissaOdd{ (bits >> 13) & 1u };
+		bits += ((15u - 127u) << 23) + 0xFFFu + isMantissaOdd;
+		half = bits >> 13;
+	}
+
+	return uint16_t(half | (sign >> 16));
+}
@@ -0,0 +1,80 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include "Struct.h"
+
+//Vertex_Input to Vertex_Compact codec. Encoding happens once at load, decoding in the vertex stage so it is kept inline
+namespace VertexCompression
+{
+	const float POSITION_STEP_COUNT{ 65535.f };
+	const float SNORM_MAX{ 32767.f };
+
+	VertexQuantization GetQuantization(const Elite::FPoint3& boundsMin, const Elite::FPoint3& boundsMax);
+	Vertex_Compact EncodeVertex(const Vertex_Input& vertex, const VertexQuantization& quantization);
+	Vertex_Input DecodeVertex(const Vertex_Compact& vertex, const VertexQuantization& quantization);
+	uint16_t EncodeHalf(float value);
+	Elite::FVector2 EncodeOctahedral(const Elite::FVector3& vector);
+
+	inline Elite::FPoint3 DecodePosition(const Vertex_Compact& vertex, const VertexQuantization& quantization)
+	{
+		return {
+			quantization.positionOffset.x + float(vertex.position[0]) * quantization.positionScale.x,
+			quantization.positionOffset.y + float(vertex.position[1]) * quantization.positionScale.y,
+			quantization.positionOffset.z + float(vertex.position[2]) * quantization.positionScale.z };
+	}
+
+	/// <summary>
+	/// Unit vector from its octahedral encoding: the octahedron is unfolded in a square, the lower half folded over the corners
+	/// </summary>
+	inline Elite::FVector3 DecodeOctahedral(const Elite::FVector2& octahedral)
+	{
+		Elite::FVector3 vector{ octahedral.x, octahedral.y, 0.f };
+		vector.z = 1.f - std::abs(vector.x) - std::abs(vector.y);
+		const float fold{ std::max(-vector.z, 0.f) };
+		vector.x += vector.x >= 0.f ? -fold : fold;
+		vector.y += vector.y >= 0.f ? -fold : fold;
+		return vector / sqrtf(vector.x * vector.x + vector.y * vector.y + vector.z * vector.z);
+	}
+
+	inline Elite::FVector3 DecodeOctahedral(const int16_t encoded[2])
+	{
+		return DecodeOctahedral(Elite::FVector2{ std::max(float(encoded[0]) / SNORM_MAX, -1.f), std::max(float(encoded[1]) / SNORM_MAX, -1.f) });
+	}
+
+	/*! IEEE half to float, denormals go through a float subtraction */
+	/*! Reference: https://gist.github.com/rygorous/2156668 */
+	inline float DecodeHalf(uint16_t half)
+	{
+		const uint32_t shiftedExponent{ 0x7C00u << 13 };
+		uint32_t bits{ uint32_t(half & 0x7FFF) << 13 };
+		const uint32_t exponent{ bits & shiftedExponent };
+		bits += (127 - 15) << 23;
+
+		float value{};
+		if (exponent == shiftedExponent)
+		{
+			//Inf and NaN keep their maximum exponent
+			bits += (128 - 16) << 23;
+			std::memcpy(&value, &bits, sizeof(value));
+		}
+		else if (exponent == 0)
+		{
+			bits += 1 << 23;
+			std::memcpy(&value, &bits, sizeof(value));
+			value -= 6.10351563e-05f;
+		}
+		else
+		{
+			std::memcpy(&value, &bits, sizeof(value));
+		}
+
+		return (half & 0x8000) ? -value : value;
+	}
+
+	inline Elite::FVector2 DecodeUV(const Vertex_Compact& vertex)
+	{
+		return { DecodeHalf(vertex.uv[0]), DecodeHalf(vertex.uv[1]) };
+	}
+}
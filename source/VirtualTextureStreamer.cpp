@@ -0,0 +1,176 @@
+#include "pch.h"
+#include "VirtualTextureStreamer.h"
+#include <fstream>
+#include "ThreadPool.h"
+
+VirtualTextureStreamer* VirtualTextureStreamer::m_Instance = nullptr;
+
+namespace
+{
+	Texture::BlockStorage ReadPage(const std::string& pageFilePath, size_t offset, size_t byteSize)
+	{
+		Texture::BlockStorage blocks(byteSize);
+		std::ifstream file{ pageFilePath, std::ios::binary };
+		file.seekg(std::streamoff(offset));
+		file.read(reinterpret_cast<char*>(blocks.data()), std::streamsize(byteSize));
+		if (!file)
+		{
+			std::cout << "Could not read page file: " << pageFilePath << std::endl;
+			blocks.clear();
+		}
+		return blocks;
+	}
+}
+
+VirtualTextureStreamer* VirtualTextureStreamer::GetInstance()
+{
+	return m_Instance ? m_Instance : (m_Instance = new VirtualTextureStreamer());
+}
+
+VirtualTextureStreamer::~VirtualTextureStreamer()
+{
+	for (PageLoad& pageLoad : m_PageLoads)
+		pageLoad.blocks.wait();
+
+	m_Instance = nullptr;
+}
+
+/// <summary>
+/// Start streaming a virtualized texture, can be called from the loading threads
+/// </summary>
+/// <param name="pTexture">Virtual texture, unregisters itself when destroyed</param>
+void VirtualTextureStreamer::Register(Texture* pTexture)
+{
+	std::lock_guard<std::mutex> lock{ m_Mutex };
+	m_Textures.push_back(pTexture);
+}
+
+void VirtualTextureStreamer::Unregister(Texture* pTexture)
+{
+	std::lock_guard<std::mutex> lock{ m_Mutex };
+	m_Textures.erase(std::remove(m_Textures.begin(), m_Textures.end(), pTexture), m_Textures.end());
+
+	for (size_t residentIdx{}; residentIdx < m_ResidentPages.size();)
+	{
+		if (m_ResidentPages[residentIdx].pTexture == pTexture)
+		{
+			m_ResidentSize -= m_ResidentPages[residentIdx].byteSize;
+			m_ResidentPages[residentIdx] = m_ResidentPages.back();
+			m_ResidentPages.pop_back();
+		}
+		else
+			++residentIdx;
+	}
+
+	//Loads in flight are dropped when they complete, they are waited for so the page file is closed when the texture deletes it
+	for (PageLoad& pageLoad : m_PageLoads)
+	{
+		if (pageLoad.pTexture == pTexture)
+		{
+			pageLoad.blocks.wait();
+			pageLoad.pTexture = nullptr;
+		}
+	}
+}
+
+/// <summary>
+/// Once per frame, after rendering: install the loaded pages, then turn the sampling feedback into page loads.
+/// Wanted pages load coarsest level first, room is made by evicting the least recently used pages not sampled this frame
+/// </summary>
+void VirtualTextureStreamer::Update()
+{
+	std::lock_guard<std::mutex> lock{ m_Mutex };
+	++m_Frame;
+	CommitPageLoads();
+
+	for (ResidentPage& residentPage : m_ResidentPages)
+	{
+		if (residentPage.pTexture->ConsumePageFeedback(residentPage.pageIdx))
+			residentPage.lastUseFrame = m_Frame;
+	}
+
+	struct PageRequest
+	{
+		Texture* pTexture;
+		size_t pageIdx;
+		uint32_t levelIdx;
+	};
+	std::vector<PageRequest> requests;
+	for (Texture* pTexture : m_Textures)
+	{
+		for (size_t pageIdx{}; pageIdx < pTexture->GetPageCount(); ++pageIdx)
+		{
+			//Resident pages had their feedback consumed above, what's left are pinned pages and missing ones
+			if (pTexture->ConsumePageFeedback(pageIdx) && !pTexture->IsPageResident(pageIdx) && !IsPageLoading(pTexture, pageIdx))
+				requests.push_back(PageRequest{ pTexture, pageIdx, pTexture->GetPageMipLevel(pageIdx) });
+		}
+	}
+
+	std::sort(requests.begin(), requests.end(), [](const PageRequest& request0, const PageRequest& request1) { return request0.levelIdx > request1.levelIdx; });
+
+	for (const PageRequest& request : requests)
+	{
+		const size_t byteSize{ request.pTexture->GetPageByteSize() };
+		if (m_PageLoads.size() >= MAX_PAGE_LOADS || !MakeRoom(byteSize))
+			break;
+
+		const std::string& pageFilePath{ request.pTexture->GetPageFilePath() };
+		const size_t offset{ request.pageIdx * byteSize };
+		m_PageLoads.push_back(PageLoad{ request.pTexture, request.pageIdx, byteSize,
+			ThreadPool::GetInstance()->Enqueue([pageFilePath, offset, byteSize]() { return ReadPage(pageFilePath, offset, byteSize); }) });
+		m_ResidentSize += byteSize;
+	}
+}
+
+void VirtualTextureStreamer::CommitPageLoads()
+{
+	for (size_t loadIdx{}; loadIdx < m_PageLoads.size();)
+	{
+		PageLoad& pageLoad{ m_PageLoads[loadIdx] };
+		if (pageLoad.blocks.wait_for(std::chrono::seconds{ 0 }) != std::future_status::ready)
+		{
+			++loadIdx;
+			continue;
+		}
+
+		Texture::BlockStorage blocks{ pageLoad.blocks.get() };
+		if (pageLoad.pTexture && !blocks.empty())
+		{
+			pageLoad.pTexture->SetPage(pageLoad.pageIdx, std::move(blocks));
+			m_ResidentPages.push_back(ResidentPage{ pageLoad.pTexture, pageLoad.pageIdx, pageLoad.byteSize, m_Frame });
+		}
+		else
+			m_ResidentSize -= pageLoad.byteSize;
+
+		m_PageLoads[loadIdx] = std::move(m_PageLoads.back());
+		m_PageLoads.pop_back();
+	}
+}
+
+/// <summary>
+/// Evict least recently used pages until byteSize fits in the budget
+/// </summary>
+/// <param name="byteSize">Size of the page to load</param>
+/// <returns>False when the budget is taken by pages sampled this frame</returns>
+bool VirtualTextureStreamer::MakeRoom(size_t byteSize)
+{
+	while (m_ResidentSize + byteSize > m_MemoryBudget)
+	{
+		auto leastRecentlyUsed{ std::min_element(m_ResidentPages.begin(), m_ResidentPages.end(),
+			[](const ResidentPage& page0, const ResidentPage& page1) { return page0.lastUseFrame < page1.lastUseFrame; }) };
+		if (leastRecentlyUsed == m_ResidentPages.end() || leastRecentlyUsed->lastUseFrame == m_Frame)
+			return false;
+
+		leastRecentlyUsed->pTexture->EvictPage(leastRecentlyUsed->pageIdx);
+		m_ResidentSize -= leastRecentlyUsed->byteSize;
+		*leastRecentlyUsed = m_ResidentPages.back();
+		m_ResidentPages.pop_back();
+	}
+
+	return true;
+}
+
+bool VirtualTextureStreamer::IsPageLoading(const Texture* pTexture, size_t pageIdx) const
+{
+	return std::any_of(m_PageLoads.begin(), m_PageLoads.end(), [pTexture, pageIdx](const PageLoad& pageLoad) { return pageLoad.pTexture == pTexture && pageLoad.pageIdx == pageIdx; });
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include <vector>
+#include <future>
+#include <mutex>
+#include "Texture.h"
+
+//Makes the pages sampled by virtual textures resident under a memory budget.
+//Pages are read from the page files on the ThreadPool, the page tables only change in Update, on the render thread
+class VirtualTextureStreamer
+{
+public:
+	static VirtualTextureStreamer* GetInstance();
+
+	VirtualTextureStreamer(const VirtualTextureStreamer&) = delete;
+	VirtualTextureStreamer(VirtualTextureStreamer&&) noexcept = delete;
+	VirtualTextureStreamer& operator=(const VirtualTextureStreamer&) = delete;
+	VirtualTextureStreamer& operator=(VirtualTextureStreamer&&) noexcept = delete;
+	~VirtualTextureStreamer();
+
+	void Register(Texture* pTexture);
+	void Unregister(Texture* pTexture);
+	void Update();
+
+	void SetMemoryBudget(size_t byteSize) { m_MemoryBudget = byteSize; };
+	size_t GetMemoryBudget() const { return m_MemoryBudget; };
+	size_t GetResidentSize() const { return m_ResidentSize; };
+
+private:
+	VirtualTextureStreamer()
+		: m_Mutex{}
+		, m_Textures{}
+		, m_ResidentPages{}
+		, m_PageLoads{}
+		, m_MemoryBudget{ DEFAULT_MEMORY_BUDGET }
+		, m_ResidentSize{}
+		, m_Frame{}
+	{};
+
+	static constexpr size_t DEFAULT_MEMORY_BUDGET{ 64 * 1024 * 1024 };
+	static constexpr size_t MAX_PAGE_LOADS{ 16 };
+
+	struct ResidentPage
+	{
+		Texture* pTexture;
+		size_t pageIdx;
+		size_t byteSize;
+		uint32_t lastUseFrame;
+	};
+
+	struct PageLoad
+	{
+		Texture* pTexture;
+		size_t pageIdx;
+		size_t byteSize;
+		std::future<Texture::BlockStorage> blocks;
+	};
+
+	static VirtualTextureStreamer* m_Instance;
+
+	std::mutex m_Mutex;
+	std::vector<Texture*> m_Textures;
+	std::vector<ResidentPage> m_ResidentPages;
+	std::vector<PageLoad> m_PageLoads;
+	size_t m_MemoryBudget;
+	//Resident pages and pages being loaded, pinned pages aren't counted
+	size_t m_ResidentSize;
+	uint32_t m_Frame;
+
+	void CommitPageLoads();
+	bool MakeRoom(size_t byteSize);
+	bool IsPageLoading(const Texture* pTexture, size_t pageIdx) const;
+};
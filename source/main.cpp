@@ -15,10 +15,14 @@
 #include "TransparentDiffuseEffect.h"
 #include "NormPhongEffect.h"
 #include "ResourceManager.h"
+#include "ThreadPool.h"
+#include "VirtualTextureStreamer.h"
 
 void ShutDown(SDL_Window* pWindow)
 {
 	delete ResourceManager::GetInstance();
+	delete VirtualTextureStreamer::GetInstance();
+	delete ThreadPool::GetInstance();
 	delete ProjectSettings::GetInstance();
 	SDL_DestroyWindow(pWindow);
 	SDL_Quit();
@@ -31,9 +35,7 @@ void UpdateRenderPipeline(std::unique_ptr<PerspectiveCamera>& pCamera, std::uniq
 
 int main(int argc, char* args[])
 {
-	//Unreferenced parameters
-	(void)argc;
-	(void)args;
+	ProjectSettings::GetInstance()->ParseCommandLine(argc, args);
 
 	//Create window + surfaces
 	SDL_Init(SDL_INIT_VIDEO);
@@ -94,6 +96,12 @@ int main(int argc, char* args[])
 				case SDL_SCANCODE_C:
 					ProjectSettings::GetInstance()->ToggleCullMode();
 					break;
+				case SDL_SCANCODE_L:
+					ProjectSettings::GetInstance()->ToggleLod();
+					break;
+				case SDL_SCANCODE_B:
+					ProjectSettings::GetInstance()->ToggleImpostors();
+					break;
 				case SDL_SCANCODE_P:
 					std::cout << "FPS: " << fps << std::endl;
 					break;
@@ -129,15 +137,17 @@ int main(int argc, char* args[])
 
 void LoadResources(const std::unique_ptr<Elite::Renderer>& pRenderer)
 {
+	//Textures decode on the ThreadPool while the scene loads, effects wait for them on first use.
+	//The vehicle maps are virtual, the software renderer only keeps the pages it samples resident
 	auto pDevice{ pRenderer->GetDevice() };
-	ResourceManager::GetInstance()->Emplace_Texture("T_Vehicle_Diffuse", "Resources/vehicle_diffuse.png");
-	ResourceManager::GetInstance()->Emplace_Texture("T_Vehicle_Normal", "Resources/vehicle_normal.png");
-	ResourceManager::GetInstance()->Emplace_Texture("T_Vehicle_Specular", "Resources/vehicle_specular.png");
-	ResourceManager::GetInstance()->Emplace_Texture("T_Vehicle_Gloss", "Resources/vehicle_gloss.png");
-	ResourceManager::GetInstance()->Emplace_Texture("T_Fire_Diffuse", "Resources/fireFX_diffuse.png");
+	VirtualTextureStreamer::GetInstance()->SetMemoryBudget(2 * 1024 * 1024);
+	ResourceManager::GetInstance()->Emplace_PackedTexture("T_Vehicle_DiffuseGloss", { TextureChannel{ "Resources/vehicle_diffuse.png", 0 }, TextureChannel{ "Resources/vehicle_diffuse.png", 1 }, TextureChannel{ "Resources/vehicle_diffuse.png", 2 }, TextureChannel{ "Resources/vehicle_gloss.png", 0 } }, TextureFormat::BC3, TextureResidency::VIRTUAL);
+	ResourceManager::GetInstance()->Emplace_Texture("T_Vehicle_Normal", "Resources/vehicle_normal.png", TextureFormat::BC5, TextureResidency::VIRTUAL);
+	ResourceManager::GetInstance()->Emplace_Texture("T_Vehicle_Specular", "Resources/vehicle_specular.png", TextureFormat::BC1, TextureResidency::VIRTUAL);
+	ResourceManager::GetInstance()->Emplace_Texture("T_Fire_Diffuse", "Resources/fireFX_diffuse.png", TextureFormat::BC3);
 
 
-	ResourceManager::GetInstance()->AddEffect("MAT_VehicleShader", new NormPhongEffect(L"Resources/Shaders/PosCol3D.fx", ResourceManager::GetInstance()->GetTexture("T_Vehicle_Diffuse"), ResourceManager::GetInstance()->GetTexture("T_Vehicle_Normal"), ResourceManager::GetInstance()->GetTexture("T_Vehicle_Specular"), ResourceManager::GetInstance()->GetTexture("T_Vehicle_Gloss")));
+	ResourceManager::GetInstance()->AddEffect("MAT_VehicleShader", new NormPhongEffect(L"Resources/Shaders/PosCol3D.fx", ResourceManager::GetInstance()->GetTexture("T_Vehicle_DiffuseGloss"), ResourceManager::GetInstance()->GetTexture("T_Vehicle_Normal"), ResourceManager::GetInstance()->GetTexture("T_Vehicle_Specular")));
 	ResourceManager::GetInstance()->AddEffect("MAT_CombustionShader", new TransparentDiffuseEffect(pDevice, L"Resources/Shaders/PartCov3D.fx", ResourceManager::GetInstance()->GetTexture("T_Fire_Diffuse")));
 }
 
@@ -148,6 +158,34 @@ void LoadScene(std::unique_ptr<SceneGraph>& pSceneGraph)
 
 	Mesh* pCombustion{ new Mesh("Resources/fireFX.obj", ResourceManager::GetInstance()->GetEffect("MAT_CombustionShader"), CullMode::NONE, Elite::MakeTranslation(Elite::FVector3(0.f, 0.f, 0.f))) };
 	pSceneGraph->AddMesh(pCombustion);
+
+	//More vehicles are instances of the same two meshes, each only adds a transform. The first one stays at the origin
+	const uint32_t vehicleGridSize{ ProjectSettings::GetInstance()->GetVehicleGridSize() };
+	const float vehicleSpacingX{ 80.f };
+	const float vehicleSpacingZ{ 50.f };
+	for (uint32_t vehicleIdx{}; vehicleIdx < vehicleGridSize * vehicleGridSize; ++vehicleIdx)
+	{
+		const Elite::FVector3 position{ float(vehicleIdx % vehicleGridSize) * vehicleSpacingX, 0.f, -float(vehicleIdx / vehicleGridSize) * vehicleSpacingZ };
+		for (Mesh* pMesh : { pVehicle, pCombustion })
+		{
+			if (vehicleIdx < pMesh->GetInstanceTransforms().size())
+				pMesh->SetInstanceTransform(vehicleIdx, Elite::MakeTranslation(position));
+			else
+				pMesh->AddInstance(Elite::MakeTranslation(position));
+		}
+	}
+
+	//Props are small vehicles behind the first one that never move, static meshes are merged once the whole scene is added
+	const uint32_t propGridSize{ ProjectSettings::GetInstance()->GetPropGridSize() };
+	const float propScale{ 0.25f };
+	const float propSpacing{ 15.f };
+	for (uint32_t propIdx{}; propIdx < propGridSize * propGridSize; ++propIdx)
+	{
+		const Elite::FVector3 position{ (float(propIdx % propGridSize) - float(propGridSize - 1) * 0.5f) * propSpacing, -6.f, -40.f - float(propIdx / propGridSize) * propSpacing };
+		const Elite::FMatrix4 transform{ Elite::MakeRotationY(float(propIdx) * 0.7f) * Elite::MakeScale(propScale, propScale, propScale), position };
+		pSceneGraph->AddStaticMesh(new Mesh("Resources/vehicle.obj", ResourceManager::GetInstance()->GetEffect("MAT_VehicleShader"), CullMode::BACKFACE, transform));
+	}
+	pSceneGraph->BuildStaticBatches();
 }
 
 void UpdateRenderPipeline(std::unique_ptr<PerspectiveCamera>& pCamera, std::unique_ptr<SceneGraph>& pSceneGraph, const std::unique_ptr<Elite::Renderer>& pRenderer)
@@ -189,9 +227,16 @@ void PrintControls()
 	std::cout << "	- T: Toggle transparency on/off (both software and hardware)" << std::endl;
 	std::cout << "	- C: Toggle culling MeshBased-NoCulling-BackCulling-FrontCulling (both software and hardware)" << std::endl;
 	std::cout << "	- R: Toggle between Software and Hardware rasterizer" << std::endl;
-	std::cout << "	- F: Toggle filtering mode (Hardware only)" << std::endl;
+	std::cout << "	- F: Toggle filtering mode Point-Linear-Anisotropic (software: Point-Bilinear-Trilinear)" << std::endl;
+	std::cout << "	- L: Toggle level of detail selection on/off (both software and hardware)" << std::endl;
+	std::cout << "	- B: Toggle impostors of distant meshes on/off (both software and hardware)" << std::endl;
 	std::cout << std::endl;
 
 	std::cout << "Info:" << std::endl;
 	std::cout << "	- P: show FPS" << std::endl;
+	std::cout << std::endl;
+
+	std::cout << "Scene options (command line):" << std::endl;
+	std::cout << "	- -vehicles <n>: Grid of n x n vehicle instances (software rasterizer batches them, hardware draws each)" << std::endl;
+	std::cout << "	- -props <n>: Grid of n x n static props, merged in static batches" << std::endl;
 }
\ No newline at end of file